@@ -7,118 +7,691 @@
 #include <chrono>
 #include <ctime>
 #include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <charconv>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <queue>
+#include <filesystem>
+#include <type_traits>
+#include <array>
+#include <cerrno>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cmath>
+#include <iterator>
+#include <cctype>
+#include <limits>
+#include <iomanip>
+#include <numeric>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FDS_HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+#ifdef __linux__
+#define FDS_HAVE_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
+#endif
 
 using namespace std;
 
 // ======================= DATA STRUCTURES =======================
 
-// Hash Table Implementation
-template<typename T>
+// 64-bit string hash (8 bytes per step, splitmix64 finalizer)
+inline uint64_t mixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hashString(string_view key) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    const char* data = key.data();
+    size_t len = key.size();
+    uint64_t hash = 0x243F6A8885A308D3ULL ^ (len * multiplier);
+    
+    while (len >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        hash = (hash ^ mixHash(chunk)) * multiplier;
+        data += 8;
+        len -= 8;
+    }
+    
+    uint64_t tail = 0;
+    memcpy(&tail, data, len);
+    return mixHash(hash ^ tail);
+}
+
+// Key policies for HashTable: how a key is hashed, looked up and stored
+template<typename K>
+struct KeyTraits;
+
+template<>
+struct KeyTraits<string> {
+    using Lookup = string_view;
+    static uint64_t hash(string_view key) { return hashString(key); }
+    static string store(string_view key) { return string(key); }
+};
+
+template<>
+struct KeyTraits<uint64_t> {
+    using Lookup = uint64_t;
+    static uint64_t hash(uint64_t key) { return mixHash(key); }
+    static uint64_t store(uint64_t key) { return key; }
+};
+
+// Borrowed keys: the table keeps the view, so the bytes must outlive it
+template<>
+struct KeyTraits<string_view> {
+    using Lookup = string_view;
+    static uint64_t hash(string_view key) { return hashString(key); }
+    static string_view store(string_view key) { return key; }
+};
+
+// Hash Table Implementation (open addressing, Robin Hood probing)
+template<typename T, typename K = string>
 class HashTable {
+public:
+    using Key = typename KeyTraits<K>::Lookup;
+    
+    static uint64_t hashKey(Key key) { return KeyTraits<K>::hash(key); }
+    
 private:
-    struct HashNode {
-        string key;
+    struct Slot {
+        K key;
         T value;
-        HashNode* next;
-        HashNode(const string& k, const T& v) : key(k), value(v), next(nullptr) {}
     };
     
-    vector<HashNode*> table;
-    int capacity;
+    // probe[i] == 0 marks an empty slot, otherwise it is the distance
+    // from the key's home bucket plus one
+    vector<Slot> slots;
+    vector<uint8_t> probe;
+    vector<uint32_t> fingerprints;
+    size_t count;
+    size_t mask;
     
-    int hashFunction(const string& key) {
-        int hash = 0;
-        for (char c : key) {
-            hash = (hash * 31 + c) % capacity;
-        }
-        return hash;
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr uint8_t MAX_PROBE = 255;
+    
+    static uint32_t fingerprint(uint64_t hash) {
+        return static_cast<uint32_t>(hash >> 32);
     }
     
-public:
-    HashTable(int cap = 100) : capacity(cap) {
-        table.resize(capacity, nullptr);
+    static size_t capacityFor(size_t entries) {
+        size_t capacity = MIN_CAPACITY;
+        // Max load factor 7/8
+        while (capacity * 7 < entries * 8) capacity <<= 1;
+        return capacity;
     }
     
-    ~HashTable() {
-        for (int i = 0; i < capacity; i++) {
-            HashNode* current = table[i];
-            while (current) {
-                HashNode* temp = current;
-                current = current->next;
-                delete temp;
+    void rehash(size_t newCapacity) {
+        vector<Slot> oldSlots(newCapacity);
+        vector<uint8_t> oldProbe(newCapacity, 0);
+        vector<uint32_t> oldFingerprints(newCapacity, 0);
+        oldSlots.swap(slots);
+        oldProbe.swap(probe);
+        oldFingerprints.swap(fingerprints);
+        mask = newCapacity - 1;
+        count = 0;
+        
+        for (size_t i = 0; i < oldSlots.size(); i++) {
+            if (oldProbe[i]) {
+                uint64_t hash = hashKey(oldSlots[i].key);
+                place(move(oldSlots[i].key), move(oldSlots[i].value), hash);
             }
         }
     }
     
-    void insert(const string& key, const T& value) {
-        int index = hashFunction(key);
-        HashNode* newNode = new HashNode(key, value);
+    size_t findIndex(Key key, uint64_t hash) const {
+        if (count == 0) return SIZE_MAX;
+        uint32_t fp = fingerprint(hash);
+        size_t index = hash & mask;
         
-        if (!table[index]) {
-            table[index] = newNode;
-        } else {
-            HashNode* current = table[index];
-            while (current->next && current->key != key) {
-                current = current->next;
-            }
-            if (current->key == key) {
-                current->value = value;
-                delete newNode;
-            } else {
-                current->next = newNode;
+        for (unsigned dist = 1; dist <= MAX_PROBE; dist++) {
+            if (probe[index] < dist) return SIZE_MAX;
+            if (fingerprints[index] == fp && slots[index].key == key) {
+                return index;
             }
+            index = (index + 1) & mask;
         }
+        return SIZE_MAX;
     }
     
-    T* search(const string& key) {
-        int index = hashFunction(key);
-        HashNode* current = table[index];
+    // Caller guarantees the key is absent and a free slot exists
+    void place(K&& key, T&& value, uint64_t hash) {
+        uint32_t fp = fingerprint(hash);
+        size_t index = hash & mask;
+        unsigned dist = 1;
         
-        while (current) {
-            if (current->key == key) {
-                return &(current->value);
+        while (true) {
+            if (probe[index] == 0) {
+                slots[index].key = move(key);
+                slots[index].value = move(value);
+                probe[index] = static_cast<uint8_t>(dist);
+                fingerprints[index] = fp;
+                count++;
+                return;
+            }
+            if (probe[index] < dist) {
+                // Robin Hood: the poorer entry takes the slot, the richer one moves on
+                swap(slots[index].key, key);
+                swap(slots[index].value, value);
+                uint8_t displaced = probe[index];
+                probe[index] = static_cast<uint8_t>(dist);
+                dist = displaced;
+                swap(fingerprints[index], fp);
+            }
+            index = (index + 1) & mask;
+            if (++dist > MAX_PROBE) {
+                // Pathological clustering: grow and re-place the carried entry
+                rehash(slots.size() * 2);
+                uint64_t carried = hashKey(key);
+                place(move(key), move(value), carried);
+                return;
             }
-            current = current->next;
         }
-        return nullptr;
     }
     
-    bool remove(const string& key) {
-        int index = hashFunction(key);
-        HashNode* current = table[index];
-        HashNode* prev = nullptr;
+    void insertNew(Key key, T&& value, uint64_t hash) {
+        if ((count + 1) * 8 > slots.size() * 7) {
+            rehash(slots.size() * 2);
+        }
+        place(KeyTraits<K>::store(key), move(value), hash);
+    }
+    
+public:
+    HashTable(size_t expected = 0) : count(0) {
+        size_t capacity = capacityFor(expected);
+        slots.resize(capacity);
+        probe.assign(capacity, 0);
+        fingerprints.assign(capacity, 0);
+        mask = capacity - 1;
+    }
+    
+    void reserve(size_t expected) {
+        size_t capacity = capacityFor(expected);
+        if (capacity > slots.size()) {
+            rehash(capacity);
+        }
+    }
+    
+    void insert(Key key, const T& value) {
+        insert(key, T(value), hashKey(key));
+    }
+    
+    void insert(Key key, T&& value) {
+        insert(key, move(value), hashKey(key));
+    }
+    
+    // Insert with a hash computed elsewhere (e.g. by a loader thread)
+    void insert(Key key, T&& value, uint64_t hash) {
+        size_t index = findIndex(key, hash);
+        if (index != SIZE_MAX) {
+            slots[index].value = move(value);
+            return;
+        }
+        insertNew(key, move(value), hash);
+    }
+    
+    T* search(Key key) {
+        return search(key, hashKey(key));
+    }
+    
+    const T* search(Key key) const {
+        size_t index = findIndex(key, hashKey(key));
+        return index == SIZE_MAX ? nullptr : &slots[index].value;
+    }
+    
+    T* search(Key key, uint64_t hash) {
+        size_t index = findIndex(key, hash);
+        return index == SIZE_MAX ? nullptr : &slots[index].value;
+    }
+    
+    bool remove(Key key) {
+        size_t index = findIndex(key, hashKey(key));
+        if (index == SIZE_MAX) return false;
         
-        while (current) {
-            if (current->key == key) {
-                if (prev) {
-                    prev->next = current->next;
-                } else {
-                    table[index] = current->next;
-                }
-                delete current;
-                return true;
+        // Backward-shift deletion keeps probe sequences tombstone-free
+        size_t next = (index + 1) & mask;
+        while (probe[next] > 1) {
+            slots[index] = move(slots[next]);
+            probe[index] = probe[next] - 1;
+            fingerprints[index] = fingerprints[next];
+            index = next;
+            next = (next + 1) & mask;
+        }
+        slots[index] = Slot();
+        probe[index] = 0;
+        count--;
+        return true;
+    }
+    
+    // fn(key, value) for every entry, in slot order
+    template<typename F>
+    void forEach(F fn) const {
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (probe[i]) fn(slots[i].key, slots[i].value);
+        }
+    }
+    
+    size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+};
+
+// Slot Map Implementation (contiguous storage, stable generational handles)
+struct Handle {
+    uint32_t index;
+    uint32_t generation;
+    
+    Handle() : index(UINT32_MAX), generation(0) {}
+    Handle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+    
+    bool isValid() const { return index != UINT32_MAX; }
+    bool operator==(const Handle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+template<typename T>
+class SlotMap {
+private:
+    struct SlotEntry {
+        uint32_t denseIndex;
+        uint32_t generation;
+    };
+    
+    vector<T> items;               // dense, iteration order
+    vector<uint32_t> denseToSlot;  // items[i] is owned by slots[denseToSlot[i]]
+    vector<SlotEntry> slots;
+    vector<uint32_t> freeSlots;
+    
+public:
+    void reserve(size_t n) {
+        items.reserve(n);
+        denseToSlot.reserve(n);
+        slots.reserve(n);
+    }
+    
+    Handle insert(T&& item) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back({0, 0});
+        }
+        slots[slot].denseIndex = static_cast<uint32_t>(items.size());
+        items.push_back(move(item));
+        denseToSlot.push_back(slot);
+        return Handle(slot, slots[slot].generation);
+    }
+    
+    T* get(Handle h) {
+        if (h.index >= slots.size() || slots[h.index].generation != h.generation) {
+            return nullptr;
+        }
+        return &items[slots[h.index].denseIndex];
+    }
+    
+    const T* get(Handle h) const {
+        return const_cast<SlotMap*>(this)->get(h);
+    }
+    
+    bool erase(Handle h) {
+        if (!get(h)) return false;
+        
+        // Swap-remove keeps the dense array packed
+        uint32_t dense = slots[h.index].denseIndex;
+        uint32_t last = static_cast<uint32_t>(items.size() - 1);
+        if (dense != last) {
+            items[dense] = move(items[last]);
+            denseToSlot[dense] = denseToSlot[last];
+            slots[denseToSlot[dense]].denseIndex = dense;
+        }
+        items.pop_back();
+        denseToSlot.pop_back();
+        
+        slots[h.index].generation++;
+        freeSlots.push_back(h.index);
+        return true;
+    }
+    
+    // Handle of the item at a dense position (valid until the next erase)
+    Handle handleAt(size_t dense) const {
+        uint32_t slot = denseToSlot[dense];
+        return Handle(slot, slots[slot].generation);
+    }
+    
+    size_t size() const { return items.size(); }
+    bool isEmpty() const { return items.empty(); }
+    
+    typename vector<T>::iterator begin() { return items.begin(); }
+    typename vector<T>::iterator end() { return items.end(); }
+    typename vector<T>::const_iterator begin() const { return items.begin(); }
+    typename vector<T>::const_iterator end() const { return items.end(); }
+};
+
+// Pool Implementation (fixed-size chunks, stable addresses, index free list).
+// Objects are constructed in place by create() and must be destroy()ed by
+// the owner; the pool itself only releases raw storage.
+template<typename T>
+class Pool {
+private:
+    static constexpr uint32_t CHUNK_SHIFT = 10;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+    
+    struct alignas(T) Storage {
+        unsigned char bytes[sizeof(T)];
+    };
+    
+    vector<unique_ptr<Storage[]>> chunks;
+    vector<uint32_t> freeList;
+    uint32_t highWater;
+    
+public:
+    Pool() : highWater(0) {}
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    
+    template<typename... Args>
+    uint32_t create(Args&&... args) {
+        uint32_t index;
+        if (!freeList.empty()) {
+            index = freeList.back();
+            freeList.pop_back();
+        } else {
+            if ((highWater >> CHUNK_SHIFT) == chunks.size()) {
+                chunks.emplace_back(new Storage[CHUNK_SIZE]);
             }
-            prev = current;
-            current = current->next;
+            index = highWater++;
         }
-        return false;
+        new (&chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)]) T(forward<Args>(args)...);
+        return index;
+    }
+    
+    void destroy(uint32_t index) {
+        get(index).~T();
+        freeList.push_back(index);
+    }
+    
+    T& get(uint32_t index) {
+        return *reinterpret_cast<T*>(&chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)]);
+    }
+    
+    const T& get(uint32_t index) const {
+        return *reinterpret_cast<const T*>(&chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)]);
+    }
+    
+    // Number of slots ever handed out (live + free)
+    uint32_t slotCount() const { return highWater; }
+    size_t liveCount() const { return highWater - freeList.size(); }
+};
+
+// Pooled Deque Implementation (doubly linked through pool indices):
+// O(1) pushBack/popFront, O(1) removal by handle, in-place iteration
+template<typename T>
+class PooledDeque {
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    
+    struct Node {
+        T data;
+        uint32_t prev;
+        uint32_t next;
+        template<typename U>
+        Node(U&& item, uint32_t p) : data(forward<U>(item)), prev(p), next(NIL) {}
+    };
+    
+    Pool<Node> pool;
+    vector<uint32_t> generations;   // per pool slot, bumped on every release
+    uint32_t head;
+    uint32_t tail;
+    size_t count;
+    
+    bool isLive(Handle h) const {
+        return h.index < generations.size() && generations[h.index] == h.generation
+               && (h.index == head || pool.get(h.index).prev != NIL);
+    }
+    
+    void unlink(uint32_t index) {
+        Node& node = pool.get(index);
+        if (node.prev != NIL) pool.get(node.prev).next = node.next; else head = node.next;
+        if (node.next != NIL) pool.get(node.next).prev = node.prev; else tail = node.prev;
+        generations[index]++;
+        pool.destroy(index);
+        count--;
+    }
+    
+public:
+    PooledDeque() : head(NIL), tail(NIL), count(0) {}
+    
+    ~PooledDeque() {
+        clear();
+    }
+    
+    PooledDeque(const PooledDeque&) = delete;
+    PooledDeque& operator=(const PooledDeque&) = delete;
+    
+    template<typename U>
+    Handle pushBack(U&& item) {
+        uint32_t index = pool.create(forward<U>(item), tail);
+        if (index >= generations.size()) generations.resize(index + 1, 0);
+        if (tail != NIL) pool.get(tail).next = index; else head = index;
+        tail = index;
+        count++;
+        return Handle(index, generations[index]);
+    }
+    
+    T* get(Handle h) {
+        return isLive(h) ? &pool.get(h.index).data : nullptr;
+    }
+    
+    bool remove(Handle h) {
+        if (!isLive(h)) return false;
+        unlink(h.index);
+        return true;
+    }
+    
+    // Moves the item out and unlinks it
+    bool take(Handle h, T& out) {
+        if (!isLive(h)) return false;
+        out = move(pool.get(h.index).data);
+        unlink(h.index);
+        return true;
+    }
+    
+    // Moves the item to the back of another deque without copying it
+    Handle transferTo(Handle h, PooledDeque& other) {
+        if (!isLive(h)) return Handle();
+        Handle moved = other.pushBack(move(pool.get(h.index).data));
+        unlink(h.index);
+        return moved;
+    }
+    
+    T popFront() {
+        if (head == NIL) {
+            throw runtime_error("Deque is empty");
+        }
+        T item = move(pool.get(head).data);
+        unlink(head);
+        return item;
+    }
+    
+    T& front() {
+        if (head == NIL) {
+            throw runtime_error("Deque is empty");
+        }
+        return pool.get(head).data;
+    }
+    
+    Handle frontHandle() const {
+        return head == NIL ? Handle() : Handle(head, generations[head]);
+    }
+    
+    void clear() {
+        while (head != NIL) {
+            unlink(head);
+        }
+    }
+    
+    template<typename F>
+    void forEach(F fn) const {
+        for (uint32_t i = head; i != NIL; i = pool.get(i).next) {
+            fn(pool.get(i).data);
+        }
+    }
+    
+    template<typename Pred>
+    T* find(Pred pred) {
+        for (uint32_t i = head; i != NIL; i = pool.get(i).next) {
+            if (pred(pool.get(i).data)) return &pool.get(i).data;
+        }
+        return nullptr;
+    }
+    
+    size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+};
+
+// Inline Vector Implementation: the first N items live inside the object,
+// so short sequences never touch the heap; longer ones spill to one block.
+// Restricted to trivially copyable items, which are moved with memcpy.
+template<typename T, uint32_t N>
+class InlineVector {
+private:
+    static_assert(is_trivially_copyable<T>::value, "InlineVector items must be trivially copyable");
+    
+    union {
+        T local[N];
+        T* heap;
+    };
+    uint32_t count;
+    uint32_t capacity;    // N while the items are inline
+    
+    bool isInline() const { return capacity == N; }
+    
+    void release() {
+        if (!isInline()) ::operator delete(heap);
+    }
+    
+    void reallocate(uint32_t newCapacity) {
+        T* block = static_cast<T*>(::operator new(newCapacity * sizeof(T)));
+        memcpy(block, data(), count * sizeof(T));
+        release();
+        heap = block;
+        capacity = newCapacity;
+    }
+    
+public:
+    InlineVector() : count(0), capacity(N) {}
+    
+    InlineVector(const InlineVector& other) : count(0), capacity(N) {
+        *this = other;
+    }
+    
+    InlineVector(InlineVector&& other) noexcept : count(0), capacity(N) {
+        *this = move(other);
+    }
+    
+    InlineVector& operator=(const InlineVector& other) {
+        if (this == &other) return *this;
+        count = 0;
+        reserve(other.count);
+        memcpy(data(), other.data(), other.count * sizeof(T));
+        count = other.count;
+        return *this;
+    }
+    
+    InlineVector& operator=(InlineVector&& other) noexcept {
+        if (this == &other) return *this;
+        release();
+        if (other.isInline()) {
+            memcpy(local, other.local, other.count * sizeof(T));
+            capacity = N;
+        } else {
+            heap = other.heap;
+            capacity = other.capacity;
+            other.capacity = N;
+        }
+        count = other.count;
+        other.count = 0;
+        return *this;
+    }
+    
+    ~InlineVector() {
+        release();
+    }
+    
+    void reserve(uint32_t n) {
+        if (n > capacity) reallocate(n);
+    }
+    
+    void push_back(const T& item) {
+        if (count == capacity) reallocate(capacity * 2);
+        data()[count++] = item;
     }
+    
+    void clear() { count = 0; }
+    
+    T* data() { return isInline() ? local : heap; }
+    const T* data() const { return isInline() ? local : heap; }
+    
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    
+    T* begin() { return data(); }
+    T* end() { return data() + count; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + count; }
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
 };
 
-// Stack Implementation
+// Stack Implementation (nodes from a Pool, linked by index)
 template<typename T>
 class Stack {
 private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    
     struct StackNode {
         T data;
-        StackNode* next;
-        StackNode(const T& item) : data(item), next(nullptr) {}
+        uint32_t next;
+        StackNode(const T& item, uint32_t n) : data(item), next(n) {}
     };
     
-    StackNode* top;
+    Pool<StackNode> pool;
+    uint32_t top;
     
 public:
-    Stack() : top(nullptr) {}
+    Stack() : top(NIL) {}
     
     ~Stack() {
         while (!isEmpty()) {
@@ -127,19 +700,18 @@ public:
     }
     
     void push(const T& item) {
-        StackNode* newNode = new StackNode(item);
-        newNode->next = top;
-        top = newNode;
+        top = pool.create(item, top);
     }
     
     T pop() {
         if (isEmpty()) {
             throw runtime_error("Stack is empty");
         }
-        T data = top->data;
-        StackNode* temp = top;
-        top = top->next;
-        delete temp;
+        StackNode& node = pool.get(top);
+        T data = move(node.data);
+        uint32_t next = node.next;
+        pool.destroy(top);
+        top = next;
         return data;
     }
     
@@ -147,10 +719,10 @@ public:
         if (isEmpty()) {
             throw runtime_error("Stack is empty");
         }
-        return top->data;
+        return pool.get(top).data;
     }
     
-    bool isEmpty() const { return top == nullptr; }
+    bool isEmpty() const { return top == NIL; }
 };
 
 // Linked List Implementation
@@ -200,7 +772,7 @@ public:
         }
         
         ListNode* current = head;
-        while (current->next && current->next->data != item) {
+        while (current->next && !(current->next->data == item)) {
             current = current->next;
         }
         
@@ -213,6 +785,14 @@ public:
         return false;
     }
     
+    template<typename Pred>
+    T* find(Pred pred) {
+        for (ListNode* current = head; current; current = current->next) {
+            if (pred(current->data)) return &current->data;
+        }
+        return nullptr;
+    }
+    
     vector<T> traverse() const {
         vector<T> result;
         ListNode* current = head;
@@ -226,683 +806,9735 @@ public:
     bool isEmpty() const { return head == nullptr; }
 };
 
-// Binary Search Tree Implementation
-template<typename T>
-class BST {
-private:
-    struct TreeNode {
-        T data;
-        TreeNode* left;
-        TreeNode* right;
-        TreeNode(const T& item) : data(item), left(nullptr), right(nullptr) {}
+// ======================= MEMORY =======================
+
+// Process-wide heap accounting for the memory benchmarks, fed by the
+// replaced global operator new/delete below. Each block carries a small
+// size header so frees can be subtracted from the live byte count. The
+// header and the shared counters tax every allocation, so they are only
+// compiled in with -DFDS_COUNT_ALLOCATIONS; otherwise samples stay zero.
+class AllocationCounter {
+public:
+#ifdef FDS_COUNT_ALLOCATIONS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+    
+    
+    struct Sample {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;       // requested over the process lifetime
+        int64_t liveBytes = 0;    // currently allocated
     };
     
-    TreeNode* root;
+    static void* allocate(size_t size) {
+        void* block = malloc(size + HEADER);
+        if (!block) throw bad_alloc();
+        memcpy(block, &size, sizeof(size));
+        allocations.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(size, memory_order_relaxed);
+        live.fetch_add(static_cast<int64_t>(size), memory_order_relaxed);
+        return static_cast<unsigned char*>(block) + HEADER;
+    }
     
-    TreeNode* insertHelper(TreeNode* node, const T& item) {
-        if (!node) {
-            return new TreeNode(item);
-        }
-        if (item < node->data) {
-            node->left = insertHelper(node->left, item);
-        } else if (item > node->data) {
-            node->right = insertHelper(node->right, item);
-        }
-        return node;
+    static void release(void* ptr) {
+        if (!ptr) return;
+        void* block = static_cast<unsigned char*>(ptr) - HEADER;
+        size_t size;
+        memcpy(&size, block, sizeof(size));
+        live.fetch_sub(static_cast<int64_t>(size), memory_order_relaxed);
+        free(block);
     }
     
-    void inorderHelper(TreeNode* node, vector<T>& result) {
-        if (node) {
-            inorderHelper(node->left, result);
-            result.push_back(node->data);
-            inorderHelper(node->right, result);
-        }
+    static Sample sample() {
+        Sample s;
+        s.allocations = allocations.load(memory_order_relaxed);
+        s.bytes = bytes.load(memory_order_relaxed);
+        s.liveBytes = live.load(memory_order_relaxed);
+        return s;
     }
     
-    void deleteAll(TreeNode* node) {
-        if (node) {
-            deleteAll(node->left);
-            deleteAll(node->right);
-            delete node;
+private:
+    // Keeps the returned pointer aligned like malloc's own
+    static constexpr size_t HEADER = alignof(max_align_t);
+    
+    inline static atomic<uint64_t> allocations{0};
+    inline static atomic<uint64_t> bytes{0};
+    inline static atomic<int64_t> live{0};
+};
+
+#ifdef FDS_COUNT_ALLOCATIONS
+void* operator new(size_t size) { return AllocationCounter::allocate(size); }
+void* operator new[](size_t size) { return AllocationCounter::allocate(size); }
+void operator delete(void* ptr) noexcept { AllocationCounter::release(ptr); }
+void operator delete[](void* ptr) noexcept { AllocationCounter::release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { AllocationCounter::release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { AllocationCounter::release(ptr); }
+#endif
+
+// ======================= CONCURRENCY =======================
+
+// Thread Pool Implementation (fixed workers, FIFO task queue)
+class ThreadPool {
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable available;
+    bool stopping;
+    
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
         }
     }
     
 public:
-    BST() : root(nullptr) {}
+    explicit ThreadPool(size_t threadCount = defaultThreads()) : stopping(false) {
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
     
-    ~BST() {
-        deleteAll(root);
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
     }
     
-    void insert(const T& item) {
-        root = insertHelper(root, item);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    static size_t defaultThreads() {
+        unsigned n = thread::hardware_concurrency();
+        return n ? n : 2;
     }
     
-    vector<T> inorderTraversal() {
-        vector<T> result;
-        inorderHelper(root, result);
+    size_t size() const { return workers.size(); }
+    
+    template<typename F>
+    future<void> submit(F fn) {
+        auto task = make_shared<packaged_task<void()>>(move(fn));
+        future<void> result = task->get_future();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        available.notify_one();
         return result;
     }
+    
+    // Runs fn(i) for every i in [0, n) on the pool and waits for all of them;
+    // the first exception thrown by a task is rethrown here
+    template<typename F>
+    void parallelFor(size_t n, F fn) {
+        vector<future<void>> pending;
+        pending.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            pending.push_back(submit([&fn, i] { fn(i); }));
+        }
+        for (auto& f : pending) {
+            f.get();
+        }
+    }
 };
 
-// ======================= DOMAIN CLASSES =======================
-
-class MenuItem {
-public:
-    string name;
-    double price;
-    string category;
+// Bounded lock-free MPSC ring buffer (Vyukov's sequence-per-cell scheme);
+// any number of producers, exactly one consumer
+template<typename T>
+class MpscRingBuffer {
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        T data;
+    };
     
-    MenuItem() : name(""), price(0.0), category("") {}
-    MenuItem(const string& n, double p, const string& cat) : name(n), price(p), category(cat) {}
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueuePos;
+    alignas(64) size_t dequeuePos;
     
-    bool operator<(const MenuItem& other) const { return price < other.price; }
-    bool operator>(const MenuItem& other) const { return price > other.price; }
-    bool operator==(const MenuItem& other) const { return name == other.name; }
+public:
+    explicit MpscRingBuffer(size_t capacity) : enqueuePos(0), dequeuePos(0) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
     
-    string toString() const {
-        return name + "," + to_string(price) + "," + category;
+    // Never blocks and never allocates; false when the buffer is full
+    bool tryPush(const T& item) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.data = item;
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
     }
     
-    static MenuItem fromString(const string& str) {
-        stringstream ss(str);
-        string name, category, priceStr;
-        getline(ss, name, ',');
-        getline(ss, priceStr, ',');
-        getline(ss, category, ',');
-        return MenuItem(name, stod(priceStr), category);
+    // Consumer side only
+    bool tryPop(T& item) {
+        Cell& cell = cells[dequeuePos & mask];
+        size_t seq = cell.sequence.load(memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1) < 0) {
+            return false;
+        }
+        item = cell.data;
+        cell.sequence.store(dequeuePos + mask + 1, memory_order_release);
+        dequeuePos++;
+        return true;
     }
 };
 
-class Customer {
+// HashTable split into independently locked stripes, so threads working on
+// different keys rarely contend. The stripe comes from the top hash bits and
+// the slot inside it from the low bits. Values are only reachable inside
+// callbacks run under the stripe lock (shared for reads, exclusive for
+// writes), so no reference outlives its lock.
+template<typename T, typename K = string>
+class StripedHashTable {
 public:
-    string id;
-    string name;
-    string phone;
-    string address;
+    using Table = HashTable<T, K>;
+    using Key = typename Table::Key;
     
-    Customer() : id(""), name(""), phone(""), address("") {}
-    Customer(const string& i, const string& n, const string& p, const string& addr)
-        : id(i), name(n), phone(p), address(addr) {}
+private:
+    struct alignas(64) Stripe {
+        mutable shared_mutex lock;
+        Table table;
+    };
     
-    void saveToFile() {
-        ofstream file("customers.txt", ios::app);
-        if (file.is_open()) {
-            file << id << "," << name << "," << phone << "," << address << "\n";
-            file.close();
+    unique_ptr<Stripe[]> stripes;
+    size_t stripeCount;
+    unsigned shift;
+    
+    Stripe& stripeFor(uint64_t hash) const { return stripes[hash >> shift]; }
+    
+public:
+    // stripeCount is rounded up to a power of two (at least 2)
+    explicit StripedHashTable(size_t minStripes = 64) : stripeCount(2), shift(63) {
+        while (stripeCount < minStripes) {
+            stripeCount <<= 1;
+            shift--;
         }
+        stripes.reset(new Stripe[stripeCount]);
     }
     
-    static vector<Customer> loadAllCustomers() {
-        vector<Customer> customers;
-        ifstream file("customers.txt");
-        string line;
-        
-        while (getline(file, line) && !line.empty()) {
-            stringstream ss(line);
-            string id, name, phone, address;
-            getline(ss, id, ',');
-            getline(ss, name, ',');
-            getline(ss, phone, ',');
-            getline(ss, address, ',');
-            customers.emplace_back(id, name, phone, address);
+    // fn(const T*) under a shared lock; the pointer is null for a missing key
+    template<typename F>
+    auto read(Key key, F fn) const {
+        uint64_t hash = Table::hashKey(key);
+        Stripe& stripe = stripeFor(hash);
+        shared_lock<shared_mutex> lock(stripe.lock);
+        const T* value = stripe.table.search(key, hash);
+        return fn(value);
+    }
+    
+    // fn(table, hash) under the exclusive lock, so a lookup and the insert
+    // or removal that depends on it are atomic for this key
+    template<typename F>
+    auto write(Key key, F fn) {
+        uint64_t hash = Table::hashKey(key);
+        Stripe& stripe = stripeFor(hash);
+        lock_guard<shared_mutex> lock(stripe.lock);
+        return fn(stripe.table, hash);
+    }
+    
+    // Adds or replaces; hash must be Table::hashKey(key)
+    void insert(Key key, T&& value, uint64_t hash) {
+        Stripe& stripe = stripeFor(hash);
+        lock_guard<shared_mutex> lock(stripe.lock);
+        stripe.table.insert(key, move(value), hash);
+    }
+    
+    bool contains(Key key) const {
+        return read(key, [](const T* value) { return value != nullptr; });
+    }
+    
+    // Sizes every stripe for its share of `expected` entries
+    void reserve(size_t expected) {
+        for (size_t i = 0; i < stripeCount; i++) {
+            lock_guard<shared_mutex> lock(stripes[i].lock);
+            stripes[i].table.reserve(expected / stripeCount + expected / stripeCount / 4 + 1);
+        }
+    }
+    
+    // Visits one stripe at a time under its shared lock; not a consistent
+    // snapshot while writers are active
+    template<typename F>
+    void forEach(F fn) const {
+        for (size_t i = 0; i < stripeCount; i++) {
+            shared_lock<shared_mutex> lock(stripes[i].lock);
+            stripes[i].table.forEach(fn);
+        }
+    }
+    
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < stripeCount; i++) {
+            shared_lock<shared_mutex> lock(stripes[i].lock);
+            total += stripes[i].table.size();
         }
-        file.close();
-        return customers;
+        return total;
     }
 };
 
-class Restaurant {
-public:
-    string id;
-    string name;
-    double rating;
-    string address;
-    vector<MenuItem> menu;
+// ======================= STRING INTERNING =======================
+
+// Process-wide pool of distinct strings. Each one is copied once into an
+// append-only arena and named by a 32-bit id, so equal strings compare as
+// integers and views into the pool stay valid until exit. Known strings
+// are found in a small per-thread cache of recent hits or under a shared
+// lock; only new strings take the write lock. Id 0 is the empty string.
+class StringInterner {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 << 10;
+    static constexpr uint32_t CHUNK_SHIFT = 12;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+    static constexpr uint32_t MAX_CHUNKS = 1u << 16;
+    static constexpr size_t RECENT_SLOTS = 256;
     
-    Restaurant() : id(""), name(""), rating(0.0), address("") {}
-    Restaurant(const string& i, const string& n, double r, const string& addr)
-        : id(i), name(n), rating(r), address(addr) {}
+    mutable shared_mutex lock;
+    HashTable<uint32_t, string_view> ids;
+    // Id -> text in fixed-size chunks that never move, so text() needs no lock
+    unique_ptr<unique_ptr<string_view[]>[]> chunks;
+    vector<unique_ptr<char[]>> blocks;
+    char* current;       // arena block being filled
+    size_t blockUsed;
+    uint32_t count;
+    size_t bytes;
     
-    void addMenuItem(const MenuItem& item) {
-        menu.push_back(item);
+    StringInterner()
+        : chunks(new unique_ptr<string_view[]>[MAX_CHUNKS]), current(nullptr), blockUsed(BLOCK_SIZE), count(0),
+          bytes(0) {
+        chunks[0].reset(new string_view[CHUNK_SIZE]);
+        ids.insert(string_view(), 0);
+        count = 1;
     }
     
-    void saveToFile() {
-        ofstream file("restaurants.dat", ios::app);
-        if (file.is_open()) {
-            file << id << "," << name << "," << rating << "," << address << "\n";
-            for (const auto& item : menu) {
-                file << "MENU," << id << "," << item.toString() << "\n";
+    // Caller holds the write lock and has checked the text is new
+    uint32_t add(string_view text, uint64_t hash) {
+        if (count == MAX_CHUNKS * CHUNK_SIZE) throw runtime_error("String pool is full");
+        char* stored;
+        if (text.size() > BLOCK_SIZE / 4) {
+            // Long strings get a block of their own; the open block stays open
+            blocks.emplace_back(new char[text.size()]);
+            stored = blocks.back().get();
+        } else {
+            if (blockUsed + text.size() > BLOCK_SIZE) {
+                blocks.emplace_back(new char[BLOCK_SIZE]);
+                current = blocks.back().get();
+                blockUsed = 0;
             }
-            file.close();
+            stored = current + blockUsed;
+            blockUsed += text.size();
         }
+        memcpy(stored, text.data(), text.size());
+        bytes += text.size();
+        
+        string_view view(stored, text.size());
+        uint32_t id = count++;
+        if ((id & (CHUNK_SIZE - 1)) == 0) chunks[id >> CHUNK_SHIFT].reset(new string_view[CHUNK_SIZE]);
+        chunks[id >> CHUNK_SHIFT][id & (CHUNK_SIZE - 1)] = view;
+        ids.insert(view, uint32_t(id), hash);
+        return id;
     }
     
-    static vector<Restaurant> loadAllRestaurants() {
-        vector<Restaurant> restaurants;
-        HashTable<Restaurant> restaurantMap;
+public:
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    
+    static StringInterner& instance() {
+        static StringInterner interner;
+        return interner;
+    }
+    
+    uint32_t intern(string_view text) {
+        struct Recent {
+            uint64_t hash = 0;
+            uint32_t id = 0;
+        };
+        thread_local array<Recent, RECENT_SLOTS> recent;
         
-        ifstream file("restaurants.dat");
-        string line;
+        uint64_t hash = hashString(text);
+        Recent& slot = recent[hash & (RECENT_SLOTS - 1)];
+        if (slot.hash == hash && this->text(slot.id) == text) return slot.id;
         
-        while (getline(file, line) && !line.empty()) {
-            if (line.substr(0, 4) == "MENU") {
-                stringstream ss(line.substr(5));
-                string restId, itemData;
-                getline(ss, restId, ',');
-                getline(ss, itemData);
-                
-                Restaurant* rest = restaurantMap.search(restId);
-                if (rest) {
-                    rest->addMenuItem(MenuItem::fromString(itemData));
-                }
-            } else {
-                stringstream ss(line);
-                string id, name, address, ratingStr;
-                getline(ss, id, ',');
-                getline(ss, name, ',');
-                getline(ss, ratingStr, ',');
-                getline(ss, address, ',');
-                
-                Restaurant rest(id, name, stod(ratingStr), address);
-                restaurants.push_back(rest);
-                restaurantMap.insert(id, rest);
-            }
+        uint32_t id;
+        {
+            shared_lock<shared_mutex> read(lock);
+            const uint32_t* found = ids.search(text, hash);
+            id = found ? *found : 0;
         }
-        file.close();
-        return restaurants;
+        if (!id && !text.empty()) {
+            unique_lock<shared_mutex> write(lock);
+            const uint32_t* found = ids.search(text, hash);
+            id = found ? *found : add(text, hash);
+        }
+        slot = {hash, id};
+        return id;
     }
     
-    bool operator<(const Restaurant& other) const {
-        return rating > other.rating;
+    // Looks a string up without adding it; false if it was never interned
+    bool find(string_view text, uint32_t& id) const {
+        shared_lock<shared_mutex> read(lock);
+        const uint32_t* found = ids.search(text);
+        if (found) id = *found;
+        return found != nullptr;
     }
-};
-
-class Order {
-public:
-    string orderId;
-    string customerId;
-    string restaurantId;
-    vector<MenuItem> items;
-    double totalAmount;
-    string status;
-    string timestamp;
     
-    Order() : orderId(""), customerId(""), restaurantId(""), totalAmount(0.0), status("Pending") {
-        updateTimestamp();
+    string_view text(uint32_t id) const {
+        return chunks[id >> CHUNK_SHIFT][id & (CHUNK_SIZE - 1)];
     }
     
-    Order(const string& oid, const string& cid, const string& rid)
-        : orderId(oid), customerId(cid), restaurantId(rid), totalAmount(0.0), status("Pending") {
-        updateTimestamp();
+    size_t size() const {
+        shared_lock<shared_mutex> read(lock);
+        return count;
     }
     
-    void addItem(const MenuItem& item) {
-        items.push_back(item);
-        totalAmount += item.price;
+    // Bytes of string data held, excluding block slack
+    size_t textBytes() const {
+        shared_lock<shared_mutex> read(lock);
+        return bytes;
     }
+};
+
+// An interned string: compares as an integer, reads back as a view into the pool
+class Symbol {
+private:
+    uint32_t id;
     
-    void updateStatus(const string& newStatus) {
-        status = newStatus;
-        updateTimestamp();
-        logStatusChange();
+public:
+    Symbol() : id(0) {}
+    explicit Symbol(string_view text) : id(StringInterner::instance().intern(text)) {}
+    
+    // The symbol for `text` if it was ever interned; never grows the pool,
+    // so lookups of arbitrary input cannot fill it
+    static bool find(string_view text, Symbol& out) {
+        return StringInterner::instance().find(text, out.id);
     }
     
-    void saveToFile() {
-        ofstream file("orders.log", ios::app);
-        if (file.is_open()) {
-            file << orderId << "," << customerId << "," << restaurantId << ","
-                 << totalAmount << "," << status << "," << timestamp << "\n";
-            for (const auto& item : items) {
-                file << "ITEM," << orderId << "," << item.toString() << "\n";
-            }
-            file.close();
-        }
+    string_view text() const { return StringInterner::instance().text(id); }
+    uint32_t value() const { return id; }
+    bool empty() const { return id == 0; }
+    
+    bool operator==(Symbol other) const { return id == other.id; }
+    bool operator!=(Symbol other) const { return id != other.id; }
+};
+
+inline ostream& operator<<(ostream& out, Symbol symbol) {
+    return out << symbol.text();
+}
+
+// ======================= IDENTIFIERS =======================
+
+// Every entity id is a 64-bit integer; the decimal string form only exists
+// at the edges (console, files, CSV export)
+using EntityId = uint64_t;
+
+inline bool parseId(string_view text, EntityId& out) {
+    auto result = from_chars(text.data(), text.data() + text.size(), out);
+    return result.ec == errc() && result.ptr == text.data() + text.size() && out != 0;
+}
+
+inline string formatId(EntityId id) {
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), id);
+    return string(buffer, result.ptr);
+}
+
+// Snowflake-style generator: 41 bits of milliseconds since 2024-01-01 UTC,
+// 10 bits of node id and a 12-bit per-millisecond sequence. Lock-free: a
+// CAS on the packed state hands out ids that are unique and monotonic even
+// when 4096 ids are taken inside one millisecond (the clock is borrowed
+// from the next millisecond) or when the wall clock steps backwards.
+class SnowflakeIdGenerator {
+private:
+    static constexpr uint64_t EPOCH_MS = 1704067200000ULL;
+    static constexpr int SEQUENCE_BITS = 12;
+    static constexpr int NODE_BITS = 10;
+    
+    // Last issued (milliseconds << SEQUENCE_BITS | sequence)
+    atomic<uint64_t> state;
+    uint64_t node;
+    
+    static uint64_t nowMillis() {
+        auto now = chrono::system_clock::now().time_since_epoch();
+        uint64_t ms = chrono::duration_cast<chrono::milliseconds>(now).count();
+        return ms > EPOCH_MS ? ms - EPOCH_MS : 0;
     }
     
-    bool operator==(const Order& other) const {
-        return orderId == other.orderId;
+public:
+    static constexpr uint64_t MAX_NODE = (1ULL << NODE_BITS) - 1;
+    
+    explicit SnowflakeIdGenerator(uint64_t nodeId = 1) : state(0), node(nodeId & MAX_NODE) {}
+    
+    EntityId next() {
+        uint64_t fresh = nowMillis() << SEQUENCE_BITS;
+        uint64_t last = state.load(memory_order_relaxed);
+        uint64_t issued;
+        do {
+            issued = max(fresh, last + 1);
+        } while (!state.compare_exchange_weak(last, issued, memory_order_relaxed));
+        
+        uint64_t millis = issued >> SEQUENCE_BITS;
+        uint64_t sequence = issued & ((1ULL << SEQUENCE_BITS) - 1);
+        return (millis << (NODE_BITS + SEQUENCE_BITS)) | (node << SEQUENCE_BITS) | sequence;
     }
     
-private:
-    void updateTimestamp() {
-        auto now = chrono::system_clock::now();
-        time_t time = chrono::system_clock::to_time_t(now);
-        timestamp = ctime(&time);
-        timestamp.pop_back();
+    // Wall-clock second an id was issued; `fallback` for ids that did not
+    // come from a generator (no timestamp bits)
+    static time_t timeOf(EntityId id, time_t fallback) {
+        uint64_t millis = id >> (NODE_BITS + SEQUENCE_BITS);
+        return millis ? static_cast<time_t>((millis + EPOCH_MS) / 1000) : fallback;
     }
     
-    void logStatusChange() {
-        ofstream file("order_tracking.log", ios::app);
-        if (file.is_open()) {
-            file << orderId << " status changed to " << status << " at " << timestamp << "\n";
-            file.close();
+    // Ids restored from disk must never be handed out again
+    void observe(EntityId id) {
+        uint64_t millis = id >> (NODE_BITS + SEQUENCE_BITS);
+        uint64_t seen = millis << SEQUENCE_BITS | (id & ((1ULL << SEQUENCE_BITS) - 1));
+        uint64_t last = state.load(memory_order_relaxed);
+        while (last < seen && !state.compare_exchange_weak(last, seen, memory_order_relaxed)) {
         }
     }
 };
 
-// ======================= ALGORITHMS =======================
+// ======================= MONEY =======================
 
-class SortingAlgorithms {
+// An amount in whole cents. Sums and comparisons are exact integer
+// arithmetic, and text is parsed digit by digit rather than through a
+// double, so totals reconcile to the cent however many are added up.
+class Money {
+private:
+    int64_t value;
+    
+    explicit constexpr Money(int64_t cents) : value(cents) {}
+    
 public:
-    template<typename T>
-    static void mergeSort(vector<T>& arr, int left, int right) {
-        if (left < right) {
-            int mid = left + (right - left) / 2;
-            mergeSort(arr, left, mid);
-            mergeSort(arr, mid + 1, right);
-            merge(arr, left, mid, right);
-        }
-    }
+    static constexpr int64_t PPM = 1000000;
     
-    template<typename T>
-    static void merge(vector<T>& arr, int left, int mid, int right) {
-        int n1 = mid - left + 1;
-        int n2 = right - mid;
-        
-        vector<T> leftArr(n1), rightArr(n2);
-        
-        for (int i = 0; i < n1; i++)
-            leftArr[i] = arr[left + i];
-        for (int j = 0; j < n2; j++)
-            rightArr[j] = arr[mid + 1 + j];
-        
-        int i = 0, j = 0, k = left;
+    constexpr Money() : value(0) {}
+    
+    static constexpr Money cents(int64_t cents) { return Money(cents); }
+    static constexpr Money max() { return Money(numeric_limits<int64_t>::max()); }
+    
+    // Nearest cent; only for amounts that arrive as doubles (older records)
+    static Money fromDouble(double amount) { return Money(llround(amount * 100.0)); }
+    
+    // Decimal text such as "12", "12.5" or "-0.99". Digits past the cents
+    // round half away from zero, so "12.990000" from older files is exact.
+    static bool parse(string_view text, Money& out) {
+        bool negative = !text.empty() && text[0] == '-';
+        if (negative) text.remove_prefix(1);
+        size_t dot = text.find('.');
+        string_view whole = text.substr(0, dot);
+        string_view fraction = dot == string_view::npos ? string_view() : text.substr(dot + 1);
+        if (whole.empty() && fraction.empty()) return false;
         
-        while (i < n1 && j < n2) {
-            if (leftArr[i] < rightArr[j]) {
-                arr[k] = leftArr[i];
-                i++;
-            } else {
-                arr[k] = rightArr[j];
-                j++;
-            }
-            k++;
+        uint64_t units = 0;
+        if (!whole.empty()) {
+            auto result = from_chars(whole.data(), whole.data() + whole.size(), units);
+            if (result.ec != errc() || result.ptr != whole.data() + whole.size()) return false;
         }
+        if (units > static_cast<uint64_t>(numeric_limits<int64_t>::max() / 100 - 1)) return false;
         
-        while (i < n1) {
-            arr[k] = leftArr[i];
-            i++;
-            k++;
+        int64_t cents = 0;
+        for (size_t i = 0; i < fraction.size(); i++) {
+            if (fraction[i] < '0' || fraction[i] > '9') return false;
+            if (i < 2) cents = cents * 10 + (fraction[i] - '0');
         }
+        if (fraction.size() < 2) cents *= fraction.size() == 1 ? 10 : 100;
+        if (fraction.size() > 2 && fraction[2] >= '5') cents++;
         
-        while (j < n2) {
-            arr[k] = rightArr[j];
-            j++;
-            k++;
-        }
+        int64_t total = static_cast<int64_t>(units) * 100 + cents;
+        out = Money(negative ? -total : total);
+        return true;
     }
     
-    template<typename T>
-    static void bubbleSort(vector<T>& arr) {
-        int n = arr.size();
-        for (int i = 0; i < n - 1; i++) {
-            for (int j = 0; j < n - i - 1; j++) {
-                if (arr[j] > arr[j + 1]) {
-                    swap(arr[j], arr[j + 1]);
-                }
-            }
-        }
+    int64_t inCents() const { return value; }
+    double toDouble() const { return static_cast<double>(value) / 100.0; }
+    
+    // This amount times ppm / 1,000,000 (8.875% is 88750), rounded to the
+    // cent half away from zero
+    Money portion(int64_t ppm) const {
+        int64_t product = value * ppm;
+        // Division truncates toward zero, so adding half away from zero rounds
+        return Money((product + (product < 0 ? -PPM / 2 : PPM / 2)) / PPM);
     }
     
-    static void performanceAnalysis() {
-        cout << "\n=== SORTING ALGORITHM PERFORMANCE ANALYSIS ===\n";
-        
-        vector<int> testData1(1000), testData2(1000);
-        for (int i = 0; i < 1000; i++) {
-            testData1[i] = testData2[i] = rand() % 1000;
-        }
-        
-        auto start = chrono::high_resolution_clock::now();
-        mergeSort(testData1, 0, testData1.size() - 1);
-        auto end = chrono::high_resolution_clock::now();
-        auto mergeDuration = chrono::duration_cast<chrono::microseconds>(end - start);
-        
-        start = chrono::high_resolution_clock::now();
-        bubbleSort(testData2);
-        end = chrono::high_resolution_clock::now();
-        auto bubbleDuration = chrono::duration_cast<chrono::microseconds>(end - start);
-        
-        cout << "Merge Sort (1000 elements): " << mergeDuration.count() << " microseconds\n";
-        cout << "Bubble Sort (1000 elements): " << bubbleDuration.count() << " microseconds\n";
-        cout << "Merge Sort is " << (double)bubbleDuration.count() / mergeDuration.count() 
-             << "x faster than Bubble Sort\n";
+    // "12.50", "-0.99"; `last - first` must be at least 24
+    char* format(char* first, char* last) const {
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        if (value < 0) *first++ = '-';
+        first = to_chars(first, last, magnitude / 100).ptr;
+        *first++ = '.';
+        *first++ = static_cast<char>('0' + magnitude % 100 / 10);
+        *first++ = static_cast<char>('0' + magnitude % 10);
+        return first;
+    }
+    
+    string toString() const {
+        char text[24];
+        return string(text, format(text, text + sizeof(text)));
     }
+    
+    Money& operator+=(Money other) { value += other.value; return *this; }
+    Money& operator-=(Money other) { value -= other.value; return *this; }
+    Money operator+(Money other) const { return Money(value + other.value); }
+    Money operator-(Money other) const { return Money(value - other.value); }
+    Money operator-() const { return Money(-value); }
+    Money operator*(int64_t quantity) const { return Money(value * quantity); }
+    
+    bool operator==(Money other) const { return value == other.value; }
+    bool operator!=(Money other) const { return value != other.value; }
+    bool operator<(Money other) const { return value < other.value; }
+    bool operator<=(Money other) const { return value <= other.value; }
+    bool operator>(Money other) const { return value > other.value; }
+    bool operator>=(Money other) const { return value >= other.value; }
 };
 
-class SearchAlgorithms {
+inline ostream& operator<<(ostream& out, Money amount) {
+    char text[24];
+    return out.write(text, amount.format(text, text + sizeof(text)) - text);
+}
+
+// Reads one whitespace-delimited token; sets failbit unless it parses
+inline istream& operator>>(istream& in, Money& amount) {
+    string text;
+    if (in >> text && !Money::parse(text, amount)) in.setstate(ios::failbit);
+    return in;
+}
+
+// ======================= GEOGRAPHY =======================
+
+// Great-circle distance in meters
+inline double haversineMeters(double lat1, double lon1, double lat2, double lon2) {
+    const double toRadians = 3.14159265358979323846 / 180.0;
+    double dLat = (lat2 - lat1) * toRadians;
+    double dLon = (lon2 - lon1) * toRadians;
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1 * toRadians) * cos(lat2 * toRadians) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * 6371000.0 * asin(min(1.0, sqrt(a)));
+}
+
+// Latitude/longitude in degrees; records without a location hold NaNs
+struct GeoPoint {
+    double latitude = numeric_limits<double>::quiet_NaN();
+    double longitude = numeric_limits<double>::quiet_NaN();
+    
+    GeoPoint() = default;
+    GeoPoint(double lat, double lon) : latitude(lat), longitude(lon) {}
+    
+    bool isKnown() const { return !std::isnan(latitude) && !std::isnan(longitude); }
+    
+    double metersTo(const GeoPoint& other) const {
+        return haversineMeters(latitude, longitude, other.latitude, other.longitude);
+    }
+};
+
+// ======================= FILE I/O =======================
+
+// Read-only view of a whole file: memory-mapped where available,
+// otherwise read into an owned buffer
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+    bool mapped;
+    bool opened;
+    string buffer;
+    
 public:
-    template<typename T>
-    static int linearSearch(const vector<T>& arr, const T& target) {
-        for (int i = 0; i < arr.size(); i++) {
-            if (arr[i] == target) {
-                return i;
+    explicit MappedFile(const string& path) : data(nullptr), length(0), mapped(false), opened(false) {
+#ifdef FDS_HAVE_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            opened = true;
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED) {
+                    madvise(addr, length, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(addr);
+                    mapped = true;
+                } else {
+                    opened = false;
+                    length = 0;
+                }
             }
         }
-        return -1;
+        close(fd);
+#else
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return;
+        opened = true;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        data = buffer.data();
+        length = buffer.size();
+#endif
     }
     
-    static void dfsRoute(vector<vector<int>>& graph, int start, vector<bool>& visited, vector<int>& path) {
-        visited[start] = true;
-        path.push_back(start);
-        cout << "Location " << start << " -> ";
-        
-        for (int i = 0; i < graph[start].size(); i++) {
-            if (graph[start][i] == 1 && !visited[i]) {
-                dfsRoute(graph, i, visited, path);
-            }
+    ~MappedFile() {
+#ifdef FDS_HAVE_MMAP
+        if (mapped) {
+            munmap(const_cast<char*>(data), length);
         }
+#endif
     }
     
-    static void demonstrateDFS() {
-        cout << "\n=== DELIVERY ROUTE OPTIMIZATION (DFS) ===\n";
-        cout << "Locations: 0=Restaurant, 1=Hub, 2=Customer1, 3=Customer2\n";
-        
-        vector<vector<int>> deliveryMap = {
-            {0, 1, 0, 1},
-            {1, 0, 1, 1},
-            {0, 1, 0, 0},
-            {1, 1, 0, 0}
-        };
-        
-        vector<bool> visited(4, false);
-        vector<int> path;
-        
-        cout << "DFS Route: ";
-        dfsRoute(deliveryMap, 0, visited, path);
-        cout << "END\n";
-    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool isOpen() const { return opened; }
+    string_view view() const { return string_view(data, length); }
 };
 
-// ======================= MAIN SYSTEM =======================
+#ifdef FDS_HAVE_MMAP
+// Flushes a file's data to stable storage
+inline bool syncDescriptor(int fd) {
+#ifdef __APPLE__
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
 
-class FoodDeliverySystem {
-private:
-    HashTable<Restaurant> restaurants;
-    HashTable<Customer> customers;
-    LinkedList<Order> pendingOrders;
-    LinkedList<Order> completedOrders;
-    Stack<string> orderHistory;
-    BST<MenuItem> menuSearchTree;
-    
-    static string generateId() {
-        return to_string(chrono::duration_cast<chrono::milliseconds>(
-            chrono::system_clock::now().time_since_epoch()).count());
+inline bool writeAll(int fd, string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(n));
     }
-    
-public:
-    FoodDeliverySystem() {
-        loadSystemData();
+    return true;
+}
+#endif
+
+// Replaces `path` with `data` so that a crash leaves either the old or the
+// new contents: writes and syncs a temporary file, renames it into place
+// and syncs the directory so the rename itself survives
+inline bool replaceFileDurably(const string& path, string_view data) {
+    string temp = path + ".tmp";
+#ifdef FDS_HAVE_MMAP
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool written = writeAll(fd, data) && fsync(fd) == 0;
+    if (::close(fd) != 0 || !written || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
     }
-    
-    void loadSystemData() {
-        cout << "Loading system data from files...\n";
+    string dir = filesystem::path(path).parent_path().string();
+    int dirFd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (dirFd < 0) return false;
+    bool synced = fsync(dirFd) == 0;
+    ::close(dirFd);
+    return synced;
+#else
+    {
+        ofstream file(temp, ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file) return false;
+    }
+    error_code ec;
+    filesystem::rename(temp, path, ec);
+    return !ec;
+#endif
+}
+
+struct ParseError {
+    size_t line;
+    string message;
+};
+
+inline void reportParseErrors(const string& path, const vector<ParseError>& errors) {
+    const size_t maxShown = 10;
+    for (size_t i = 0; i < errors.size() && i < maxShown; i++) {
+        cerr << path << ":" << errors[i].line << ": " << errors[i].message << "\n";
+    }
+    if (errors.size() > maxShown) {
+        cerr << path << ": " << (errors.size() - maxShown) << " more parse errors\n";
+    }
+}
+
+// Splits the next comma-separated field off the front of a line
+inline string_view nextField(string_view& line) {
+    size_t comma = line.find(',');
+    string_view field = line.substr(0, comma);
+    line.remove_prefix(comma == string_view::npos ? line.size() : comma + 1);
+    return field;
+}
+
+// Splits the next line (without its terminator) off the front of a buffer
+inline string_view nextLine(string_view& data) {
+    const void* found = memchr(data.data(), '\n', data.size());
+    size_t end = found ? static_cast<const char*>(found) - data.data() : data.size();
+    string_view line = data.substr(0, end);
+    data.remove_prefix(found ? end + 1 : end);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return line;
+}
+
+inline bool parseNumber(string_view text, double& out) {
+    auto result = from_chars(text.data(), text.data() + text.size(), out);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Optional trailing ",lat,lon" fields; both empty (or absent) means unknown
+inline bool parseLocation(string_view& line, GeoPoint& out) {
+    string_view lat = nextField(line);
+    string_view lon = nextField(line);
+    out = GeoPoint();
+    if (lat.empty() && lon.empty()) return true;
+    double latitude, longitude;
+    if (!parseNumber(lat, latitude) || !parseNumber(lon, longitude) ||
+        latitude < -90 || latitude > 90 || longitude < -180 || longitude > 180) {
+        return false;
+    }
+    out = GeoPoint(latitude, longitude);
+    return true;
+}
+
+struct RestaurantRecordView {
+    EntityId id;
+    string_view name;
+    double rating;
+    string_view address;
+    GeoPoint location;
+};
+
+struct MenuRecordView {
+    EntityId restaurantId;
+    string_view name;
+    Money price;
+    string_view category;
+};
+
+// Single pass over restaurants.dat content. Views point into `data`;
+// the visitor gets onRestaurant(RestaurantRecordView) and
+// onMenuItem(MenuRecordView) in file order.
+template<typename Visitor>
+size_t parseRestaurantData(string_view data, Visitor& visitor, vector<ParseError>& errors,
+                           size_t firstLine = 1) {
+    size_t lineNumber = firstLine;
+    for (; !data.empty(); lineNumber++) {
+        string_view line = nextLine(data);
+        if (line.empty()) continue;
         
-        vector<Restaurant> restaurantList = Restaurant::loadAllRestaurants();
-        for (const auto& restaurant : restaurantList) {
-            restaurants.insert(restaurant.id, restaurant);
-            for (const auto& item : restaurant.menu) {
-                menuSearchTree.insert(item);
+        if (line.size() > 5 && line.compare(0, 5, "MENU,") == 0) {
+            line.remove_prefix(5);
+            MenuRecordView item;
+            string_view restaurantId = nextField(line);
+            item.name = nextField(line);
+            string_view price = nextField(line);
+            item.category = nextField(line);
+            if (restaurantId.empty() || item.name.empty()) {
+                errors.push_back({lineNumber, "menu line is missing restaurant id or item name"});
+            } else if (!parseId(restaurantId, item.restaurantId)) {
+                errors.push_back({lineNumber, "invalid restaurant id '" + string(restaurantId) + "'"});
+            } else if (!Money::parse(price, item.price)) {
+                errors.push_back({lineNumber, "invalid menu price '" + string(price) + "'"});
+            } else {
+                visitor.onMenuItem(item);
+            }
+        } else {
+            RestaurantRecordView rest;
+            string_view id = nextField(line);
+            rest.name = nextField(line);
+            string_view rating = nextField(line);
+            rest.address = nextField(line);
+            if (id.empty()) {
+                errors.push_back({lineNumber, "restaurant line is missing its id"});
+            } else if (!parseId(id, rest.id)) {
+                errors.push_back({lineNumber, "invalid restaurant id '" + string(id) + "'"});
+            } else if (!parseNumber(rating, rest.rating)) {
+                errors.push_back({lineNumber, "invalid rating '" + string(rating) + "'"});
+            } else if (!parseLocation(line, rest.location)) {
+                errors.push_back({lineNumber, "invalid restaurant location"});
+            } else {
+                visitor.onRestaurant(rest);
             }
         }
+    }
+    return lineNumber - firstLine;
+}
+
+struct CustomerRecordView {
+    EntityId id;
+    string_view name;
+    string_view phone;
+    string_view address;
+    GeoPoint location;
+};
+
+// Single pass over customers.txt content; returns the number of lines read
+template<typename Visitor>
+size_t parseCustomerData(string_view data, Visitor& visitor, vector<ParseError>& errors,
+                         size_t firstLine = 1) {
+    size_t lineNumber = firstLine;
+    for (; !data.empty(); lineNumber++) {
+        string_view line = nextLine(data);
+        if (line.empty()) continue;
         
-        vector<Customer> customerList = Customer::loadAllCustomers();
-        for (const auto& customer : customerList) {
-            customers.insert(customer.id, customer);
+        CustomerRecordView rec;
+        string_view id = nextField(line);
+        rec.name = nextField(line);
+        rec.phone = nextField(line);
+        rec.address = nextField(line);
+        if (id.empty()) {
+            errors.push_back({lineNumber, "customer line is missing its id"});
+        } else if (!parseId(id, rec.id)) {
+            errors.push_back({lineNumber, "invalid customer id '" + string(id) + "'"});
+        } else if (!parseLocation(line, rec.location)) {
+            errors.push_back({lineNumber, "invalid customer location"});
+        } else {
+            visitor.onCustomer(rec);
         }
-        
-        cout << "System loaded: " << restaurantList.size() << " restaurants, " 
-             << customerList.size() << " customers\n\n";
     }
-    
-    void addRestaurant() {
+    return lineNumber - firstLine;
+}
+
+// Splits a buffer into at most `parts` pieces that end on line boundaries
+inline vector<string_view> splitAtLines(string_view data, size_t parts) {
+    vector<string_view> chunks;
+    size_t target = parts ? data.size() / parts + 1 : data.size();
+    while (!data.empty()) {
+        size_t end = min(target, data.size());
+        if (end < data.size()) {
+            size_t newline = data.find('\n', end - 1);
+            end = newline == string_view::npos ? data.size() : newline + 1;
+        }
+        chunks.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+    }
+    return chunks;
+}
+
+// ======================= WRITE-AHEAD LOG =======================
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320)
+inline uint32_t crc32(const char* data, size_t len, uint32_t crc = 0) {
+    static const auto table = [] {
+        array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Codes 1-4 were used while ids were strings; those records are skipped.
+// 0x13 and 0x14 carried copies of the menu items and text timestamps, and
+// 0x12 and 0x15 carried prices as doubles; they are still replayed but no
+// longer written.
+enum class WalRecordType : uint8_t {
+    CustomerAdded = 0x11,
+    RestaurantAddedV1 = 0x12,
+    OrderPlacedV1 = 0x13,
+    OrderStatusChangedV1 = 0x14,
+    OrderPlacedV2 = 0x15,
+    OrderStatusChanged = 0x16,
+    RestaurantAdded = 0x17,
+    OrderPlaced = 0x18
+};
+
+// Little helpers for record payloads: u32 length-prefixed strings,
+// raw doubles, u32 counts, u64 ids and i64 cents
+class WalEncoder {
+private:
+    string& out;
+    
+public:
+    explicit WalEncoder(string& buffer) : out(buffer) {}
+    
+    void putU8(uint8_t value) { out.push_back(static_cast<char>(value)); }
+    void putU32(uint32_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putU64(uint64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putDouble(double value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putMoney(Money value) { putU64(static_cast<uint64_t>(value.inCents())); }
+    void putString(string_view s) {
+        putU32(static_cast<uint32_t>(s.size()));
+        out.append(s.data(), s.size());
+    }
+};
+
+class WalDecoder {
+private:
+    string_view in;
+    bool failed;
+    
+    bool take(void* dest, size_t n) {
+        if (failed || in.size() < n) {
+            failed = true;
+            return false;
+        }
+        memcpy(dest, in.data(), n);
+        in.remove_prefix(n);
+        return true;
+    }
+    
+public:
+    explicit WalDecoder(string_view payload) : in(payload), failed(false) {}
+    
+    bool ok() const { return !failed; }
+    
+    // Lets decoders treat fields appended in later versions as optional
+    bool atEnd() const { return in.empty(); }
+    
+    uint8_t getU8() {
+        uint8_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+    
+    uint32_t getU32() {
+        uint32_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+    
+    uint64_t getU64() {
+        uint64_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+    
+    double getDouble() {
+        double value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+    
+    Money getMoney() { return Money::cents(static_cast<int64_t>(getU64())); }
+    
+    // Older record types stored amounts as doubles
+    Money getAmount(bool asDouble) { return asDouble ? Money::fromDouble(getDouble()) : getMoney(); }
+    
+    string getString() {
+        return string(getStringView());
+    }
+    
+    // Points into the payload, so it is only valid while the payload is
+    string_view getStringView() {
+        uint32_t len = getU32();
+        if (failed || in.size() < len) {
+            failed = true;
+            return string_view();
+        }
+        string_view value = in.substr(0, len);
+        in.remove_prefix(len);
+        return value;
+    }
+};
+
+struct WalOptions {
+    enum class Sync {
+        None,        // write in the background, never fsync
+        Group,       // commits wait for a shared fsync, batched over maxDelay
+        EveryCommit  // flush and fsync as soon as a commit arrives
+    };
+    
+    Sync sync = Sync::Group;
+    // How long the flusher waits for more commits before syncing a batch;
+    // higher values trade commit latency for fewer fsyncs
+    chrono::microseconds maxDelay = chrono::microseconds(2000);
+    // A batch is flushed early once this many bytes are buffered
+    size_t maxBatchBytes = 1 << 20;
+};
+
+// Thrown to a committer whose records could not be written or synced
+class LogWriteError : public runtime_error {
+public:
+    explicit LogWriteError(const string& path)
+        : runtime_error(path + ": log write failed, changes are not durable") {}
+};
+
+// Append-only log with framing [u32 length][u32 crc32][type][payload].
+// Writers append into a shared buffer; a flusher thread writes and syncs
+// whole batches (group commit) and wakes the committers it made durable.
+// A failed write or sync is sticky: nothing after it counts as durable
+// until reset() truncates the log behind a snapshot.
+class WriteAheadLog {
+private:
+    static constexpr size_t FRAME_HEADER = 2 * sizeof(uint32_t);
+    
+    string path;
+    WalOptions options;
+#ifdef FDS_HAVE_MMAP
+    int fd;
+#else
+    FILE* fp;
+#endif
+    bool opened;
+    
+    mutex logMutex;
+    condition_variable flushNeeded;
+    condition_variable durableChanged;
+    string buffer;
+    uint64_t nextLsn;
+    uint64_t batchFirstLsn = 1;
+    uint64_t flushedLsn;    // handed to writeOut, whether or not that worked
+    uint64_t durableLsn;
+    bool urgent;
+    bool stopping;
+    atomic<bool> failed{false};
+    atomic<bool> batching{false};
+    thread flusher;
+    
+    bool writeOut(const string& batch) {
+#ifdef FDS_HAVE_MMAP
+        if (!writeAll(fd, batch)) return false;
+        return options.sync == WalOptions::Sync::None || syncDescriptor(fd);
+#else
+        bool ok = fwrite(batch.data(), 1, batch.size(), fp) == batch.size();
+        return fflush(fp) == 0 && ok;
+#endif
+    }
+    
+    void flusherLoop() {
+        string batch;
+        unique_lock<mutex> lock(logMutex);
+        while (true) {
+            flushNeeded.wait(lock, [this] { return stopping || !buffer.empty(); });
+            if (buffer.empty() && stopping) return;
+            
+            // Give concurrent committers a chance to join this batch
+            if (!urgent && !stopping && options.sync != WalOptions::Sync::EveryCommit) {
+                flushNeeded.wait_for(lock, options.maxDelay, [this] {
+                    return stopping || urgent || buffer.size() >= options.maxBatchBytes;
+                });
+            }
+            
+            batch.swap(buffer);
+            uint64_t batchLsn = nextLsn - 1;
+            urgent = false;
+            bool skip = failed.load();
+            lock.unlock();
+            
+            // After a failure the file may end in a partial frame, so later
+            // batches are dropped rather than appended behind it
+            bool written = !skip && writeOut(batch);
+            if (!skip && !written) {
+                cerr << path << ": write failed: " << strerror(errno) << "\n";
+            }
+            batch.clear();
+            
+            lock.lock();
+            flushedLsn = batchLsn;
+            if (written) {
+                durableLsn = batchLsn;
+            } else {
+                failed = true;
+            }
+            durableChanged.notify_all();
+        }
+    }
+    
+public:
+    WriteAheadLog() : opened(false), nextLsn(1), flushedLsn(0), durableLsn(0), urgent(false), stopping(false) {
+#ifdef FDS_HAVE_MMAP
+        fd = -1;
+#else
+        fp = nullptr;
+#endif
+    }
+    
+    ~WriteAheadLog() {
+        close();
+    }
+    
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    
+    // validBytes comes from replay(); anything after it is a torn tail
+    bool open(const string& logPath, const WalOptions& opts, size_t validBytes) {
+        close();
+        path = logPath;
+        options = opts;
+#ifdef FDS_HAVE_MMAP
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) > validBytes) {
+            cerr << path << ": discarding " << (info.st_size - validBytes) << " bytes of torn log tail\n";
+            if (ftruncate(fd, validBytes) != 0) return false;
+        }
+#else
+        error_code ec;
+        if (filesystem::exists(path, ec) && filesystem::file_size(path, ec) > validBytes) {
+            filesystem::resize_file(path, validBytes, ec);
+        }
+        fp = fopen(path.c_str(), "ab");
+        if (!fp) return false;
+#endif
+        opened = true;
+        stopping = false;
+        failed = false;
+        flusher = thread([this] { flusherLoop(); });
+        return true;
+    }
+    
+    void close() {
+        if (!opened) return;
+        {
+            lock_guard<mutex> lock(logMutex);
+            stopping = true;
+        }
+        flushNeeded.notify_one();
+        flusher.join();
+#ifdef FDS_HAVE_MMAP
+        ::close(fd);
+        fd = -1;
+#else
+        fclose(fp);
+        fp = nullptr;
+#endif
+        opened = false;
+    }
+    
+    bool isOpen() const { return opened; }
+    bool hasFailed() const { return failed.load(); }
+    
+    // Buffers one framed record and returns its log sequence number
+    uint64_t append(WalRecordType type, string_view payload) {
+        char frame[FRAME_HEADER + 1];
+        uint32_t length = static_cast<uint32_t>(payload.size() + 1);
+        frame[FRAME_HEADER] = static_cast<char>(type);
+        uint32_t crc = crc32(payload.data(), payload.size(), crc32(&frame[FRAME_HEADER], 1));
+        memcpy(frame, &length, sizeof(length));
+        memcpy(frame + sizeof(length), &crc, sizeof(crc));
+        
+        lock_guard<mutex> lock(logMutex);
+        bool wasEmpty = buffer.empty();
+        buffer.append(frame, sizeof(frame));
+        buffer.append(payload.data(), payload.size());
+        uint64_t lsn = nextLsn++;
+        bool wasUrgent = urgent;
+        if (options.sync == WalOptions::Sync::EveryCommit || buffer.size() >= options.maxBatchBytes) {
+            urgent = true;
+        }
+        // The flusher only sleeps on an empty buffer or while gathering a
+        // batch, so later appends to the same batch need no wakeup
+        if (wasEmpty || (urgent && !wasUrgent)) {
+            flushNeeded.notify_one();
+        }
+        return lsn;
+    }
+    
+    // Blocks until the record with this LSN has been written (and synced);
+    // throws LogWriteError if that failed
+    void waitDurable(uint64_t lsn) {
+        unique_lock<mutex> lock(logMutex);
+        durableChanged.wait(lock, [this, lsn] { return flushedLsn >= lsn; });
+        if (durableLsn < lsn) throw LogWriteError(path);
+    }
+    
+    // Waits for the group commit covering `lsn` unless sync is None or a
+    // batch is open; without a wait, only an earlier failure is reported
+    void awaitCommit(uint64_t lsn) {
+        if (!opened || !lsn || batching.load(memory_order_relaxed)) return;
+        if (options.sync != WalOptions::Sync::None) {
+            waitDurable(lsn);
+        } else if (failed.load()) {
+            throw LogWriteError(path);
+        }
+    }
+    
+    uint64_t commit(WalRecordType type, string_view payload) {
+        if (!opened) return 0;
+        uint64_t lsn = append(type, payload);
+        awaitCommit(lsn);
+        return lsn;
+    }
+    
+    // Between beginBatch() and endBatch() commits only buffer, and endBatch()
+    // makes the whole batch durable at once, throwing LogWriteError if it
+    // could not. Callers must hold back any acknowledgement until then.
+    void beginBatch() {
+        batching.store(true, memory_order_relaxed);
+        lock_guard<mutex> lock(logMutex);
+        batchFirstLsn = nextLsn;
+    }
+    
+    // A batch that logged nothing succeeds even while the log is failed
+    void endBatch() {
+        batching.store(false, memory_order_relaxed);
+        if (!opened) return;
+        uint64_t target = handOff();
+        if (target >= batchFirstLsn) waitDurable(target);
+    }
+    
+    // Asks the flusher to write everything buffered now; returns the LSN
+    // that covers it
+    uint64_t handOff() {
+        uint64_t target;
+        {
+            lock_guard<mutex> lock(logMutex);
+            target = nextLsn - 1;
+            urgent = true;
+        }
+        flushNeeded.notify_one();
+        return target;
+    }
+    
+    // Forces everything buffered so far to disk; throws LogWriteError if
+    // any of it is not durable
+    void flush() {
+        if (!opened) return;
+        waitDurable(handOff());
+    }
+    
+    // Drops all records once a snapshot made them redundant. That also
+    // clears a write failure: everything logged is in the snapshot now.
+    void reset() {
+        if (!opened) return;
+        uint64_t target = handOff();
+        unique_lock<mutex> lock(logMutex);
+        durableChanged.wait(lock, [this, target] { return flushedLsn >= target; });
+#ifdef FDS_HAVE_MMAP
+        bool truncated = ftruncate(fd, 0) == 0 && syncDescriptor(fd);
+#else
+        fclose(fp);
+        fp = fopen(path.c_str(), "wb");
+        bool truncated = fp != nullptr;
+#endif
+        if (!truncated) {
+            cerr << path << ": failed to truncate log\n";
+            failed = true;
+            return;
+        }
+        durableLsn = flushedLsn;
+        failed = false;
+    }
+    
+    // Calls apply(type, decoder) for each intact record in order and returns
+    // the byte length of the valid prefix; stops at the first torn or
+    // corrupt frame
+    template<typename Apply>
+    static size_t replay(const string& logPath, Apply apply, size_t& records) {
+        records = 0;
+        MappedFile file(logPath);
+        if (!file.isOpen()) return 0;
+        
+        string_view data = file.view();
+        size_t offset = 0;
+        while (data.size() - offset >= FRAME_HEADER + 1) {
+            uint32_t length, crc;
+            memcpy(&length, data.data() + offset, sizeof(length));
+            memcpy(&crc, data.data() + offset + sizeof(length), sizeof(crc));
+            if (length == 0 || length > data.size() - offset - FRAME_HEADER) break;
+            
+            string_view body = data.substr(offset + FRAME_HEADER, length);
+            if (crc32(body.data(), body.size()) != crc) break;
+            
+            WalDecoder decoder(body.substr(1));
+            apply(static_cast<WalRecordType>(body[0]), decoder);
+            offset += FRAME_HEADER + length;
+            records++;
+        }
+        if (offset < data.size()) {
+            cerr << logPath << ": log ends with a torn or corrupt record at byte " << offset << "\n";
+        }
+        return offset;
+    }
+};
+
+// ======================= ASYNC LOGGING =======================
+
+// ctime()-style local time ("Wed Jun 30 21:49:08 1993") without the
+// trailing newline. Uses localtime_r and caches the text for the current
+// second per thread, so hot paths can stamp records cheaply.
+inline string_view formatTimestamp(time_t seconds) {
+    thread_local time_t cachedSecond = -1;
+    thread_local char text[32];
+    thread_local size_t length = 0;
+    if (seconds != cachedSecond) {
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &seconds);
+#else
+        localtime_r(&seconds, &local);
+#endif
+        length = strftime(text, sizeof(text), "%a %b %e %H:%M:%S %Y", &local);
+        cachedSecond = seconds;
+    }
+    return string_view(text, length);
+}
+
+// Reads formatTimestamp's text back as local time; 0 if it does not parse
+inline time_t parseTimestamp(string_view text) {
+    struct tm local = {};
+    istringstream in{string(text)};
+    in >> get_time(&local, "%a %b %e %H:%M:%S %Y");
+    if (in.fail()) return 0;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// Fixed-size status-change record; copied into the ring as-is
+struct StatusEvent {
+    EntityId orderId;
+    int64_t epochSeconds;
+    char status[24];
+    uint8_t statusLength;
+};
+
+// Human-readable order_tracking.log written off the caller's thread.
+// Producers push StatusEvents into a lock-free ring; a background thread
+// drains it, formats the lines and appends them in batches.
+class AsyncStatusLog {
+public:
+    enum class Overflow {
+        DropNewest,  // count and discard events while the ring is full
+        Block        // spin (yielding) until the writer frees a slot
+    };
+    
+private:
+    MpscRingBuffer<StatusEvent> ring;
+    Overflow overflow;
+    string path;
+    atomic<bool> stopping;
+    atomic<uint64_t> dropped;
+    thread writer;
+    
+    static void formatEvent(const StatusEvent& e, string& out) {
+        char id[24];
+        out.append(id, to_chars(id, id + sizeof(id), e.orderId).ptr);
+        out += " status changed to ";
+        out.append(e.status, e.statusLength);
+        out += " at ";
+        out += formatTimestamp(static_cast<time_t>(e.epochSeconds));
+        out += '\n';
+    }
+    
+    void writerLoop() {
+        ofstream file(path, ios::app);
+        string batch;
+        StatusEvent event;
+        uint64_t reportedDrops = 0;
+        auto idle = chrono::microseconds(50);
+        
+        while (true) {
+            size_t drained = 0;
+            while (drained < 4096 && ring.tryPop(event)) {
+                formatEvent(event, batch);
+                drained++;
+            }
+            uint64_t drops = dropped.load(memory_order_relaxed);
+            if (drops != reportedDrops) {
+                batch += "[" + to_string(drops - reportedDrops) + " status events dropped: log buffer full]\n";
+                reportedDrops = drops;
+            }
+            if (!batch.empty()) {
+                file.write(batch.data(), batch.size());
+                file.flush();
+                batch.clear();
+            }
+            
+            if (drained == 0) {
+                // Checked only after an empty pass so shutdown drains everything
+                if (stopping.load(memory_order_acquire)) return;
+                this_thread::sleep_for(idle);
+                idle = min(idle * 2, chrono::microseconds(2000));
+            } else {
+                idle = chrono::microseconds(50);
+            }
+        }
+    }
+    
+public:
+    AsyncStatusLog(const string& logPath, size_t capacity = 1 << 14, Overflow policy = Overflow::Block)
+        : ring(capacity), overflow(policy), path(logPath), stopping(false), dropped(0) {
+        writer = thread([this] { writerLoop(); });
+    }
+    
+    ~AsyncStatusLog() {
+        stopping.store(true, memory_order_release);
+        writer.join();
+    }
+    
+    AsyncStatusLog(const AsyncStatusLog&) = delete;
+    AsyncStatusLog& operator=(const AsyncStatusLog&) = delete;
+    
+    // Allocation-free; only waits when the ring is full under Overflow::Block
+    void log(EntityId orderId, string_view status, int64_t epochSeconds) {
+        StatusEvent event;
+        event.orderId = orderId;
+        event.statusLength = static_cast<uint8_t>(min(status.size(), sizeof(event.status)));
+        memcpy(event.status, status.data(), event.statusLength);
+        event.epochSeconds = epochSeconds;
+        
+        while (!ring.tryPush(event)) {
+            if (overflow == Overflow::DropNewest) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            this_thread::yield();
+        }
+    }
+    
+    uint64_t droppedEvents() const { return dropped.load(memory_order_relaxed); }
+    
+    // Process-wide order_tracking.log sink, flushed when the program exits
+    static AsyncStatusLog& orderTracking() {
+        static AsyncStatusLog instance("order_tracking.log");
+        return instance;
+    }
+};
+
+// ======================= DOMAIN CLASSES =======================
+
+// Menu position recorded for an ordered item that is no longer on the menu
+const uint32_t UNLISTED_ITEM = UINT32_MAX;
+
+// Names and categories are interned: they repeat across menus, and a
+// category filter is then an integer comparison
+class MenuItem {
+public:
+    Symbol name;
+    Symbol category;
+    Money price;
+    bool retired = false;    // off the menu, kept so old orders still resolve
+    
+    MenuItem() {}
+    MenuItem(string_view n, Money p, string_view cat) : name(n), category(cat), price(p) {}
+    MenuItem(Symbol n, Money p, Symbol cat) : name(n), category(cat), price(p) {}
+    
+    bool operator<(const MenuItem& other) const { return price < other.price; }
+    bool operator>(const MenuItem& other) const { return price > other.price; }
+    bool operator==(const MenuItem& other) const { return name == other.name; }
+    
+    string toString() const {
+        return string(name.text()) + "," + price.toString() + "," + string(category.text());
+    }
+    
+    void encode(WalEncoder& out) const {
+        out.putString(name.text());
+        out.putMoney(price);
+        out.putString(category.text());
+    }
+    
+    static MenuItem decode(WalDecoder& in, bool doublePrice = false) {
+        MenuItem item;
+        item.name = Symbol(in.getStringView());
+        item.price = in.getAmount(doublePrice);
+        item.category = Symbol(in.getStringView());
+        return item;
+    }
+    
+    static MenuItem fromString(const string& str) {
+        stringstream ss(str);
+        string name, category, priceStr;
+        getline(ss, name, ',');
+        getline(ss, priceStr, ',');
+        getline(ss, category, ',');
+        Money price;
+        Money::parse(priceStr, price);
+        return MenuItem(name, price, category);
+    }
+};
+
+class Customer {
+public:
+    EntityId id;
+    string name;
+    string phone;
+    string address;
+    GeoPoint location;
+    
+    Customer() : id(0), name(""), phone(""), address("") {}
+    Customer(EntityId i, const string& n, const string& p, const string& addr)
+        : id(i), name(n), phone(p), address(addr) {}
+    
+    void encode(WalEncoder& out) const {
+        out.putU64(id);
+        out.putString(name);
+        out.putString(phone);
+        out.putString(address);
+        out.putDouble(location.latitude);
+        out.putDouble(location.longitude);
+    }
+    
+    // Buffers the record and returns its LSN (0 with the log closed); the
+    // caller waits for it with WriteAheadLog::awaitCommit
+    uint64_t appendToLog(WriteAheadLog& wal) const {
+        thread_local string payload;
+        payload.clear();
+        WalEncoder out(payload);
+        encode(out);
+        return wal.isOpen() ? wal.append(WalRecordType::CustomerAdded, payload) : 0;
+    }
+    
+    static Customer decode(WalDecoder& in) {
+        Customer customer;
+        customer.id = in.getU64();
+        customer.name = in.getString();
+        customer.phone = in.getString();
+        customer.address = in.getString();
+        if (!in.atEnd()) {
+            customer.location.latitude = in.getDouble();
+            customer.location.longitude = in.getDouble();
+        }
+        return customer;
+    }
+    
+    static Customer fromRecord(const CustomerRecordView& rec) {
+        Customer customer(rec.id, string(rec.name), string(rec.phone), string(rec.address));
+        customer.location = rec.location;
+        return customer;
+    }
+    
+    static vector<Customer> loadAllCustomers(const string& path = "customers.txt") {
+        struct Builder {
+            vector<Customer> customers;
+            void onCustomer(const CustomerRecordView& rec) { customers.push_back(fromRecord(rec)); }
+        };
+        
+        MappedFile file(path);
+        if (!file.isOpen()) return {};
+        
+        Builder builder;
+        vector<ParseError> errors;
+        parseCustomerData(file.view(), builder, errors);
+        reportParseErrors(path, errors);
+        return move(builder.customers);
+    }
+};
+
+class Restaurant {
+public:
+    EntityId id;
+    string name;
+    double rating;
+    string address;
+    GeoPoint location;
+    vector<MenuItem> menu;
+    
+    Restaurant() : id(0), name(""), rating(0.0), address("") {}
+    Restaurant(EntityId i, const string& n, double r, const string& addr)
+        : id(i), name(n), rating(r), address(addr) {}
+    
+    void addMenuItem(const MenuItem& item) {
+        menu.push_back(item);
+    }
+    
+    // Menu position of the first item with this name, or UNLISTED_ITEM
+    uint32_t findItem(string_view itemName) const {
+        Symbol wanted;
+        if (!Symbol::find(itemName, wanted)) return UNLISTED_ITEM;
+        for (size_t i = 0; i < menu.size(); i++) {
+            if (menu[i].name == wanted) return static_cast<uint32_t>(i);
+        }
+        return UNLISTED_ITEM;
+    }
+    
+    // The item at a menu position, retired or not, e.g. for an order line
+    const MenuItem* item(uint32_t index) const {
+        return index < menu.size() ? &menu[index] : nullptr;
+    }
+    
+    // The item at a menu position if it can still be ordered
+    const MenuItem* listedItem(uint32_t index) const {
+        const MenuItem* found = item(index);
+        return found && !found->retired ? found : nullptr;
+    }
+    
+    // Order lines name items by position, so a replacement menu never moves
+    // one: items of `previous` keep their places, taking the new price and
+    // category when this menu still lists them and retired when it does
+    // not, and items new to this menu go on the end
+    void keepMenuPositions(const vector<MenuItem>& previous) {
+        vector<MenuItem> merged = previous;
+        vector<bool> placed(menu.size(), false);
+        for (auto& old : merged) {
+            old.retired = true;
+            for (size_t i = 0; i < menu.size(); i++) {
+                if (!placed[i] && menu[i].name == old.name) {
+                    old = menu[i];
+                    placed[i] = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < menu.size(); i++) {
+            if (!placed[i]) merged.push_back(move(menu[i]));
+        }
+        menu = move(merged);
+    }
+    
+    void encode(WalEncoder& out) const {
+        out.putU64(id);
+        out.putString(name);
+        out.putDouble(rating);
+        out.putString(address);
+        out.putU32(static_cast<uint32_t>(menu.size()));
+        for (const auto& item : menu) {
+            item.encode(out);
+        }
+        out.putDouble(location.latitude);
+        out.putDouble(location.longitude);
+        uint32_t retired = 0;
+        for (const auto& item : menu) retired += item.retired;
+        out.putU32(retired);
+        for (size_t i = 0; i < menu.size(); i++) {
+            if (menu[i].retired) out.putU32(static_cast<uint32_t>(i));
+        }
+    }
+    
+    // See Customer::appendToLog
+    uint64_t appendToLog(WriteAheadLog& wal) const {
+        thread_local string payload;
+        payload.clear();
+        WalEncoder out(payload);
+        encode(out);
+        return wal.isOpen() ? wal.append(WalRecordType::RestaurantAdded, payload) : 0;
+    }
+    
+    // doublePrices for RestaurantAddedV1 records
+    static Restaurant decode(WalDecoder& in, bool doublePrices = false) {
+        Restaurant restaurant;
+        restaurant.id = in.getU64();
+        restaurant.name = in.getString();
+        restaurant.rating = in.getDouble();
+        restaurant.address = in.getString();
+        uint32_t count = in.getU32();
+        for (uint32_t i = 0; i < count && in.ok(); i++) {
+            restaurant.menu.push_back(MenuItem::decode(in, doublePrices));
+        }
+        if (!in.atEnd()) {
+            restaurant.location.latitude = in.getDouble();
+            restaurant.location.longitude = in.getDouble();
+        }
+        // Retired menu positions, absent from older records
+        if (!in.atEnd()) {
+            uint32_t retired = in.getU32();
+            for (uint32_t i = 0; i < retired && in.ok(); i++) {
+                uint32_t index = in.getU32();
+                if (index < restaurant.menu.size()) restaurant.menu[index].retired = true;
+            }
+        }
+        return restaurant;
+    }
+    
+    static vector<Restaurant> loadAllRestaurants(const string& path = "restaurants.dat") {
+        // Menu lines normally follow their restaurant, so the last record
+        // is checked before falling back to the id index
+        struct Builder {
+            vector<Restaurant> restaurants;
+            HashTable<size_t, EntityId> index;
+            size_t orphanMenuItems = 0;
+            
+            void onRestaurant(const RestaurantRecordView& rec) {
+                index.insert(rec.id, restaurants.size());
+                restaurants.emplace_back(rec.id, string(rec.name), rec.rating, string(rec.address));
+                restaurants.back().location = rec.location;
+            }
+            
+            void onMenuItem(const MenuRecordView& rec) {
+                Restaurant* owner = nullptr;
+                if (!restaurants.empty() && restaurants.back().id == rec.restaurantId) {
+                    owner = &restaurants.back();
+                } else if (size_t* pos = index.search(rec.restaurantId)) {
+                    owner = &restaurants[*pos];
+                }
+                if (owner) {
+                    owner->menu.emplace_back(rec.name, rec.price, rec.category);
+                } else {
+                    orphanMenuItems++;
+                }
+            }
+        };
+        
+        MappedFile file(path);
+        if (!file.isOpen()) return {};
+        
+        Builder builder;
+        vector<ParseError> errors;
+        parseRestaurantData(file.view(), builder, errors);
+        reportParseErrors(path, errors);
+        if (builder.orphanMenuItems > 0) {
+            cerr << path << ": " << builder.orphanMenuItems << " menu items reference unknown restaurants\n";
+        }
+        return move(builder.restaurants);
+    }
+    
+    bool operator<(const Restaurant& other) const {
+        return rating > other.rating;
+    }
+};
+
+enum class OrderStatus : uint8_t {
+    Pending,
+    Accepted,
+    Preparing,
+    PickedUp,
+    Delivered,
+    Cancelled
+};
+
+const size_t ORDER_STATUS_COUNT = 6;
+
+inline const char* statusName(OrderStatus status) {
+    static const char* names[] = {"Pending", "Accepted", "Preparing", "PickedUp", "Delivered", "Cancelled"};
+    return names[static_cast<size_t>(status)];
+}
+
+inline bool parseStatus(string_view name, OrderStatus& status) {
+    for (size_t i = 0; i < ORDER_STATUS_COUNT; i++) {
+        if (name == statusName(static_cast<OrderStatus>(i))) {
+            status = static_cast<OrderStatus>(i);
+            return true;
+        }
+    }
+    // Older logs used a free-form "Completed"
+    if (name == "Completed") {
+        status = OrderStatus::Delivered;
+        return true;
+    }
+    return false;
+}
+
+inline bool isTerminal(OrderStatus status) {
+    return status == OrderStatus::Delivered || status == OrderStatus::Cancelled;
+}
+
+// Orders move one step forward at a time; anything before pickup can be cancelled
+inline bool canTransition(OrderStatus from, OrderStatus to) {
+    if (isTerminal(from)) return false;
+    if (to == OrderStatus::Cancelled) return from != OrderStatus::PickedUp;
+    return static_cast<int>(to) == static_cast<int>(from) + 1;
+}
+
+// One ordered item: its position in the restaurant's menu and the price
+// charged, kept so later menu changes cannot alter what was paid
+struct OrderLine {
+    uint32_t item;
+    Money price;
+};
+
+// Orders name their items by menu position rather than copying them (menus
+// are append-only, see Restaurant::keepMenuPositions), and keep up to
+// ORDER_INLINE_LINES lines inside the order itself
+const uint32_t ORDER_INLINE_LINES = 4;
+
+class Order {
+public:
+    EntityId orderId;
+    EntityId customerId;
+    EntityId restaurantId;
+    Handle restaurant;    // into the owner's EntityStore; invalid where there is none
+    InlineVector<OrderLine, ORDER_INLINE_LINES> lines;
+    Money totalAmount;
+    time_t updatedAt;     // when the order last changed status
+    OrderStatus status;
+    
+    Order() : orderId(0), customerId(0), restaurantId(0), updatedAt(time(nullptr)),
+              status(OrderStatus::Pending) {}
+    
+    Order(EntityId oid, EntityId cid, EntityId rid)
+        : orderId(oid), customerId(cid), restaurantId(rid), updatedAt(time(nullptr)),
+          status(OrderStatus::Pending) {}
+    
+    void addLine(uint32_t item, Money price) {
+        lines.push_back(OrderLine{item, price});
+        totalAmount += price;
+    }
+    
+    // False when the index is past the end of the menu or the item is retired
+    bool addItem(const Restaurant& from, uint32_t index) {
+        const MenuItem* item = from.listedItem(index);
+        if (!item) return false;
+        addLine(index, item->price);
+        return true;
+    }
+    
+    // Sets and stamps the new status; persisting it is up to the caller
+    time_t setStatus(OrderStatus newStatus) {
+        status = newStatus;
+        updatedAt = time(nullptr);
+        return updatedAt;
+    }
+    
+    // Valid until the next formatTimestamp call on this thread
+    string_view timestamp() const { return formatTimestamp(updatedAt); }
+    
+    void encodeStatusChange(WalEncoder& out) const {
+        out.putU64(orderId);
+        out.putU8(static_cast<uint8_t>(status));
+        out.putU64(static_cast<uint64_t>(updatedAt));
+    }
+    
+    // Either generation of status record; false if it cannot be applied
+    static bool decodeStatusChange(WalRecordType type, WalDecoder& in, EntityId& orderId, OrderStatus& status,
+                                   time_t& at) {
+        orderId = in.getU64();
+        bool known;
+        if (type == WalRecordType::OrderStatusChangedV1) {
+            known = parseStatus(in.getString(), status);
+            at = parseTimestamp(in.getString());
+        } else {
+            uint8_t code = in.getU8();
+            known = code < ORDER_STATUS_COUNT;
+            status = static_cast<OrderStatus>(code);
+            at = static_cast<time_t>(in.getU64());
+        }
+        return in.ok() && known;
+    }
+    
+    void encode(WalEncoder& out) const {
+        out.putU64(orderId);
+        out.putU64(customerId);
+        out.putU64(restaurantId);
+        out.putMoney(totalAmount);
+        out.putU8(static_cast<uint8_t>(status));
+        out.putU64(static_cast<uint64_t>(updatedAt));
+        out.putU32(static_cast<uint32_t>(lines.size()));
+        for (const auto& line : lines) {
+            out.putU32(line.item);
+            out.putMoney(line.price);
+        }
+    }
+    
+    // See Customer::appendToLog
+    uint64_t appendToLog(WriteAheadLog& wal) const {
+        thread_local string payload;
+        payload.clear();
+        WalEncoder out(payload);
+        encode(out);
+        return wal.isOpen() ? wal.append(WalRecordType::OrderPlaced, payload) : 0;
+    }
+    
+    void saveToLog(WriteAheadLog& wal) const { wal.awaitCommit(appendToLog(wal)); }
+    
+    // doubleAmounts for OrderPlacedV2 records
+    static Order decode(WalDecoder& in, bool doubleAmounts = false) {
+        Order order;
+        order.orderId = in.getU64();
+        order.customerId = in.getU64();
+        order.restaurantId = in.getU64();
+        order.totalAmount = in.getAmount(doubleAmounts);
+        uint8_t code = in.getU8();
+        order.status = code < ORDER_STATUS_COUNT ? static_cast<OrderStatus>(code) : OrderStatus::Pending;
+        order.updatedAt = static_cast<time_t>(in.getU64());
+        uint32_t count = in.getU32();
+        for (uint32_t i = 0; i < count && in.ok(); i++) {
+            uint32_t item = in.getU32();
+            order.lines.push_back(OrderLine{item, in.getAmount(doubleAmounts)});
+        }
+        return order;
+    }
+    
+    // V1 records copied whole menu items; findItem(restaurantId, name)
+    // maps each back to its menu position (UNLISTED_ITEM if it is gone)
+    template<typename FindItem>
+    static Order decodeV1(WalDecoder& in, FindItem findItem) {
+        Order order;
+        order.orderId = in.getU64();
+        order.customerId = in.getU64();
+        order.restaurantId = in.getU64();
+        order.totalAmount = Money::fromDouble(in.getDouble());
+        parseStatus(in.getString(), order.status);
+        order.updatedAt = parseTimestamp(in.getString());
+        uint32_t count = in.getU32();
+        for (uint32_t i = 0; i < count && in.ok(); i++) {
+            // Laid out as MenuItem::encode writes it; the category is not needed
+            string_view name = in.getStringView();
+            Money price = Money::fromDouble(in.getDouble());
+            in.getStringView();
+            order.lines.push_back(OrderLine{findItem(order.restaurantId, name), price});
+        }
+        return order;
+    }
+    
+    bool operator==(const Order& other) const {
+        return orderId == other.orderId;
+    }
+};
+
+// ======================= ENTITY STORE =======================
+
+// Owns every restaurant and customer exactly once. Restaurants sit in a
+// slot map, so orders can keep handles to them, with a hash index from ID
+// to handle; they are not synchronized, which is left to the owner.
+// Customers are only ever looked up by ID, so they live in a lock-striped
+// table that any number of threads may register into and read at once.
+class EntityStore {
+private:
+    SlotMap<Restaurant> restaurants;
+    HashTable<Handle, EntityId> restaurantIndex;
+    StripedHashTable<Customer, EntityId> customers;
+    
+public:
+    using Index = HashTable<Handle, EntityId>;
+    
+    void reserve(size_t restaurantCount, size_t customerCount) {
+        restaurants.reserve(restaurantCount);
+        restaurantIndex.reserve(restaurantCount);
+        customers.reserve(customerCount);
+    }
+    
+    Handle addRestaurant(Restaurant&& restaurant) {
+        uint64_t hash = Index::hashKey(restaurant.id);
+        return addRestaurant(move(restaurant), hash);
+    }
+    
+    // idHash must be Index::hashKey(restaurant.id); loaders precompute it off-thread
+    Handle addRestaurant(Restaurant&& restaurant, uint64_t idHash) {
+        Handle* existing = restaurantIndex.search(restaurant.id, idHash);
+        if (existing) {
+            *restaurants.get(*existing) = move(restaurant);
+            return *existing;
+        }
+        EntityId id = restaurant.id;
+        Handle h = restaurants.insert(move(restaurant));
+        restaurantIndex.insert(id, Handle(h), idHash);
+        return h;
+    }
+    
+    void addCustomer(Customer&& customer) {
+        uint64_t hash = Index::hashKey(customer.id);
+        addCustomer(move(customer), hash);
+    }
+    
+    void addCustomer(Customer&& customer, uint64_t idHash) {
+        EntityId id = customer.id;
+        customers.insert(id, move(customer), idHash);
+    }
+    
+    // Adds or replaces a customer and runs then(stored) under the same
+    // stripe lock, so e.g. log records for one ID are in the order applied
+    template<typename Then>
+    auto addCustomer(Customer&& customer, Then then) {
+        EntityId id = customer.id;
+        return customers.write(id, [&](auto& stripe, uint64_t hash) {
+            stripe.insert(id, move(customer), hash);
+            return then(*stripe.search(id, hash));
+        });
+    }
+    
+    // fn(const Customer*) under the customer's stripe lock; null if unknown
+    template<typename F>
+    auto readCustomer(EntityId id, F fn) const { return customers.read(id, fn); }
+    
+    // Stripe by stripe, so not a consistent snapshot while others register
+    template<typename F>
+    void forEachCustomer(F fn) const {
+        customers.forEach([&fn](EntityId, const Customer& customer) { fn(customer); });
+    }
+    
+    Handle restaurantHandle(EntityId id) const {
+        const Handle* h = restaurantIndex.search(id);
+        return h ? *h : Handle();
+    }
+    
+    Restaurant* restaurant(Handle h) { return restaurants.get(h); }
+    Restaurant* findRestaurant(EntityId id) { return restaurants.get(restaurantHandle(id)); }
+    
+    const SlotMap<Restaurant>& allRestaurants() const { return restaurants; }
+    
+    size_t restaurantCount() const { return restaurants.size(); }
+    size_t customerCount() const { return customers.size(); }
+};
+
+// ======================= MENU INDEX =======================
+
+// One menu item as seen by the price index
+struct MenuEntry {
+    Money price;
+    EntityId restaurantId;
+    Symbol name;
+    Symbol category;
+    
+    MenuEntry(Money p, EntityId rid, Symbol n, Symbol cat)
+        : price(p), restaurantId(rid), name(n), category(cat) {}
+    
+    // Composite key (price, restaurant, name); equal keys are kept side by side
+    bool operator<(const MenuEntry& other) const {
+        if (price != other.price) return price < other.price;
+        if (restaurantId != other.restaurantId) return restaurantId < other.restaurantId;
+        return name != other.name && name.text() < other.name.text();
+    }
+};
+
+// Ordered index over every menu item, stored as a sorted flat array plus a
+// small sorted staging array for incremental inserts. The staging array is
+// merged into the main one once it outgrows sqrt(n), so inserts cost
+// O(sqrt n) amortized while lookups stay binary searches over contiguous
+// memory. Queries walk both arrays in step: O(log n + k) for k results.
+class MenuIndex {
+private:
+    static constexpr size_t MIN_STAGED = 256;
+    
+    vector<MenuEntry> entries;
+    vector<MenuEntry> staged;
+    
+    static bool priceBelow(const MenuEntry& entry, Money price) { return entry.price < price; }
+    
+    void mergeStaged() {
+        size_t middle = entries.size();
+        entries.insert(entries.end(), make_move_iterator(staged.begin()), make_move_iterator(staged.end()));
+        inplace_merge(entries.begin(), entries.begin() + middle, entries.end());
+        staged.clear();
+    }
+    
+    // Visits entries from the two sorted ranges in key order until fn returns false
+    template<typename F>
+    static void walk(vector<MenuEntry>::const_iterator a, vector<MenuEntry>::const_iterator aEnd,
+                     vector<MenuEntry>::const_iterator b, vector<MenuEntry>::const_iterator bEnd, F fn) {
+        while (a != aEnd || b != bEnd) {
+            bool takeB = a == aEnd || (b != bEnd && *b < *a);
+            if (!fn(takeB ? *b++ : *a++)) return;
+        }
+    }
+    
+public:
+    // Bulk build: one sort over everything, replacing the current contents
+    void build(vector<MenuEntry>&& all) {
+        entries = move(all);
+        staged.clear();
+        sort(entries.begin(), entries.end());
+    }
+    
+    void insert(MenuEntry&& entry) {
+        staged.insert(upper_bound(staged.begin(), staged.end(), entry), move(entry));
+        size_t limit = max(MIN_STAGED, static_cast<size_t>(sqrt(static_cast<double>(entries.size()))));
+        if (staged.size() > limit) mergeStaged();
+    }
+    
+    void addMenu(const Restaurant& restaurant) {
+        for (const auto& item : restaurant.menu) {
+            if (item.retired) continue;
+            insert(MenuEntry(item.price, restaurant.id, item.name, item.category));
+        }
+    }
+    
+    // O(n); only needed when a restaurant record is replaced
+    void eraseRestaurant(EntityId restaurantId) {
+        auto owned = [restaurantId](const MenuEntry& e) { return e.restaurantId == restaurantId; };
+        entries.erase(remove_if(entries.begin(), entries.end(), owned), entries.end());
+        staged.erase(remove_if(staged.begin(), staged.end(), owned), staged.end());
+    }
+    
+    // Every entry with minPrice <= price <= maxPrice, cheapest first
+    template<typename F>
+    void forEachInRange(Money minPrice, Money maxPrice, F fn) const {
+        walk(lower_bound(entries.begin(), entries.end(), minPrice, priceBelow), entries.end(),
+             lower_bound(staged.begin(), staged.end(), minPrice, priceBelow), staged.end(),
+             [&](const MenuEntry& e) {
+                 if (e.price > maxPrice) return false;
+                 fn(e);
+                 return true;
+             });
+    }
+    
+    // The k cheapest entries in key order
+    template<typename F>
+    void forEachCheapest(size_t k, F fn) const {
+        size_t seen = 0;
+        walk(entries.begin(), entries.end(), staged.begin(), staged.end(),
+             [&](const MenuEntry& e) {
+                 if (seen++ == k) return false;
+                 fn(e);
+                 return true;
+             });
+    }
+    
+    template<typename F>
+    void forEach(F fn) const {
+        forEachCheapest(size(), fn);
+    }
+    
+    size_t size() const { return entries.size() + staged.size(); }
+};
+
+// ======================= MENU SEARCH =======================
+
+// Splits text into lowercase ASCII alphanumeric tokens
+template<typename F>
+void forEachToken(string_view text, F fn) {
+    string token;
+    for (size_t i = 0; i <= text.size(); i++) {
+        char c = i < text.size() ? text[i] : ' ';
+        if (isalnum(static_cast<unsigned char>(c))) {
+            token += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        } else if (!token.empty()) {
+            fn(token);
+            token.clear();
+        }
+    }
+}
+
+// Prefix tree over the term dictionary for type-ahead. Nodes live in one
+// vector; children form a sibling list sorted by character.
+class TermTrie {
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    
+    struct Node {
+        uint32_t firstChild = NONE;
+        uint32_t nextSibling = NONE;
+        uint32_t termId = NONE;
+        char c = 0;
+    };
+    
+    vector<Node> nodes;
+    
+    uint32_t child(uint32_t parent, char c) const {
+        uint32_t n = nodes[parent].firstChild;
+        while (n != NONE && nodes[n].c < c) n = nodes[n].nextSibling;
+        return n != NONE && nodes[n].c == c ? n : NONE;
+    }
+    
+    uint32_t addChild(uint32_t parent, char c) {
+        uint32_t prev = NONE;
+        uint32_t n = nodes[parent].firstChild;
+        while (n != NONE && nodes[n].c < c) {
+            prev = n;
+            n = nodes[n].nextSibling;
+        }
+        if (n != NONE && nodes[n].c == c) return n;
+        
+        Node node;
+        node.c = c;
+        node.nextSibling = n;
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(node);
+        if (prev == NONE) {
+            nodes[parent].firstChild = index;
+        } else {
+            nodes[prev].nextSibling = index;
+        }
+        return index;
+    }
+    
+    // Depth-first in character order; false once the callback asks to stop
+    template<typename F>
+    bool collect(uint32_t node, F& fn) const {
+        if (nodes[node].termId != NONE && !fn(nodes[node].termId)) return false;
+        for (uint32_t n = nodes[node].firstChild; n != NONE; n = nodes[n].nextSibling) {
+            if (!collect(n, fn)) return false;
+        }
+        return true;
+    }
+    
+public:
+    TermTrie() : nodes(1) {}
+    
+    void insert(string_view term, uint32_t termId) {
+        uint32_t node = 0;
+        for (char c : term) node = addChild(node, c);
+        nodes[node].termId = termId;
+    }
+    
+    // Visits the ids of all terms starting with `prefix` in lexical order
+    // until fn returns false
+    template<typename F>
+    void forEachWithPrefix(string_view prefix, F fn) const {
+        uint32_t node = 0;
+        for (char c : prefix) {
+            node = child(node, c);
+            if (node == NONE) return;
+        }
+        collect(node, fn);
+    }
+};
+
+// Inverted index over menu item names and categories. Each menu item is a
+// document; posting lists hold document ids in insertion order, which
+// keeps them sorted for intersection. The last query token is matched as
+// a prefix so partial input works as type-ahead.
+class MenuSearch {
+public:
+    struct Filter {
+        Money minPrice;
+        Money maxPrice = Money::max();
+        double minRating = 0;
+        Symbol category;    // empty for any
+    };
+    
+    struct Hit {
+        EntityId restaurantId;
+        uint32_t item;    // index into the restaurant's menu
+    };
+    
+    struct Page {
+        vector<Hit> hits;
+        bool hasMore = false;
+    };
+    
+private:
+    struct Document {
+        EntityId restaurantId;
+        uint32_t item;
+        Money price;
+        Symbol category;
+        bool live;
+    };
+    
+    vector<Document> documents;
+    vector<string> terms;
+    vector<vector<uint32_t>> postings;
+    HashTable<uint32_t> termIds;
+    TermTrie trie;
+    HashTable<vector<uint32_t>, EntityId> documentsByRestaurant;
+    
+    uint32_t termId(const string& term) {
+        if (uint32_t* id = termIds.search(term)) return *id;
+        uint32_t id = static_cast<uint32_t>(terms.size());
+        terms.push_back(term);
+        postings.emplace_back();
+        termIds.insert(term, id);
+        trie.insert(term, id);
+        return id;
+    }
+    
+    // Union of the posting lists of every term under `prefix`. The lists are
+    // already sorted, so one k-way heap merge over all of them costs
+    // O(N log k) even when a short prefix matches thousands of terms;
+    // documents under several terms are kept once.
+    vector<uint32_t> prefixPostings(const string& prefix) const {
+        vector<const vector<uint32_t>*> lists;
+        size_t total = 0;
+        trie.forEachWithPrefix(prefix, [&](uint32_t id) {
+            if (!postings[id].empty()) {
+                lists.push_back(&postings[id]);
+                total += postings[id].size();
+            }
+            return true;
+        });
+        if (lists.size() == 1) return *lists[0];
+        
+        // (next document, list) pairs; each list's cursor is its next unread index
+        using Head = pair<uint32_t, uint32_t>;
+        vector<Head> heap;
+        vector<size_t> cursor(lists.size(), 1);
+        heap.reserve(lists.size());
+        for (uint32_t i = 0; i < lists.size(); i++) heap.push_back({(*lists[i])[0], i});
+        make_heap(heap.begin(), heap.end(), greater<Head>());
+        
+        vector<uint32_t> merged;
+        merged.reserve(total);
+        while (!heap.empty()) {
+            pop_heap(heap.begin(), heap.end(), greater<Head>());
+            auto [doc, list] = heap.back();
+            if (merged.empty() || merged.back() != doc) merged.push_back(doc);
+            if (cursor[list] < lists[list]->size()) {
+                heap.back() = {(*lists[list])[cursor[list]++], list};
+                push_heap(heap.begin(), heap.end(), greater<Head>());
+            } else {
+                heap.pop_back();
+            }
+        }
+        return merged;
+    }
+    
+public:
+    void addRestaurant(const Restaurant& restaurant) {
+        vector<uint32_t>* owned = documentsByRestaurant.search(restaurant.id);
+        if (!owned) {
+            documentsByRestaurant.insert(restaurant.id, vector<uint32_t>());
+            owned = documentsByRestaurant.search(restaurant.id);
+        }
+        
+        vector<uint32_t> docTerms;
+        for (uint32_t i = 0; i < restaurant.menu.size(); i++) {
+            const MenuItem& item = restaurant.menu[i];
+            if (item.retired) continue;
+            uint32_t doc = static_cast<uint32_t>(documents.size());
+            documents.push_back({restaurant.id, i, item.price, item.category, true});
+            owned->push_back(doc);
+            
+            docTerms.clear();
+            auto collect = [&](const string& token) { docTerms.push_back(termId(token)); };
+            forEachToken(item.name.text(), collect);
+            forEachToken(item.category.text(), collect);
+            sort(docTerms.begin(), docTerms.end());
+            docTerms.erase(unique(docTerms.begin(), docTerms.end()), docTerms.end());
+            for (uint32_t t : docTerms) postings[t].push_back(doc);
+        }
+    }
+    
+    // Hides a restaurant's items; used before re-indexing a replaced record
+    void removeRestaurant(EntityId restaurantId) {
+        if (vector<uint32_t>* owned = documentsByRestaurant.search(restaurantId)) {
+            for (uint32_t doc : *owned) documents[doc].live = false;
+            owned->clear();
+        }
+    }
+    
+    // Up to `limit` matching terms for type-ahead, in lexical order
+    vector<string> suggest(string_view prefix, size_t limit) const {
+        string lowered;
+        forEachToken(prefix, [&](const string& token) { lowered = token; });
+        vector<string> result;
+        if (lowered.empty()) return result;
+        trie.forEachWithPrefix(lowered, [&](uint32_t id) {
+            if (result.size() >= limit) return false;
+            result.push_back(terms[id]);
+            return true;
+        });
+        return result;
+    }
+    
+    // Items matching every query token (the last one as a prefix) that pass
+    // the filter, skipping the first `offset` matches. Candidates come from
+    // the shortest posting list; the others are probed by binary search, and
+    // the walk stops as soon as the page is full.
+    template<typename RatingOf>
+    Page search(string_view query, const Filter& filter, size_t offset, size_t limit,
+                RatingOf ratingOf) const {
+        vector<string> tokens;
+        forEachToken(query, [&](const string& token) { tokens.push_back(token); });
+        Page page;
+        if (tokens.empty()) return page;
+        
+        vector<const vector<uint32_t>*> lists;
+        for (size_t i = 0; i + 1 < tokens.size(); i++) {
+            const uint32_t* id = termIds.search(tokens[i]);
+            if (!id) return page;
+            lists.push_back(&postings[*id]);
+        }
+        vector<uint32_t> prefixed = prefixPostings(tokens.back());
+        lists.push_back(&prefixed);
+        sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+        
+        size_t matched = 0;
+        for (uint32_t doc : *lists[0]) {
+            bool inAll = true;
+            for (size_t i = 1; i < lists.size() && inAll; i++) {
+                inAll = binary_search(lists[i]->begin(), lists[i]->end(), doc);
+            }
+            const Document& d = documents[doc];
+            if (!inAll || !d.live || d.price < filter.minPrice || d.price > filter.maxPrice) continue;
+            if (!filter.category.empty() && d.category != filter.category) continue;
+            if (filter.minRating > 0 && ratingOf(d.restaurantId) < filter.minRating) continue;
+            
+            if (matched++ < offset) continue;
+            if (page.hits.size() == limit) {
+                page.hasMore = true;
+                break;
+            }
+            page.hits.push_back({d.restaurantId, d.item});
+        }
+        return page;
+    }
+    
+    size_t documentCount() const { return documents.size(); }
+    size_t termCount() const { return terms.size(); }
+};
+
+// ======================= SPATIAL INDEX =======================
+
+// Restaurant locations in a packed R-tree. Sort-Tile-Recursive bulk
+// loading orders the points into leaves of NODE_SIZE and each level above
+// keeps only bounding boxes, so the tree is a few flat arrays with no
+// per-node allocation. New points go to an unsorted staging array that
+// every query scans; it is packed into the tree once it outgrows sqrt(n).
+// Boxes are in degrees and the distance to a box is measured to its
+// clamped nearest point, a valid lower bound away from the poles and the
+// antimeridian.
+class SpatialIndex {
+public:
+    struct Entry {
+        GeoPoint point;
+        EntityId id;    // 0 marks an erased entry still in the packed tree
+    };
+    
+    struct Neighbor {
+        EntityId id;
+        double meters;
+    };
+    
+private:
+    static constexpr size_t NODE_SIZE = 16;
+    static constexpr size_t MIN_STAGED = 64;
+    
+    struct Box {
+        double minLat = numeric_limits<double>::infinity();
+        double minLon = numeric_limits<double>::infinity();
+        double maxLat = -numeric_limits<double>::infinity();
+        double maxLon = -numeric_limits<double>::infinity();
+        
+        void extend(const GeoPoint& p) {
+            minLat = min(minLat, p.latitude);
+            maxLat = max(maxLat, p.latitude);
+            minLon = min(minLon, p.longitude);
+            maxLon = max(maxLon, p.longitude);
+        }
+        
+        void extend(const Box& b) {
+            minLat = min(minLat, b.minLat);
+            maxLat = max(maxLat, b.maxLat);
+            minLon = min(minLon, b.minLon);
+            maxLon = max(maxLon, b.maxLon);
+        }
+        
+        double metersFrom(const GeoPoint& p) const {
+            GeoPoint nearest(clamp(p.latitude, minLat, maxLat), clamp(p.longitude, minLon, maxLon));
+            return p.metersTo(nearest);
+        }
+    };
+    
+    vector<Entry> entries;          // leaf order
+    vector<vector<Box>> levels;     // levels[0] bounds runs of entries; the last level is the root
+    vector<Entry> staged;
+    size_t erased = 0;
+    
+    size_t stagedLimit() const {
+        return max(MIN_STAGED, static_cast<size_t>(sqrt(static_cast<double>(entries.size()))));
+    }
+    
+    // Children of node i on level l: boxes on level l - 1, or entries below level 0
+    static pair<size_t, size_t> childRange(size_t i, size_t childCount) {
+        return {i * NODE_SIZE, min(childCount, (i + 1) * NODE_SIZE)};
+    }
+    
+    void pack() {
+        vector<Entry> all;
+        all.reserve(entries.size() - erased + staged.size());
+        for (const Entry& e : entries) {
+            if (e.id) all.push_back(e);
+        }
+        all.insert(all.end(), staged.begin(), staged.end());
+        build(move(all));
+    }
+    
+public:
+    // Bulk load, replacing the current contents; points without a location are skipped
+    void build(vector<Entry>&& all) {
+        all.erase(remove_if(all.begin(), all.end(), [](const Entry& e) { return !e.point.isKnown(); }),
+                  all.end());
+        entries = move(all);
+        staged.clear();
+        erased = 0;
+        levels.clear();
+        if (entries.empty()) return;
+        
+        // Vertical slices by longitude, then leaf runs by latitude inside each slice
+        size_t leaves = (entries.size() + NODE_SIZE - 1) / NODE_SIZE;
+        size_t sliceSize = static_cast<size_t>(ceil(sqrt(static_cast<double>(leaves)))) * NODE_SIZE;
+        sort(entries.begin(), entries.end(),
+             [](const Entry& a, const Entry& b) { return a.point.longitude < b.point.longitude; });
+        for (size_t begin = 0; begin < entries.size(); begin += sliceSize) {
+            sort(entries.begin() + begin, entries.begin() + min(entries.size(), begin + sliceSize),
+                 [](const Entry& a, const Entry& b) { return a.point.latitude < b.point.latitude; });
+        }
+        
+        levels.emplace_back(leaves);
+        for (size_t i = 0; i < entries.size(); i++) levels[0][i / NODE_SIZE].extend(entries[i].point);
+        while (levels.back().size() > 1) {
+            const vector<Box>& below = levels.back();
+            vector<Box> above((below.size() + NODE_SIZE - 1) / NODE_SIZE);
+            for (size_t i = 0; i < below.size(); i++) above[i / NODE_SIZE].extend(below[i]);
+            levels.push_back(move(above));
+        }
+    }
+    
+    void insert(EntityId id, const GeoPoint& point) {
+        if (!point.isKnown()) return;
+        staged.push_back({point, id});
+        if (staged.size() > stagedLimit()) pack();
+    }
+    
+    // O(n); only needed when a restaurant record is replaced
+    void erase(EntityId id) {
+        for (Entry& e : entries) {
+            if (e.id == id) {
+                e.id = 0;
+                erased++;
+            }
+        }
+        staged.erase(remove_if(staged.begin(), staged.end(), [id](const Entry& e) { return e.id == id; }),
+                     staged.end());
+        if (erased > stagedLimit()) pack();
+    }
+    
+    // Every entry within `meters` of center, in no particular order
+    template<typename F>
+    void forEachWithin(const GeoPoint& center, double meters, F fn) const {
+        for (const Entry& e : staged) {
+            double d = center.metersTo(e.point);
+            if (d <= meters) fn(e, d);
+        }
+        if (levels.empty()) return;
+        
+        // Depth-first over (level, node); entries are reached through level 0
+        vector<pair<size_t, size_t>> pending = {{levels.size() - 1, 0}};
+        while (!pending.empty()) {
+            auto [level, node] = pending.back();
+            pending.pop_back();
+            if (levels[level][node].metersFrom(center) > meters) continue;
+            if (level > 0) {
+                auto [begin, end] = childRange(node, levels[level - 1].size());
+                for (size_t child = begin; child < end; child++) pending.push_back({level - 1, child});
+                continue;
+            }
+            auto [begin, end] = childRange(node, entries.size());
+            for (size_t i = begin; i < end; i++) {
+                if (!entries[i].id) continue;
+                double d = center.metersTo(entries[i].point);
+                if (d <= meters) fn(entries[i], d);
+            }
+        }
+    }
+    
+    // The k nearest entries that `accept` lets through, nearest first.
+    // Best-first search: nodes and entries share one min-heap keyed by
+    // their distance lower bound, so the walk stops after the k-th hit.
+    template<typename Accept>
+    vector<Neighbor> nearest(const GeoPoint& center, size_t k, Accept accept) const {
+        struct Candidate {
+            double meters;
+            int32_t level;      // -1 for a tree entry, -2 for a staged one
+            uint32_t index;
+            bool operator>(const Candidate& other) const { return meters > other.meters; }
+        };
+        vector<Candidate> heap;
+        auto push = [&heap](Candidate c) {
+            heap.push_back(c);
+            push_heap(heap.begin(), heap.end(), greater<Candidate>());
+        };
+        for (uint32_t i = 0; i < staged.size(); i++) push({center.metersTo(staged[i].point), -2, i});
+        if (!levels.empty()) {
+            push({levels.back()[0].metersFrom(center), static_cast<int32_t>(levels.size() - 1), 0});
+        }
+        
+        vector<Neighbor> result;
+        while (!heap.empty() && result.size() < k) {
+            pop_heap(heap.begin(), heap.end(), greater<Candidate>());
+            Candidate c = heap.back();
+            heap.pop_back();
+            if (c.level < 0) {
+                const Entry& e = c.level == -1 ? entries[c.index] : staged[c.index];
+                if (accept(e.id)) result.push_back({e.id, c.meters});
+            } else if (c.level > 0) {
+                auto [begin, end] = childRange(c.index, levels[c.level - 1].size());
+                for (size_t child = begin; child < end; child++) {
+                    push({levels[c.level - 1][child].metersFrom(center), c.level - 1, static_cast<uint32_t>(child)});
+                }
+            } else {
+                auto [begin, end] = childRange(c.index, entries.size());
+                for (size_t i = begin; i < end; i++) {
+                    if (entries[i].id) push({center.metersTo(entries[i].point), -1, static_cast<uint32_t>(i)});
+                }
+            }
+        }
+        return result;
+    }
+    
+    vector<Neighbor> nearest(const GeoPoint& center, size_t k) const {
+        return nearest(center, k, [](EntityId) { return true; });
+    }
+    
+    size_t size() const { return entries.size() - erased + staged.size(); }
+};
+
+// ======================= PARALLEL LOADING =======================
+
+// Startup loader: each file is split at newline boundaries, chunks are
+// parsed on the thread pool into per-chunk partial tables, and the
+// partials are merged into the store in file order so handles come out
+// the same as with a sequential load.
+class ParallelLoader {
+private:
+    static constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+    
+    struct RestaurantChunk {
+        vector<Restaurant> restaurants;
+        vector<uint64_t> idHashes;
+        HashTable<size_t, EntityId> localIndex;
+        // Menu items whose restaurant was defined in an earlier chunk
+        vector<pair<EntityId, MenuItem>> pendingMenu;
+        vector<ParseError> errors;
+        size_t lines = 0;
+        
+        void onRestaurant(const RestaurantRecordView& rec) {
+            uint64_t hash = EntityStore::Index::hashKey(rec.id);
+            localIndex.insert(rec.id, restaurants.size(), hash);
+            restaurants.emplace_back(rec.id, string(rec.name), rec.rating, string(rec.address));
+            restaurants.back().location = rec.location;
+            idHashes.push_back(hash);
+        }
+        
+        void onMenuItem(const MenuRecordView& rec) {
+            MenuItem item(rec.name, rec.price, rec.category);
+            if (!restaurants.empty() && restaurants.back().id == rec.restaurantId) {
+                restaurants.back().menu.push_back(move(item));
+            } else if (size_t* pos = localIndex.search(rec.restaurantId)) {
+                restaurants[*pos].menu.push_back(move(item));
+            } else {
+                pendingMenu.emplace_back(rec.restaurantId, move(item));
+            }
+        }
+    };
+    
+    struct CustomerChunk {
+        vector<Customer> customers;
+        vector<uint64_t> idHashes;
+        vector<ParseError> errors;
+        size_t lines = 0;
+        
+        void onCustomer(const CustomerRecordView& rec) {
+            idHashes.push_back(EntityStore::Index::hashKey(rec.id));
+            customers.push_back(Customer::fromRecord(rec));
+        }
+    };
+    
+    static size_t chunkCountFor(size_t bytes, ThreadPool* pool) {
+        if (!pool) return 1;
+        size_t byMinimum = max<size_t>(1, bytes / MIN_CHUNK_BYTES);
+        return min(byMinimum, pool->size() * 4);
+    }
+    
+    template<typename Chunk, typename Parse>
+    static vector<Chunk> parseChunks(string_view data, ThreadPool* pool, Parse parse) {
+        vector<string_view> pieces = splitAtLines(data, chunkCountFor(data.size(), pool));
+        vector<Chunk> chunks(pieces.size());
+        auto work = [&](size_t i) {
+            chunks[i].lines = parse(pieces[i], chunks[i]);
+        };
+        if (pool && pieces.size() > 1) {
+            pool->parallelFor(pieces.size(), work);
+        } else {
+            for (size_t i = 0; i < pieces.size(); i++) work(i);
+        }
+        return chunks;
+    }
+    
+    template<typename Chunk>
+    static void mergeErrors(const string& path, const vector<Chunk>& chunks) {
+        vector<ParseError> errors;
+        size_t lineOffset = 0;
+        for (const auto& chunk : chunks) {
+            for (const auto& e : chunk.errors) {
+                errors.push_back({e.line + lineOffset, e.message});
+            }
+            lineOffset += chunk.lines;
+        }
+        reportParseErrors(path, errors);
+    }
+    
+public:
+    static size_t loadRestaurants(const string& path, EntityStore& store, ThreadPool* pool) {
+        MappedFile file(path);
+        if (!file.isOpen()) return 0;
+        
+        vector<RestaurantChunk> chunks = parseChunks<RestaurantChunk>(file.view(), pool,
+            [](string_view piece, RestaurantChunk& chunk) {
+                return parseRestaurantData(piece, chunk, chunk.errors);
+            });
+        mergeErrors(path, chunks);
+        
+        size_t total = 0;
+        for (const auto& chunk : chunks) total += chunk.restaurants.size();
+        store.reserve(store.restaurantCount() + total, store.customerCount());
+        
+        size_t orphanMenuItems = 0;
+        for (auto& chunk : chunks) {
+            // Pending items only see restaurants from earlier chunks, which
+            // is exactly what a sequential pass would have seen
+            for (auto& pending : chunk.pendingMenu) {
+                Restaurant* owner = store.findRestaurant(pending.first);
+                if (owner) {
+                    owner->menu.push_back(move(pending.second));
+                } else {
+                    orphanMenuItems++;
+                }
+            }
+            for (size_t i = 0; i < chunk.restaurants.size(); i++) {
+                store.addRestaurant(move(chunk.restaurants[i]), chunk.idHashes[i]);
+            }
+        }
+        if (orphanMenuItems > 0) {
+            cerr << path << ": " << orphanMenuItems << " menu items reference unknown restaurants\n";
+        }
+        return total;
+    }
+    
+    static size_t loadCustomers(const string& path, EntityStore& store, ThreadPool* pool) {
+        MappedFile file(path);
+        if (!file.isOpen()) return 0;
+        
+        vector<CustomerChunk> chunks = parseChunks<CustomerChunk>(file.view(), pool,
+            [](string_view piece, CustomerChunk& chunk) {
+                return parseCustomerData(piece, chunk, chunk.errors);
+            });
+        mergeErrors(path, chunks);
+        
+        size_t total = 0;
+        for (const auto& chunk : chunks) total += chunk.customers.size();
+        store.reserve(store.restaurantCount(), store.customerCount() + total);
+        
+        for (auto& chunk : chunks) {
+            for (size_t i = 0; i < chunk.customers.size(); i++) {
+                store.addCustomer(move(chunk.customers[i]), chunk.idHashes[i]);
+            }
+        }
+        return total;
+    }
+};
+
+// ======================= SNAPSHOT =======================
+
+// Binary snapshot layout (native endianness, sections 8-byte aligned):
+//   header | restaurants | menu items | customers | orders | order lines |
+//   string pool
+// Strings are (offset, length) references into the pool. The file is
+// mapped and its fixed-width records read in place, one pass into the
+// entity store; snapshots up to version 5 also carried per-id hash index
+// sections, which are now written empty and ignored when present.
+struct SnapshotString {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct SnapshotRestaurant {
+    uint64_t id;
+    SnapshotString name;
+    SnapshotString address;
+    double rating;
+    double latitude;
+    double longitude;
+    uint64_t firstMenuItem;
+    uint64_t menuItemCount;
+};
+
+// Amounts are cents since version 5; versions 3 and 4 kept a double in
+// the same eight bytes, so the record layouts did not change
+union SnapshotAmount {
+    int64_t cents;
+    double legacy;
+};
+
+struct SnapshotMenuItem {
+    SnapshotString name;
+    SnapshotString category;
+    SnapshotAmount price;
+    uint64_t flags;    // SNAPSHOT_ITEM_RETIRED; earlier writers left it 0
+};
+
+const uint64_t SNAPSHOT_ITEM_RETIRED = 1;
+
+struct SnapshotCustomer {
+    uint64_t id;
+    SnapshotString name;
+    SnapshotString phone;
+    SnapshotString address;
+    double latitude;
+    double longitude;
+};
+
+struct SnapshotOrder {
+    uint64_t orderId;
+    uint64_t customerId;
+    uint64_t restaurantId;
+    int64_t updatedAt;
+    SnapshotAmount totalAmount;
+    uint64_t firstLine;
+    uint32_t lineCount;
+    uint32_t status;
+};
+
+struct SnapshotOrderLine {
+    uint32_t item;
+    uint32_t reserved;
+    SnapshotAmount price;
+};
+
+// Version 3 orders: text status and timestamp, and a SnapshotMenuItem copy
+// of every ordered item in the order lines section. Still readable.
+struct SnapshotOrderV3 {
+    uint64_t orderId;
+    uint64_t customerId;
+    uint64_t restaurantId;
+    SnapshotString status;
+    SnapshotString timestamp;
+    double totalAmount;
+    uint64_t firstItem;
+    uint64_t itemCount;
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t count;    // records, index buckets, or pool bytes
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t checksum;    // hashString over bytes [headerSize, fileSize)
+    SnapshotSection restaurants;
+    SnapshotSection menuItems;
+    SnapshotSection customers;
+    SnapshotSection orders;
+    SnapshotSection orderLines;
+    SnapshotSection unusedIndexes[3];
+    SnapshotSection strings;
+};
+
+static_assert(is_trivially_copyable<SnapshotHeader>::value, "snapshot header must be POD");
+
+const char SNAPSHOT_MAGIC[8] = {'F', 'D', 'S', 'S', 'N', 'A', 'P', 0};
+const uint32_t SNAPSHOT_VERSION = 5;
+
+class SnapshotWriter {
+private:
+    vector<SnapshotRestaurant> restaurants;
+    vector<SnapshotMenuItem> menuItems;
+    vector<SnapshotCustomer> customers;
+    vector<SnapshotOrder> orders;
+    vector<SnapshotOrderLine> orderLines;
+    string pool;
+    HashTable<SnapshotString, uint64_t> symbolRefs;    // by symbol id
+    
+    SnapshotString addString(string_view s) {
+        SnapshotString ref = {pool.size(), static_cast<uint32_t>(s.size()), 0};
+        pool += s;
+        return ref;
+    }
+    
+    // Interned strings go into the pool once, however many items share them
+    SnapshotString addSymbol(Symbol s) {
+        if (const SnapshotString* ref = symbolRefs.search(s.value())) return *ref;
+        SnapshotString ref = addString(s.text());
+        symbolRefs.insert(s.value(), ref);
+        return ref;
+    }
+    
+    SnapshotMenuItem makeItem(const MenuItem& item) {
+        return {addSymbol(item.name), addSymbol(item.category), {item.price.inCents()},
+                item.retired ? SNAPSHOT_ITEM_RETIRED : 0};
+    }
+    
+    template<typename T>
+    static void append(string& out, SnapshotSection& section, const vector<T>& data, size_t count) {
+        out.resize((out.size() + 7) & ~size_t(7), '\0');
+        section.offset = out.size();
+        section.count = count;
+        out.append(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+    }
+    
+public:
+    void addRestaurant(const Restaurant& r) {
+        SnapshotRestaurant rec = {r.id, addString(r.name), addString(r.address), r.rating,
+                                  r.location.latitude, r.location.longitude, menuItems.size(), r.menu.size()};
+        for (const auto& item : r.menu) {
+            menuItems.push_back(makeItem(item));
+        }
+        restaurants.push_back(rec);
+    }
+    
+    void addCustomer(const Customer& c) {
+        customers.push_back({c.id, addString(c.name), addString(c.phone), addString(c.address),
+                             c.location.latitude, c.location.longitude});
+    }
+    
+    void addOrder(const Order& o) {
+        orders.push_back({o.orderId, o.customerId, o.restaurantId, static_cast<int64_t>(o.updatedAt),
+                          {o.totalAmount.inCents()}, orderLines.size(), static_cast<uint32_t>(o.lines.size()),
+                          static_cast<uint32_t>(o.status)});
+        for (const auto& line : o.lines) {
+            orderLines.push_back({line.item, 0, {line.price.inCents()}});
+        }
+    }
+    
+    // Writes to a synced temporary file and renames it over `path`; see
+    // replaceFileDurably
+    bool write(const string& path) const {
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.headerSize = sizeof(SnapshotHeader);
+        
+        string out(sizeof(SnapshotHeader), '\0');
+        append(out, header.restaurants, restaurants, restaurants.size());
+        append(out, header.menuItems, menuItems, menuItems.size());
+        append(out, header.customers, customers, customers.size());
+        append(out, header.orders, orders, orders.size());
+        append(out, header.orderLines, orderLines, orderLines.size());
+        vector<char> bytes(pool.begin(), pool.end());
+        append(out, header.strings, bytes, bytes.size());
+        
+        header.fileSize = out.size();
+        header.checksum = hashString(string_view(out).substr(sizeof(SnapshotHeader)));
+        memcpy(&out[0], &header, sizeof(header));
+        return replaceFileDurably(path, out);
+    }
+};
+
+// Validated, read-only view over a mapped snapshot file
+class SnapshotView {
+private:
+    MappedFile file;
+    const SnapshotHeader* header;
+    string error;
+    
+    template<typename T>
+    const T* section(const SnapshotSection& s) const {
+        return reinterpret_cast<const T*>(file.view().data() + s.offset);
+    }
+    
+    template<typename T>
+    bool sectionFits(const SnapshotSection& s, size_t size) const {
+        return s.offset % alignof(T) == 0 && s.offset <= size && s.count <= (size - s.offset) / sizeof(T);
+    }
+    
+    bool isV3() const { return header->version == 3; }
+    
+    // How many of the records [first, first + count) lie within a section
+    // of `size` records; written so that no sum can overflow
+    static uint64_t clipped(uint64_t first, uint64_t count, uint64_t size) {
+        return first > size ? 0 : min(count, size - first);
+    }
+    
+    bool orderSectionsFit(size_t size) const {
+        if (isV3()) {
+            return sectionFits<SnapshotOrderV3>(header->orders, size) &&
+                   sectionFits<SnapshotMenuItem>(header->orderLines, size);
+        }
+        return sectionFits<SnapshotOrder>(header->orders, size) &&
+               sectionFits<SnapshotOrderLine>(header->orderLines, size);
+    }
+    
+    bool validate() {
+        string_view data = file.view();
+        if (data.size() < sizeof(SnapshotHeader)) {
+            error = "file too small";
+            return false;
+        }
+        header = reinterpret_cast<const SnapshotHeader*>(data.data());
+        if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+            error = "bad magic";
+        } else if (header->version < 3 || header->version > SNAPSHOT_VERSION ||
+                   header->headerSize != sizeof(SnapshotHeader)) {
+            error = "unsupported version " + to_string(header->version);
+        } else if (header->fileSize != data.size()) {
+            error = "truncated file";
+        } else if (!sectionFits<SnapshotRestaurant>(header->restaurants, data.size()) ||
+                   !sectionFits<SnapshotMenuItem>(header->menuItems, data.size()) ||
+                   !sectionFits<SnapshotCustomer>(header->customers, data.size()) ||
+                   !orderSectionsFit(data.size()) ||
+                   !sectionFits<char>(header->strings, data.size())) {
+            error = "section out of bounds";
+        } else if (hashString(data.substr(sizeof(SnapshotHeader))) != header->checksum) {
+            error = "checksum mismatch";
+        } else {
+            return true;
+        }
+        header = nullptr;
+        return false;
+    }
+    
+public:
+    explicit SnapshotView(const string& path) : file(path), header(nullptr) {
+        if (!file.isOpen()) {
+            error = "cannot open " + path;
+            return;
+        }
+        validate();
+    }
+    
+    bool isValid() const { return header != nullptr; }
+    const string& errorMessage() const { return error; }
+    
+    string_view str(const SnapshotString& s) const {
+        uint64_t count = header->strings.count;
+        if (s.offset > count || s.length > count - s.offset) return string_view();
+        return string_view(section<char>(header->strings) + s.offset, s.length);
+    }
+    
+    size_t restaurantCount() const { return header->restaurants.count; }
+    size_t customerCount() const { return header->customers.count; }
+    size_t orderCount() const { return header->orders.count; }
+    
+    const SnapshotRestaurant& restaurant(size_t i) const { return section<SnapshotRestaurant>(header->restaurants)[i]; }
+    const SnapshotCustomer& customer(size_t i) const { return section<SnapshotCustomer>(header->customers)[i]; }
+    
+    // Item ranges are bounds-checked so a bad count cannot read past the section
+    const SnapshotMenuItem* menuItem(uint64_t i) const {
+        return i < header->menuItems.count ? &section<SnapshotMenuItem>(header->menuItems)[i] : nullptr;
+    }
+    
+    // The part of a restaurant's menu range that lies within the section
+    uint64_t menuItemCount(const SnapshotRestaurant& rec) const {
+        return clipped(rec.firstMenuItem, rec.menuItemCount, header->menuItems.count);
+    }
+    
+    Money amount(const SnapshotAmount& value) const {
+        return header->version >= 5 ? Money::cents(value.cents) : Money::fromDouble(value.legacy);
+    }
+    
+    MenuItem toMenuItem(const SnapshotMenuItem& item) const {
+        MenuItem menuItem(str(item.name), amount(item.price), str(item.category));
+        menuItem.retired = (item.flags & SNAPSHOT_ITEM_RETIRED) != 0;
+        return menuItem;
+    }
+    
+    // Order i of either version; findItem(restaurantId, name) maps the
+    // item copies of version 3 back to menu positions as in Order::decodeV1
+    template<typename FindItem>
+    Order toOrder(size_t i, FindItem findItem) const {
+        if (isV3()) {
+            const SnapshotOrderV3& rec = section<SnapshotOrderV3>(header->orders)[i];
+            const SnapshotMenuItem* items = section<SnapshotMenuItem>(header->orderLines);
+            Order order(rec.orderId, rec.customerId, rec.restaurantId);
+            uint64_t count = clipped(rec.firstItem, rec.itemCount, header->orderLines.count);
+            for (const SnapshotMenuItem* item = items + rec.firstItem; item != items + rec.firstItem + count; item++) {
+                order.lines.push_back(OrderLine{findItem(rec.restaurantId, str(item->name)), amount(item->price)});
+            }
+            order.totalAmount = Money::fromDouble(rec.totalAmount);
+            parseStatus(str(rec.status), order.status);
+            order.updatedAt = parseTimestamp(str(rec.timestamp));
+            return order;
+        }
+        
+        const SnapshotOrder& rec = section<SnapshotOrder>(header->orders)[i];
+        const SnapshotOrderLine* lines = section<SnapshotOrderLine>(header->orderLines);
+        Order order(rec.orderId, rec.customerId, rec.restaurantId);
+        uint64_t count = clipped(rec.firstLine, rec.lineCount, header->orderLines.count);
+        for (const SnapshotOrderLine* line = lines + rec.firstLine; line != lines + rec.firstLine + count; line++) {
+            order.lines.push_back(OrderLine{line->item, amount(line->price)});
+        }
+        order.totalAmount = amount(rec.totalAmount);
+        order.status = rec.status < ORDER_STATUS_COUNT ? static_cast<OrderStatus>(rec.status) : OrderStatus::Pending;
+        order.updatedAt = static_cast<time_t>(rec.updatedAt);
+        return order;
+    }
+};
+
+// True when `path` exists and is newer than every existing file in `others`
+inline bool isNewerThan(const string& path, const vector<string>& others) {
+    error_code ec;
+    auto stamp = filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    for (const auto& other : others) {
+        auto otherStamp = filesystem::last_write_time(other, ec);
+        if (!ec && otherStamp > stamp) return false;
+    }
+    return true;
+}
+
+// ======================= ORDER LIFECYCLE =======================
+
+// One pooled queue per status plus an id index, so looking up an order
+// and moving it to another state are both O(1)
+class OrderLifecycle {
+public:
+    enum class Result {
+        Ok,
+        NotFound,
+        InvalidTransition
+    };
+    
+private:
+    struct OrderRef {
+        OrderStatus status;
+        Handle handle;
+    };
+    
+    array<PooledDeque<Order>, ORDER_STATUS_COUNT> queues;
+    HashTable<OrderRef, EntityId> index;
+    WriteAheadLog& wal;
+    AsyncStatusLog* tracking;
+    
+    PooledDeque<Order>& queueFor(OrderStatus status) {
+        return queues[static_cast<size_t>(status)];
+    }
+    
+    // Moves the order between queues; returns it at its new position
+    Order* relocate(OrderRef& ref, OrderStatus to) {
+        ref.handle = queueFor(ref.status).transferTo(ref.handle, queueFor(to));
+        ref.status = to;
+        return queueFor(to).get(ref.handle);
+    }
+    
+    Result transition(EntityId orderId, OrderStatus to, Order*& moved) {
+        OrderRef* ref = index.search(orderId);
+        if (!ref) return Result::NotFound;
+        if (!canTransition(ref->status, to)) return Result::InvalidTransition;
+        moved = relocate(*ref, to);
+        moved->setStatus(to);
+        return Result::Ok;
+    }
+    
+public:
+    OrderLifecycle(WriteAheadLog& log, AsyncStatusLog* trackingLog)
+        : wal(log), tracking(trackingLog) {}
+    
+    // Adds an order in whatever state it carries; false if the id exists
+    bool add(Order&& order) {
+        if (index.search(order.orderId)) return false;
+        EntityId id = order.orderId;
+        OrderStatus status = order.status;
+        Handle h = queueFor(status).pushBack(move(order));
+        index.insert(id, OrderRef{status, h});
+        return true;
+    }
+    
+    Order* find(EntityId orderId) {
+        OrderRef* ref = index.search(orderId);
+        return ref ? queueFor(ref->status).get(ref->handle) : nullptr;
+    }
+    
+    Result advance(EntityId orderId, OrderStatus to) {
+        uint64_t lsn = 0;
+        Result result = advanceLogged(orderId, to, lsn);
+        wal.awaitCommit(lsn);
+        return result;
+    }
+    
+    // Applies and appends the change but leaves waiting for it to become
+    // durable (wal.awaitCommit(lsn)) to the caller, who may first release
+    // its locks; lsn stays 0 when nothing was logged
+    Result advanceLogged(EntityId orderId, OrderStatus to, uint64_t& lsn) {
+        Order* order = nullptr;
+        Result result = transition(orderId, to, order);
+        if (result != Result::Ok) return result;
+        
+        // Reused per thread so steady-state updates do not allocate
+        thread_local string payload;
+        payload.clear();
+        WalEncoder out(payload);
+        order->encodeStatusChange(out);
+        if (wal.isOpen()) {
+            lsn = wal.append(WalRecordType::OrderStatusChanged, payload);
+        }
+        if (tracking) {
+            tracking->log(order->orderId, statusName(to), time(nullptr));
+        }
+        return Result::Ok;
+    }
+    
+    // Moves many orders at once; their log records share one group commit.
+    // Orders that are missing or cannot make the transition are skipped.
+    size_t advanceOrders(const vector<EntityId>& orderIds, OrderStatus to) {
+        thread_local string payload;
+        uint64_t lastLsn = 0;
+        size_t moved = 0;
+        time_t now = time(nullptr);
+        
+        for (EntityId id : orderIds) {
+            Order* order = nullptr;
+            if (transition(id, to, order) != Result::Ok) continue;
+            payload.clear();
+            WalEncoder out(payload);
+            order->encodeStatusChange(out);
+            if (wal.isOpen()) {
+                lastLsn = wal.append(WalRecordType::OrderStatusChanged, payload);
+            }
+            if (tracking) {
+                tracking->log(order->orderId, statusName(to), now);
+            }
+            moved++;
+        }
+        wal.awaitCommit(lastLsn);
+        return moved;
+    }
+    
+    // Replay path: applies a logged change without logging it again
+    void restoreStatus(EntityId orderId, OrderStatus to, time_t at) {
+        OrderRef* ref = index.search(orderId);
+        if (!ref) return;
+        Order* order = ref->status == to ? queueFor(to).get(ref->handle) : relocate(*ref, to);
+        order->status = to;
+        order->updatedAt = at;
+    }
+    
+    template<typename F>
+    void forEach(OrderStatus status, F fn) const {
+        queues[static_cast<size_t>(status)].forEach(fn);
+    }
+    
+    template<typename F>
+    void forEachActive(F fn) const {
+        for (size_t s = 0; s < ORDER_STATUS_COUNT; s++) {
+            if (!isTerminal(static_cast<OrderStatus>(s))) queues[s].forEach(fn);
+        }
+    }
+    
+    template<typename F>
+    void forEachCompleted(F fn) const {
+        forEach(OrderStatus::Delivered, fn);
+        forEach(OrderStatus::Cancelled, fn);
+    }
+    
+    size_t count(OrderStatus status) const { return queues[static_cast<size_t>(status)].size(); }
+    size_t size() const { return index.size(); }
+};
+
+// ======================= ORDER ANALYTICS =======================
+
+// Column-per-field copy of every order for reporting. A query reads only
+// the columns it needs, front to back, instead of walking pooled Order
+// objects. Restaurants and customers are dictionary-encoded to dense
+// 32-bit keys, so group-by results live in flat arrays indexed by key.
+// Rows are appended as orders arrive and never move; a status change
+// rewrites one byte of the status column.
+class OrderAnalytics {
+public:
+    // Orders placed in [from, to) whose status bit is set in statusMask,
+    // grouped by restaurant and/or by bucketSeconds-wide time buckets
+    struct Query {
+        time_t from = 0;
+        time_t to = numeric_limits<time_t>::max();
+        uint32_t statusMask = ~0u;
+        bool byRestaurant = true;
+        int64_t bucketSeconds = 0;    // 0 keeps the whole range in one bucket
+    };
+    
+    // Percentiles are nearest-rank order values
+    struct Group {
+        EntityId restaurantId;        // 0 when not grouped by restaurant
+        time_t bucketStart;
+        uint64_t orders;
+        Money revenue;
+        Money p50;
+        Money p90;
+        Money p99;
+    };
+    
+    static uint32_t statusBit(OrderStatus status) { return 1u << static_cast<uint32_t>(status); }
+    
+private:
+    // Rows are processed in blocks small enough for their keys to stay in L1
+    static constexpr size_t BLOCK = 2048;
+    static constexpr size_t MAX_GROUPS = size_t(1) << 22;
+    
+    vector<uint32_t> restaurant;
+    vector<uint32_t> customer;
+    vector<int64_t> amount;
+    vector<uint8_t> status;
+    vector<int64_t> placedAt;
+    
+    HashTable<uint32_t, EntityId> rows;
+    vector<EntityId> restaurantIds;
+    HashTable<uint32_t, EntityId> restaurantKeys;
+    vector<EntityId> customerIds;
+    HashTable<uint32_t, EntityId> customerKeys;
+    
+    static uint32_t encode(EntityId id, vector<EntityId>& ids, HashTable<uint32_t, EntityId>& keys) {
+        if (const uint32_t* key = keys.search(id)) return *key;
+        uint32_t key = static_cast<uint32_t>(ids.size());
+        ids.push_back(id);
+        keys.insert(id, key);
+        return key;
+    }
+    
+    // Group key for every row in [begin, begin + n); rows the query does
+    // not select get `spill`. Written without branches (masks instead of
+    // conditionals, the bucket from a reciprocal rather than a division)
+    // so compilers vectorize it when 64-bit lane compares are available,
+    // e.g. -O3 -mavx2. Offsets fit in 32 bits because spans are capped;
+    // the +0.5 keeps exact multiples of the bucket width from rounding down.
+    static void groupKeys(const uint32_t* restaurantKey, const uint8_t* statusCode, const int64_t* placed,
+                          size_t n, const Query& query, int64_t span, uint32_t buckets, uint32_t spill,
+                          uint32_t* keys) {
+        const int64_t from = query.from;
+        const uint32_t statusMask = query.statusMask;
+        const uint64_t limit = static_cast<uint64_t>(span);
+        const double perBucket = static_cast<double>(buckets) / static_cast<double>(span);
+        const uint32_t restaurantStride = query.byRestaurant ? buckets : 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t offset = static_cast<uint64_t>(placed[i] - from);
+            uint64_t inRange = offset < limit;
+            int32_t clamped = static_cast<int32_t>(offset & (0 - inRange));
+            uint32_t bucket = static_cast<int32_t>((static_cast<double>(clamped) + 0.5) * perBucket);
+            uint32_t selected = 0 - (((statusMask >> statusCode[i]) & 1) & static_cast<uint32_t>(inRange));
+            uint32_t key = restaurantKey[i] * restaurantStride + bucket;
+            keys[i] = (key & selected) | (spill & ~selected);
+        }
+    }
+    
+    // Index of the nearest-rank p-th percentile among n sorted values
+    static size_t rankIndex(size_t n, double p) {
+        size_t rank = static_cast<size_t>(ceil(p * static_cast<double>(n)));
+        return rank == 0 ? 0 : min(rank, n) - 1;
+    }
+    
+public:
+    void reserve(size_t orders) {
+        restaurant.reserve(orders);
+        customer.reserve(orders);
+        amount.reserve(orders);
+        status.reserve(orders);
+        placedAt.reserve(orders);
+        rows.reserve(orders);
+    }
+    
+    // Records an order as placed; repeating an id only refreshes its status
+    void add(const Order& order) {
+        if (const uint32_t* row = rows.search(order.orderId)) {
+            status[*row] = static_cast<uint8_t>(order.status);
+            return;
+        }
+        rows.insert(order.orderId, static_cast<uint32_t>(status.size()));
+        restaurant.push_back(encode(order.restaurantId, restaurantIds, restaurantKeys));
+        customer.push_back(encode(order.customerId, customerIds, customerKeys));
+        amount.push_back(order.totalAmount.inCents());
+        status.push_back(static_cast<uint8_t>(order.status));
+        placedAt.push_back(SnowflakeIdGenerator::timeOf(order.orderId, order.updatedAt));
+    }
+    
+    void setStatus(EntityId orderId, OrderStatus to) {
+        if (const uint32_t* row = rows.search(orderId)) status[*row] = static_cast<uint8_t>(to);
+    }
+    
+    // Orders per status, over every row
+    array<uint64_t, ORDER_STATUS_COUNT> countByStatus() const {
+        array<uint64_t, ORDER_STATUS_COUNT> counts{};
+        for (uint8_t code : status) counts[code]++;
+        return counts;
+    }
+    
+    // Non-empty groups ordered by restaurant key, then bucket. An unbounded
+    // range is narrowed to the placement times actually present; false if
+    // the query would need more than MAX_GROUPS groups or spans 68+ years.
+    bool aggregate(Query query, vector<Group>& out) const {
+        out.clear();
+        size_t n = status.size();
+        if (n == 0) return true;
+        
+        if (query.from == 0 || query.to == numeric_limits<time_t>::max()) {
+            auto [low, high] = minmax_element(placedAt.begin(), placedAt.end());
+            if (query.from == 0) query.from = *low;
+            if (query.to == numeric_limits<time_t>::max()) query.to = *high + 1;
+        }
+        if (query.to <= query.from) return true;
+        int64_t span = query.to - query.from;
+        int64_t bucketSeconds = query.bucketSeconds > 0 ? query.bucketSeconds : span;
+        uint64_t buckets = static_cast<uint64_t>((span + bucketSeconds - 1) / bucketSeconds);
+        uint64_t groups = buckets * (query.byRestaurant ? max<size_t>(restaurantIds.size(), 1) : 1);
+        if (buckets > MAX_GROUPS || groups > MAX_GROUPS) return false;
+        // Whole buckets, so the reciprocal in groupKeys maps offsets exactly
+        span = static_cast<int64_t>(buckets) * bucketSeconds;
+        if (span > numeric_limits<int32_t>::max()) return false;
+        query.to = query.from + span;
+        
+        // Pass 1: keys for every row, then counts and revenue per key. The
+        // extra slot at index `groups` absorbs unselected rows so the
+        // scatter loop has no branch either.
+        uint32_t spill = static_cast<uint32_t>(groups);
+        vector<uint32_t> keys(n);
+        vector<uint64_t> counts(groups + 1, 0);
+        vector<int64_t> revenue(groups + 1, 0);
+        for (size_t begin = 0; begin < n; begin += BLOCK) {
+            size_t len = min(BLOCK, n - begin);
+            uint32_t* blockKeys = keys.data() + begin;
+            groupKeys(restaurant.data() + begin, status.data() + begin, placedAt.data() + begin, len, query,
+                      span, static_cast<uint32_t>(buckets), spill, blockKeys);
+            const int64_t* blockAmounts = amount.data() + begin;
+            for (size_t i = 0; i < len; i++) {
+                counts[blockKeys[i]]++;
+                revenue[blockKeys[i]] += blockAmounts[i];
+            }
+        }
+        
+        // Pass 2: counting-sort the selected amounts by key so each group's
+        // values are contiguous for the percentile selection
+        vector<uint64_t> start(groups + 1, 0);
+        for (uint64_t g = 0; g < groups; g++) start[g + 1] = start[g] + counts[g];
+        vector<int64_t> values(start[groups]);
+        vector<uint64_t> fill(start);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t key = keys[i];
+            if (key != spill) values[fill[key]++] = amount[i];
+        }
+        
+        for (uint64_t g = 0; g < groups; g++) {
+            if (counts[g] == 0) continue;
+            int64_t* first = values.data() + start[g];
+            size_t size = counts[g];
+            Group group;
+            group.restaurantId = query.byRestaurant ? restaurantIds[g / buckets] : 0;
+            group.bucketStart = query.from + static_cast<time_t>(g % buckets) * bucketSeconds;
+            group.orders = counts[g];
+            group.revenue = Money::cents(revenue[g]);
+            // Ascending ranks: each selection leaves everything above its
+            // rank to the right, so the next one only searches that part
+            // (and reorders it, so each value is read straight away)
+            size_t i50 = rankIndex(size, 0.50);
+            size_t i90 = rankIndex(size, 0.90);
+            size_t i99 = rankIndex(size, 0.99);
+            nth_element(first, first + i50, first + size);
+            group.p50 = Money::cents(first[i50]);
+            nth_element(first + i50, first + i90, first + size);
+            group.p90 = Money::cents(first[i90]);
+            nth_element(first + i90, first + i99, first + size);
+            group.p99 = Money::cents(first[i99]);
+            out.push_back(group);
+        }
+        return true;
+    }
+    
+    size_t size() const { return status.size(); }
+    size_t restaurantCount() const { return restaurantIds.size(); }
+    size_t customerCount() const { return customerIds.size(); }
+};
+
+// ======================= BILLING =======================
+
+// Orders laid out column by column for bulk billing. Line prices go into
+// planes, plane k holding the k-th line of every order (zero past an
+// order's last line), so totaling is element-wise addition over
+// contiguous arrays, which compilers vectorize. BillingPipeline fills in
+// the charge columns.
+class BillingBatch {
+private:
+    vector<vector<Money>> planes;
+    
+    static void addInto(Money* sums, const Money* values, size_t n) {
+        for (size_t i = 0; i < n; i++) sums[i] += values[i];
+    }
+    
+public:
+    vector<EntityId> orderIds;
+    vector<Money> subtotal;
+    vector<Money> discount;
+    vector<Money> fees;
+    vector<Money> tax;
+    vector<Money> total;
+    
+    static Money sum(const vector<Money>& column) {
+        Money result;
+        for (Money amount : column) result += amount;
+        return result;
+    }
+    
+    void reserve(size_t orders) {
+        orderIds.reserve(orders);
+        for (auto& plane : planes) plane.reserve(orders);
+    }
+    
+    void clear() {
+        planes.clear();
+        orderIds.clear();
+    }
+    
+    void add(const Order& order) {
+        size_t row = orderIds.size();
+        orderIds.push_back(order.orderId);
+        while (planes.size() < order.lines.size()) {
+            planes.emplace_back(row, Money());
+            planes.back().reserve(orderIds.capacity());
+        }
+        for (size_t k = 0; k < planes.size(); k++) {
+            planes[k].push_back(k < order.lines.size() ? order.lines[k].price : Money());
+        }
+    }
+    
+    // Sums the planes into `subtotal`
+    void totalLines() {
+        size_t n = size();
+        subtotal.assign(n, Money());
+        for (const auto& plane : planes) addInto(subtotal.data(), plane.data(), n);
+    }
+    
+    // Total of every column adds up: charges are whole cents, never rounded
+    // again after the step that produced them
+    bool reconciles() const {
+        return sum(total) == sum(subtotal) - sum(discount) + sum(fees) + sum(tax);
+    }
+    
+    size_t size() const { return orderIds.size(); }
+    size_t planeCount() const { return planes.size(); }
+};
+
+// Discount, fee and tax steps applied in the order they were added. Rates
+// are parts per million, so 8.875% is exact, and each step rounds its own
+// charge to the cent. Discounts and fee waivers look at the subtotal; tax
+// applies to everything charged so far (subtotal less discounts plus fees).
+class BillingPipeline {
+private:
+    enum class Kind { Discount, Fee, Tax };
+    
+    struct Step {
+        Kind kind;
+        int64_t ppm;
+        Money amount;       // fee, or the cap on a discount
+        Money threshold;    // minimum subtotal for a discount, or where a fee is waived
+    };
+    
+    // Rows per pass: five 8-byte columns of this many stay within L1/L2
+    static constexpr size_t BLOCK = 2048;
+    
+    vector<Step> steps;
+    
+public:
+    BillingPipeline& discount(int64_t ppm, Money cap = Money::max(), Money minimum = Money()) {
+        steps.push_back({Kind::Discount, ppm, cap, minimum});
+        return *this;
+    }
+    
+    BillingPipeline& fee(Money amount, Money waivedFrom = Money::max()) {
+        steps.push_back({Kind::Fee, 0, amount, waivedFrom});
+        return *this;
+    }
+    
+    BillingPipeline& tax(int64_t ppm) {
+        steps.push_back({Kind::Tax, ppm, Money(), Money()});
+        return *this;
+    }
+    
+    // Totals the batch's lines, then fills its discount, fees, tax and total
+    // columns. Rows go through every step a block at a time so the columns
+    // stay in cache between steps; within a step each loop runs over
+    // contiguous columns. The selects and sums vectorize, the percentage
+    // steps stay scalar (there is no SIMD 64-bit divide).
+    void run(BillingBatch& batch) const {
+        batch.totalLines();
+        size_t n = batch.size();
+        batch.discount.assign(n, Money());
+        batch.fees.assign(n, Money());
+        batch.tax.assign(n, Money());
+        batch.total.resize(n);
+        
+        for (size_t begin = 0; begin < n; begin += BLOCK) {
+            size_t len = min(BLOCK, n - begin);
+            const Money* subtotal = batch.subtotal.data() + begin;
+            Money* discount = batch.discount.data() + begin;
+            Money* fees = batch.fees.data() + begin;
+            Money* tax = batch.tax.data() + begin;
+            Money* total = batch.total.data() + begin;
+            
+            for (const Step& step : steps) {
+                switch (step.kind) {
+                    case Kind::Discount:
+                        for (size_t i = 0; i < len; i++) {
+                            Money off = min(subtotal[i].portion(step.ppm), step.amount);
+                            discount[i] += subtotal[i] >= step.threshold ? off : Money();
+                        }
+                        break;
+                    case Kind::Fee:
+                        for (size_t i = 0; i < len; i++) {
+                            fees[i] += subtotal[i] >= step.threshold ? Money() : step.amount;
+                        }
+                        break;
+                    case Kind::Tax:
+                        for (size_t i = 0; i < len; i++) {
+                            tax[i] += (subtotal[i] - discount[i] + fees[i]).portion(step.ppm);
+                        }
+                        break;
+                }
+            }
+            for (size_t i = 0; i < len; i++) total[i] = subtotal[i] - discount[i] + fees[i] + tax[i];
+        }
+    }
+};
+
+// ======================= ROUTING =======================
+
+// Road network file (roads.txt), comma-separated like the other data files:
+//   NODE,<id>,<latitude>,<longitude>     coordinates may be left empty
+//   EDGE,<from id>,<to id>,<meters>      directed; two-way roads need both
+// Node ids are arbitrary unsigned integers and are renumbered densely.
+// Route lengths are summed with addMeters, so a route of UNREACHABLE
+// meters (about 4.3 million km) or more counts as no route at all.
+
+const uint32_t NO_NODE = UINT32_MAX;
+const uint32_t UNREACHABLE = UINT32_MAX;
+
+// a + b without wrapping around: saturates at UNREACHABLE
+inline uint32_t addMeters(uint32_t a, uint32_t b) {
+    return static_cast<uint32_t>(min<uint64_t>(static_cast<uint64_t>(a) + b, UNREACHABLE));
+}
+
+inline bool parseUnsigned(string_view text, uint64_t& out) {
+    auto result = from_chars(text.data(), text.data() + text.size(), out);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+struct RoadEdge {
+    uint32_t from;
+    uint32_t to;
+    uint32_t meters;
+};
+
+// Directed weighted graph in compressed sparse row form: the out-edges of
+// node v are targets/weights[offsets[v] .. offsets[v + 1])
+class RoadGraph {
+private:
+    vector<uint32_t> offsets;
+    vector<uint32_t> targets;
+    vector<uint32_t> weights;
+    vector<double> latitudes;
+    vector<double> longitudes;
+    vector<uint64_t> externalIds;
+    HashTable<uint32_t, uint64_t> nodeIndex;
+    
+public:
+    RoadGraph() : offsets(1, 0) {}
+    
+    // Builds the CSR arrays with a counting sort over edge sources.
+    // Coordinates are optional: pass empty vectors to disable A*.
+    void build(vector<uint64_t>&& ids, vector<double>&& lats, vector<double>&& lons,
+               const vector<RoadEdge>& edges) {
+        size_t n = ids.size();
+        externalIds = move(ids);
+        latitudes = move(lats);
+        longitudes = move(lons);
+        nodeIndex = HashTable<uint32_t, uint64_t>(n);
+        for (uint32_t v = 0; v < n; v++) nodeIndex.insert(externalIds[v], v);
+        
+        offsets.assign(n + 1, 0);
+        for (const auto& e : edges) offsets[e.from + 1]++;
+        for (size_t v = 0; v < n; v++) offsets[v + 1] += offsets[v];
+        targets.resize(edges.size());
+        weights.resize(edges.size());
+        vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (const auto& e : edges) {
+            uint32_t slot = cursor[e.from]++;
+            targets[slot] = e.to;
+            weights[slot] = e.meters;
+        }
+    }
+    
+    bool load(const string& path) {
+        MappedFile file(path);
+        if (!file.isOpen()) return false;
+        
+        struct PendingEdge {
+            uint64_t from, to;
+            uint32_t meters;
+            size_t line;
+        };
+        vector<uint64_t> ids;
+        vector<double> lats, lons;
+        vector<PendingEdge> pending;
+        vector<ParseError> errors;
+        HashTable<uint32_t, uint64_t> index;
+        bool allCoordinates = true;
+        
+        string_view data = file.view();
+        for (size_t lineNumber = 1; !data.empty(); lineNumber++) {
+            string_view line = nextLine(data);
+            if (line.empty()) continue;
+            string_view kind = nextField(line);
+            if (kind == "NODE") {
+                uint64_t id;
+                string_view idText = nextField(line);
+                string_view lat = nextField(line);
+                string_view lon = nextField(line);
+                double latValue = 0, lonValue = 0;
+                if (!parseUnsigned(idText, id)) {
+                    errors.push_back({lineNumber, "invalid node id '" + string(idText) + "'"});
+                    continue;
+                }
+                if (index.search(id)) {
+                    errors.push_back({lineNumber, "duplicate node id " + string(idText)});
+                    continue;
+                }
+                if (lat.empty() || lon.empty()) {
+                    allCoordinates = false;
+                } else if (!parseNumber(lat, latValue) || !parseNumber(lon, lonValue)) {
+                    errors.push_back({lineNumber, "invalid coordinates"});
+                    continue;
+                }
+                index.insert(id, static_cast<uint32_t>(ids.size()));
+                ids.push_back(id);
+                lats.push_back(latValue);
+                lons.push_back(lonValue);
+            } else if (kind == "EDGE") {
+                PendingEdge e;
+                string_view from = nextField(line);
+                string_view to = nextField(line);
+                string_view meters = nextField(line);
+                uint64_t length;
+                if (!parseUnsigned(from, e.from) || !parseUnsigned(to, e.to) ||
+                    !parseUnsigned(meters, length) || length >= UNREACHABLE) {
+                    errors.push_back({lineNumber, "invalid edge"});
+                    continue;
+                }
+                e.meters = static_cast<uint32_t>(length);
+                e.line = lineNumber;
+                pending.push_back(e);
+            } else {
+                errors.push_back({lineNumber, "unknown record type '" + string(kind) + "'"});
+            }
+        }
+        
+        vector<RoadEdge> edges;
+        edges.reserve(pending.size());
+        for (const auto& e : pending) {
+            const uint32_t* from = index.search(e.from);
+            const uint32_t* to = index.search(e.to);
+            if (!from || !to) {
+                errors.push_back({e.line, "edge references an unknown node"});
+                continue;
+            }
+            edges.push_back({*from, *to, e.meters});
+        }
+        stable_sort(errors.begin(), errors.end(),
+                    [](const ParseError& a, const ParseError& b) { return a.line < b.line; });
+        reportParseErrors(path, errors);
+        
+        if (!allCoordinates) {
+            lats.clear();
+            lons.clear();
+        }
+        build(move(ids), move(lats), move(lons), edges);
+        return true;
+    }
+    
+    bool save(const string& path) const {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+        file.precision(9);
+        for (uint32_t v = 0; v < nodeCount(); v++) {
+            file << "NODE," << externalIds[v] << ",";
+            if (hasCoordinates()) file << latitudes[v] << "," << longitudes[v];
+            else file << ",";
+            file << "\n";
+        }
+        for (uint32_t v = 0; v < nodeCount(); v++) {
+            for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                file << "EDGE," << externalIds[v] << "," << externalIds[targets[e]] << "," << weights[e] << "\n";
+            }
+        }
+        return static_cast<bool>(file);
+    }
+    
+    // Synthetic city for demos and benchmarks: a side x side street grid
+    // around Islamabad (~100 m blocks) of two-way roads. Every tenth row and
+    // column is a straight avenue; side streets wind 30-80% longer than the
+    // straight line and ~10% of them are closed.
+    static RoadGraph grid(uint32_t side, uint32_t seed) {
+        const double lat0 = 33.6844, lon0 = 73.0479, step = 0.0009;
+        uint32_t n = side * side;
+        vector<uint64_t> ids(n);
+        vector<double> lats(n), lons(n);
+        for (uint32_t v = 0; v < n; v++) {
+            ids[v] = v + 1;
+            lats[v] = lat0 + (v / side) * step;
+            lons[v] = lon0 + (v % side) * step;
+        }
+        
+        uint64_t state = seed;
+        auto random = [&state]() { return static_cast<uint32_t>((state = mixHash(state + 1)) >> 33); };
+        vector<RoadEdge> edges;
+        edges.reserve(n * 4);
+        auto connect = [&](uint32_t a, uint32_t b, bool avenue) {
+            if (!avenue && random() % 10 == 0) return;
+            double meters = haversineMeters(lats[a], lons[a], lats[b], lons[b]);
+            double stretch = avenue ? 1.0 + (random() % 5) / 100.0 : 1.3 + (random() % 50) / 100.0;
+            uint32_t length = static_cast<uint32_t>(ceil(meters * stretch));
+            edges.push_back({a, b, length});
+            edges.push_back({b, a, length});
+        };
+        for (uint32_t v = 0; v < n; v++) {
+            uint32_t row = v / side, column = v % side;
+            if (column + 1 < side) connect(v, v + 1, row % 10 == 0);
+            if (row + 1 < side) connect(v, v + side, column % 10 == 0);
+        }
+        
+        RoadGraph graph;
+        graph.build(move(ids), move(lats), move(lons), edges);
+        return graph;
+    }
+    
+    uint32_t nodeCount() const { return static_cast<uint32_t>(offsets.size() - 1); }
+    size_t edgeCount() const { return targets.size(); }
+    bool hasCoordinates() const { return !latitudes.empty(); }
+    
+    uint32_t edgeBegin(uint32_t v) const { return offsets[v]; }
+    uint32_t edgeEnd(uint32_t v) const { return offsets[v + 1]; }
+    uint32_t target(uint32_t e) const { return targets[e]; }
+    uint32_t weight(uint32_t e) const { return weights[e]; }
+    
+    uint64_t externalId(uint32_t v) const { return externalIds[v]; }
+    uint32_t node(uint64_t externalId) const {
+        const uint32_t* v = nodeIndex.search(externalId);
+        return v ? *v : NO_NODE;
+    }
+    
+    // Admissible A* bound as long as no edge is shorter than the straight
+    // line between its ends
+    uint32_t straightLine(uint32_t a, uint32_t b) const {
+        if (!hasCoordinates()) return 0;
+        return static_cast<uint32_t>(haversineMeters(latitudes[a], longitudes[a], latitudes[b], longitudes[b]));
+    }
+};
+
+// Per-query Dijkstra state. Distances are valid only where the stamp
+// matches the current generation, so starting a new query is O(1) and a
+// workspace reused across queries does not allocate once warmed up.
+class SearchSpace {
+private:
+    vector<uint32_t> dist;
+    vector<uint32_t> parents;
+    vector<uint32_t> middles;
+    vector<uint32_t> stamps;
+    uint32_t generation = 0;
+    // (key, node) min-heap with lazy deletion of stale entries
+    vector<pair<uint32_t, uint32_t>> heap;
+    
+public:
+    void reset(size_t nodes) {
+        if (stamps.size() != nodes) {
+            dist.resize(nodes);
+            parents.resize(nodes);
+            middles.resize(nodes);
+            stamps.assign(nodes, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+        heap.clear();
+    }
+    
+    uint32_t distance(uint32_t v) const { return stamps[v] == generation ? dist[v] : UNREACHABLE; }
+    uint32_t parent(uint32_t v) const { return parents[v]; }
+    uint32_t middle(uint32_t v) const { return middles[v]; }
+    
+    // Records a tentative distance and queues v under `key`
+    void update(uint32_t v, uint32_t d, uint32_t parent, uint32_t key, uint32_t middle = NO_NODE) {
+        stamps[v] = generation;
+        dist[v] = d;
+        parents[v] = parent;
+        middles[v] = middle;
+        heap.emplace_back(key, v);
+        push_heap(heap.begin(), heap.end(), greater<pair<uint32_t, uint32_t>>());
+    }
+    
+    bool empty() const { return heap.empty(); }
+    uint32_t minKey() const { return heap.front().first; }
+    void clearQueue() { heap.clear(); }
+    
+    pair<uint32_t, uint32_t> pop() {
+        pop_heap(heap.begin(), heap.end(), greater<pair<uint32_t, uint32_t>>());
+        pair<uint32_t, uint32_t> top = heap.back();
+        heap.pop_back();
+        return top;
+    }
+};
+
+// Reusable scratch space for one thread's route queries
+struct RouteWorkspace {
+    struct BucketEntry {
+        uint32_t node;
+        uint32_t target;
+        uint32_t distance;
+        bool operator<(const BucketEntry& other) const { return node < other.node; }
+    };
+    
+    SearchSpace forward;
+    SearchSpace backward;
+    vector<BucketEntry> buckets;
+    vector<uint32_t> chain;
+};
+
+class ShortestPaths {
+private:
+    static void tracePath(const SearchSpace& space, uint32_t source, uint32_t target, vector<uint32_t>* path) {
+        if (!path) return;
+        path->clear();
+        for (uint32_t v = target; v != source; v = space.parent(v)) path->push_back(v);
+        path->push_back(source);
+        reverse(path->begin(), path->end());
+    }
+    
+    // Dijkstra with an optional goal-directed potential (A* when non-zero)
+    template<typename Potential>
+    static uint32_t search(const RoadGraph& graph, uint32_t source, uint32_t target, SearchSpace& space,
+                           vector<uint32_t>* path, Potential potential) {
+        space.reset(graph.nodeCount());
+        space.update(source, 0, NO_NODE, potential(source));
+        while (!space.empty()) {
+            auto [key, v] = space.pop();
+            uint32_t d = space.distance(v);
+            if (key != addMeters(d, potential(v))) continue;    // stale heap entry
+            if (v == target) {
+                tracePath(space, source, target, path);
+                return d;
+            }
+            for (uint32_t e = graph.edgeBegin(v); e < graph.edgeEnd(v); e++) {
+                uint32_t w = graph.target(e);
+                uint32_t nd = addMeters(d, graph.weight(e));
+                if (nd < space.distance(w)) space.update(w, nd, v, addMeters(nd, potential(w)));
+            }
+        }
+        if (path) path->clear();
+        return UNREACHABLE;
+    }
+    
+public:
+    static uint32_t dijkstra(const RoadGraph& graph, uint32_t source, uint32_t target, RouteWorkspace& ws,
+                             vector<uint32_t>* path = nullptr) {
+        return search(graph, source, target, ws.forward, path, [](uint32_t) { return 0u; });
+    }
+    
+    static uint32_t aStar(const RoadGraph& graph, uint32_t source, uint32_t target, RouteWorkspace& ws,
+                          vector<uint32_t>* path = nullptr) {
+        return search(graph, source, target, ws.forward, path,
+                      [&graph, target](uint32_t v) { return graph.straightLine(v, target); });
+    }
+};
+
+// Contraction hierarchy: nodes are contracted one by one in order of
+// importance (edge difference, contracted neighbours and level, updated
+// lazily), adding shortcuts wherever a bounded witness search finds no
+// path around the contracted node. Queries then only relax edges towards
+// more important nodes from both ends.
+class ContractionHierarchy {
+private:
+    struct Arc {
+        uint32_t node;
+        uint32_t weight;
+        uint32_t middle;    // NO_NODE for an original road segment
+    };
+    
+    // Witness searches give up after this many settled nodes; a missed
+    // witness only costs an unnecessary shortcut, never a wrong distance
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 200;
+    
+    vector<uint32_t> ranks;
+    // upward[v]: v -> w with rank[w] > rank[v] (forward search)
+    // downward[v]: u -> v with rank[u] > rank[v], stored at v (backward search)
+    vector<uint32_t> upOffsets, downOffsets;
+    vector<Arc> upArcs, downArcs;
+    size_t shortcuts = 0;
+    
+    struct Shortcut {
+        uint32_t from, to, weight;
+    };
+    
+    static void relaxArc(vector<Arc>& arcs, uint32_t node, uint32_t weight, uint32_t middle) {
+        for (auto& arc : arcs) {
+            if (arc.node == node) {
+                if (weight < arc.weight) arc = {node, weight, middle};
+                return;
+            }
+        }
+        arcs.push_back({node, weight, middle});
+    }
+    
+    static void toCsr(vector<vector<Arc>>& lists, vector<uint32_t>& offsets, vector<Arc>& arcs) {
+        offsets.assign(lists.size() + 1, 0);
+        for (size_t v = 0; v < lists.size(); v++) offsets[v + 1] = offsets[v] + lists[v].size();
+        arcs.clear();
+        arcs.reserve(offsets.back());
+        for (auto& list : lists) {
+            arcs.insert(arcs.end(), list.begin(), list.end());
+            vector<Arc>().swap(list);
+        }
+    }
+    
+    // Shortcuts needed to contract v given the remaining graph
+    static void findShortcuts(uint32_t v, const vector<vector<Arc>>& out, const vector<vector<Arc>>& in,
+                              SearchSpace& witness, vector<Shortcut>& result) {
+        result.clear();
+        for (const Arc& incoming : in[v]) {
+            uint32_t u = incoming.node;
+            // Zero-length roads make a zero limit legitimate, so whether v
+            // leads anywhere but back to u is tracked separately
+            uint32_t limit = 0;
+            bool hasTarget = false;
+            for (const Arc& outgoing : out[v]) {
+                if (outgoing.node == u) continue;
+                limit = max(limit, addMeters(incoming.weight, outgoing.weight));
+                hasTarget = true;
+            }
+            if (!hasTarget) continue;
+            
+            witness.reset(out.size());
+            witness.update(u, 0, NO_NODE, 0);
+            size_t settled = 0;
+            size_t targetsLeft = out[v].size();
+            while (!witness.empty() && settled < WITNESS_SETTLE_LIMIT && targetsLeft > 0) {
+                auto [d, x] = witness.pop();
+                if (d != witness.distance(x)) continue;
+                if (d > limit) break;
+                settled++;
+                for (const Arc& outgoing : out[v]) targetsLeft -= outgoing.node == x;
+                for (const Arc& arc : out[x]) {
+                    if (arc.node == v) continue;
+                    uint32_t nd = addMeters(d, arc.weight);
+                    if (nd <= limit && nd < witness.distance(arc.node)) witness.update(arc.node, nd, x, nd);
+                }
+            }
+            for (const Arc& outgoing : out[v]) {
+                uint32_t via = addMeters(incoming.weight, outgoing.weight);
+                if (outgoing.node != u && witness.distance(outgoing.node) > via) {
+                    result.push_back({u, outgoing.node, via});
+                }
+            }
+        }
+    }
+    
+    // Middle node of the hierarchy arc a -> b, looked up in the lower endpoint's lists
+    uint32_t middleOf(uint32_t a, uint32_t b) const {
+        if (ranks[a] < ranks[b]) {
+            for (uint32_t i = upOffsets[a]; i < upOffsets[a + 1]; i++) {
+                if (upArcs[i].node == b) return upArcs[i].middle;
+            }
+        } else {
+            for (uint32_t i = downOffsets[b]; i < downOffsets[b + 1]; i++) {
+                if (downArcs[i].node == a) return downArcs[i].middle;
+            }
+        }
+        return NO_NODE;
+    }
+    
+    // Appends the original nodes of arc a -> b (excluding a) to the path
+    void unpack(uint32_t a, uint32_t b, uint32_t middle, vector<uint32_t>& path) const {
+        if (middle == NO_NODE) {
+            path.push_back(b);
+            return;
+        }
+        unpack(a, middle, middleOf(a, middle), path);
+        unpack(middle, b, middleOf(middle, b), path);
+    }
+    
+    // Settles the whole upward search space of one side, reporting each node
+    template<typename F>
+    static void exhaust(SearchSpace& space, const vector<uint32_t>& offsets, const vector<Arc>& arcs,
+                        uint32_t source, size_t nodes, F onSettle) {
+        space.reset(nodes);
+        space.update(source, 0, NO_NODE, 0);
+        while (!space.empty()) {
+            auto [d, v] = space.pop();
+            if (d != space.distance(v)) continue;
+            onSettle(v, d);
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+                uint32_t nd = addMeters(d, arcs[i].weight);
+                if (nd < space.distance(arcs[i].node)) space.update(arcs[i].node, nd, v, nd, arcs[i].middle);
+            }
+        }
+    }
+    
+public:
+    void build(const RoadGraph& graph) {
+        uint32_t n = graph.nodeCount();
+        vector<vector<Arc>> out(n), in(n);
+        for (uint32_t v = 0; v < n; v++) {
+            for (uint32_t e = graph.edgeBegin(v); e < graph.edgeEnd(v); e++) {
+                uint32_t w = graph.target(e);
+                if (w == v) continue;
+                relaxArc(out[v], w, graph.weight(e), NO_NODE);
+                relaxArc(in[w], v, graph.weight(e), NO_NODE);
+            }
+        }
+        
+        SearchSpace witness;
+        vector<Shortcut> found;
+        vector<uint32_t> contractedNeighbours(n, 0);
+        vector<uint32_t> levels(n, 0);
+        auto priority = [&](uint32_t v) {
+            findShortcuts(v, out, in, witness, found);
+            int64_t edgeDifference = static_cast<int64_t>(found.size()) - static_cast<int64_t>(out[v].size() + in[v].size());
+            return 2 * edgeDifference + contractedNeighbours[v] + levels[v];
+        };
+        
+        using Entry = pair<int64_t, uint32_t>;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        for (uint32_t v = 0; v < n; v++) queue.push({priority(v), v});
+        
+        ranks.assign(n, NO_NODE);
+        vector<vector<Arc>> upward(n), downward(n);
+        shortcuts = 0;
+        for (uint32_t rank = 0; !queue.empty(); ) {
+            uint32_t v = queue.top().second;
+            queue.pop();
+            if (ranks[v] != NO_NODE) continue;
+            // Lazy update: re-queue if v is no longer the least important
+            int64_t current = priority(v);
+            if (!queue.empty() && current > queue.top().first) {
+                queue.push({current, v});
+                continue;
+            }
+            
+            ranks[v] = rank++;
+            upward[v] = out[v];
+            downward[v] = in[v];
+            for (const Shortcut& s : found) {
+                relaxArc(out[s.from], s.to, s.weight, v);
+                relaxArc(in[s.to], s.from, s.weight, v);
+            }
+            shortcuts += found.size();
+            for (const Arc& arc : out[v]) {
+                auto& back = in[arc.node];
+                back.erase(remove_if(back.begin(), back.end(), [v](const Arc& a) { return a.node == v; }), back.end());
+                contractedNeighbours[arc.node]++;
+                levels[arc.node] = max(levels[arc.node], levels[v] + 1);
+            }
+            for (const Arc& arc : in[v]) {
+                auto& forward = out[arc.node];
+                forward.erase(remove_if(forward.begin(), forward.end(), [v](const Arc& a) { return a.node == v; }),
+                              forward.end());
+                contractedNeighbours[arc.node]++;
+                levels[arc.node] = max(levels[arc.node], levels[v] + 1);
+            }
+            vector<Arc>().swap(out[v]);
+            vector<Arc>().swap(in[v]);
+        }
+        
+        toCsr(upward, upOffsets, upArcs);
+        toCsr(downward, downOffsets, downArcs);
+    }
+    
+    size_t nodeCount() const { return ranks.size(); }
+    size_t shortcutCount() const { return shortcuts; }
+    
+    // Bidirectional upward search; each side stops once its queue minimum
+    // can no longer improve the best meeting point
+    uint32_t query(uint32_t source, uint32_t target, RouteWorkspace& ws, vector<uint32_t>* path = nullptr) const {
+        SearchSpace& fwd = ws.forward;
+        SearchSpace& bwd = ws.backward;
+        fwd.reset(nodeCount());
+        bwd.reset(nodeCount());
+        fwd.update(source, 0, NO_NODE, 0);
+        bwd.update(target, 0, NO_NODE, 0);
+        uint32_t best = UNREACHABLE;
+        uint32_t meet = NO_NODE;
+        
+        // Stall-on-demand: a node reachable more cheaply through a higher
+        // neighbour (via the opposite direction's arcs) is not expanded
+        auto step = [&](SearchSpace& self, const SearchSpace& other, const vector<uint32_t>& offsets,
+                        const vector<Arc>& arcs, const vector<uint32_t>& stallOffsets, const vector<Arc>& stallArcs) {
+            auto [d, v] = self.pop();
+            if (d != self.distance(v)) return;
+            uint32_t across = other.distance(v);
+            uint32_t through = addMeters(d, across);
+            if (through < best) {
+                best = through;
+                meet = v;
+            }
+            for (uint32_t i = stallOffsets[v]; i < stallOffsets[v + 1]; i++) {
+                uint32_t above = self.distance(stallArcs[i].node);
+                if (addMeters(above, stallArcs[i].weight) < d) return;
+            }
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+                uint32_t nd = addMeters(d, arcs[i].weight);
+                if (nd < self.distance(arcs[i].node)) self.update(arcs[i].node, nd, v, nd, arcs[i].middle);
+            }
+        };
+        
+        while (!fwd.empty() || !bwd.empty()) {
+            if (!fwd.empty() && fwd.minKey() >= best) fwd.clearQueue();
+            if (!bwd.empty() && bwd.minKey() >= best) bwd.clearQueue();
+            if (!fwd.empty()) step(fwd, bwd, upOffsets, upArcs, downOffsets, downArcs);
+            if (!bwd.empty()) step(bwd, fwd, downOffsets, downArcs, upOffsets, upArcs);
+        }
+        
+        if (path) {
+            path->clear();
+            if (meet == NO_NODE) return UNREACHABLE;
+            // The forward half is recorded from the meeting node back to the source
+            ws.chain.clear();
+            for (uint32_t v = meet; v != source; v = fwd.parent(v)) ws.chain.push_back(v);
+            path->push_back(source);
+            uint32_t prev = source;
+            for (size_t i = ws.chain.size(); i-- > 0; ) {
+                unpack(prev, ws.chain[i], fwd.middle(ws.chain[i]), *path);
+                prev = ws.chain[i];
+            }
+            for (uint32_t v = meet; v != target; v = bwd.parent(v)) {
+                unpack(v, bwd.parent(v), bwd.middle(v), *path);
+            }
+        }
+        return best;
+    }
+    
+    // Bucket-based many-to-many: one backward upward search per target
+    // leaves (target, distance) entries at every node it reaches, then
+    // each source's forward search scans the buckets it meets. Results are
+    // row-major, |sources| x |targets|, UNREACHABLE where no path exists.
+    void distanceMatrix(const vector<uint32_t>& sources, const vector<uint32_t>& targets, RouteWorkspace& ws,
+                        vector<uint32_t>& result) const {
+        result.assign(sources.size() * targets.size(), UNREACHABLE);
+        ws.buckets.clear();
+        for (uint32_t j = 0; j < targets.size(); j++) {
+            exhaust(ws.backward, downOffsets, downArcs, targets[j], nodeCount(), [&](uint32_t v, uint32_t d) {
+                ws.buckets.push_back({v, j, d});
+            });
+        }
+        sort(ws.buckets.begin(), ws.buckets.end());
+        
+        for (size_t i = 0; i < sources.size(); i++) {
+            uint32_t* row = &result[i * targets.size()];
+            exhaust(ws.forward, upOffsets, upArcs, sources[i], nodeCount(), [&](uint32_t v, uint32_t d) {
+                RouteWorkspace::BucketEntry key = {v, 0, 0};
+                auto range = equal_range(ws.buckets.begin(), ws.buckets.end(), key);
+                for (auto it = range.first; it != range.second; ++it) {
+                    row[it->target] = min(row[it->target], addMeters(d, it->distance));
+                }
+            });
+        }
+    }
+};
+
+// ======================= DISPATCH =======================
+
+struct Courier {
+    uint32_t id;
+    GeoPoint position;
+    uint32_t capacity;         // orders carried at once
+    double metersPerSecond;
+};
+
+struct DeliveryJob {
+    EntityId orderId;
+    GeoPoint pickup;
+    GeoPoint dropoff;
+};
+
+// Assigns delivery jobs to couriers as multi-stop pickup-and-delivery
+// routes. The objective is the summed arrival time at every customer,
+// which batches nearby orders without piling work on one courier. A route
+// holds at most QUEUED_PER_CAPACITY times the courier's capacity in jobs;
+// when every route is full, new jobs wait in arrival order and are
+// assigned as routes free up.
+// New jobs go in by cheapest feasible insertion; local search (2-opt and
+// or-opt within a route, relocating a job to another route) then runs
+// only on routes that changed, until nothing improves or the wall-clock
+// budget runs out. Routes are never rebuilt from scratch.
+class Dispatcher {
+public:
+    struct Stop {
+        uint32_t job;
+        bool pickup;
+    };
+    
+    struct Metrics {
+        size_t jobsAdded = 0;
+        size_t improvingMoves = 0;
+        double insertSeconds = 0;
+        double improveSeconds = 0;
+    };
+    
+private:
+    static constexpr double INFEASIBLE = numeric_limits<double>::infinity();
+    static constexpr uint32_t QUEUED_PER_CAPACITY = 2;
+    static constexpr uint32_t WAITING = NO_NODE - 1;
+    
+    vector<Courier> couriers;
+    vector<vector<Stop>> routes;
+    vector<double> routeCosts;
+    vector<DeliveryJob> jobs;
+    vector<uint32_t> jobCourier;    // NO_NODE for a free slot, WAITING while unassigned
+    vector<bool> pickedUp;
+    vector<uint32_t> freeJobs;
+    deque<uint32_t> waiting;        // may hold stale entries; jobCourier is authoritative
+    size_t waitingJobs = 0;
+    HashTable<uint32_t, EntityId> jobIndex;
+    Metrics metrics;
+    
+    // Scratch state reused across evaluations
+    mutable vector<uint32_t> seenStamp;
+    mutable uint32_t stamp = 0;
+    vector<Stop> candidate;
+    vector<Stop> bestRoute;
+    vector<pair<double, uint32_t>> byBound;
+    deque<uint32_t> dirty;
+    vector<bool> isDirty;
+    chrono::steady_clock::time_point deadline;
+    
+    GeoPoint where(const Stop& s) const { return s.pickup ? jobs[s.job].pickup : jobs[s.job].dropoff; }
+    
+    // Summed customer arrival times in seconds, or INFEASIBLE when a
+    // dropoff precedes its pickup or the courier would be over capacity
+    double evaluate(uint32_t c, const vector<Stop>& route) const {
+        if (++stamp == 0) {
+            fill(seenStamp.begin(), seenStamp.end(), 0);
+            stamp = 1;
+        }
+        uint32_t load = 0;
+        for (const Stop& s : route) load += !s.pickup && pickedUp[s.job];
+        
+        const Courier& courier = couriers[c];
+        GeoPoint at = courier.position;
+        double elapsed = 0, total = 0;
+        for (const Stop& s : route) {
+            GeoPoint next = where(s);
+            elapsed += at.metersTo(next) / courier.metersPerSecond;
+            at = next;
+            if (s.pickup) {
+                if (++load > courier.capacity) return INFEASIBLE;
+                seenStamp[s.job] = stamp;
+            } else {
+                if (!pickedUp[s.job] && seenStamp[s.job] != stamp) return INFEASIBLE;
+                load--;
+                total += elapsed;
+            }
+        }
+        return total;
+    }
+    
+    void markDirty(uint32_t c) {
+        if (!isDirty[c]) {
+            isDirty[c] = true;
+            dirty.push_back(c);
+        }
+    }
+    
+    void setRoute(uint32_t c, const vector<Stop>& route, double cost) {
+        routes[c] = route;
+        routeCosts[c] = cost;
+        for (const Stop& s : route) jobCourier[s.job] = c;
+        markDirty(c);
+    }
+    
+    // Cheapest feasible way to add `job` to courier c's route; returns the
+    // cost increase and leaves the new route in bestRoute
+    double bestInsertion(uint32_t c, uint32_t job, const vector<Stop>& base) {
+        double bestDelta = INFEASIBLE;
+        size_t queued = count_if(base.begin(), base.end(), [](const Stop& s) { return !s.pickup; });
+        if (queued >= couriers[c].capacity * QUEUED_PER_CAPACITY) return bestDelta;
+        double baseCost = evaluate(c, base);
+        size_t n = base.size();
+        // A job already on board only needs its dropoff placed
+        bool needsPickup = !pickedUp[job];
+        size_t pickupSlots = needsPickup ? n + 1 : 1;
+        for (size_t slot = 0; slot < pickupSlots; slot++) {
+            size_t i = needsPickup ? slot : SIZE_MAX;
+            for (size_t k = needsPickup ? i : 0; k <= n; k++) {
+                candidate.clear();
+                for (size_t p = 0; p <= n; p++) {
+                    if (p == i) candidate.push_back({job, true});
+                    if (p == k) candidate.push_back({job, false});
+                    if (p < n) candidate.push_back(base[p]);
+                }
+                double delta = evaluate(c, candidate) - baseCost;
+                if (delta < bestDelta) {
+                    bestDelta = delta;
+                    bestRoute = candidate;
+                }
+            }
+        }
+        return bestDelta;
+    }
+    
+    // Cheapest insertion of a job that still needs collecting into any
+    // courier but `skip`, if one costs less than `limit`. Whatever the route,
+    // the new customer waits at least for the drive to the restaurant and on
+    // to them, so couriers are tried nearest first and the scan stops once
+    // that bound exceeds the best insertion found.
+    double cheapestCourier(uint32_t job, uint32_t skip, double limit, uint32_t& bestCourier, vector<Stop>& chosen) {
+        const DeliveryJob& delivery = jobs[job];
+        double direct = delivery.pickup.metersTo(delivery.dropoff);
+        byBound.clear();
+        for (uint32_t c = 0; c < couriers.size(); c++) {
+            if (c == skip) continue;
+            double meters = couriers[c].position.metersTo(delivery.pickup) + direct;
+            byBound.push_back({meters / couriers[c].metersPerSecond, c});
+        }
+        sort(byBound.begin(), byBound.end());
+        
+        double bestDelta = limit;
+        bestCourier = NO_NODE;
+        for (const auto& [bound, c] : byBound) {
+            if (bound >= bestDelta) break;
+            double delta = bestInsertion(c, job, routes[c]);
+            if (delta < bestDelta) {
+                bestDelta = delta;
+                bestCourier = c;
+                chosen.swap(bestRoute);
+            }
+        }
+        return bestDelta;
+    }
+    
+    // Inserts into whichever courier's route grows the least
+    bool insertJob(uint32_t job) {
+        uint32_t bestCourier;
+        vector<Stop> chosen;
+        double delta = cheapestCourier(job, NO_NODE, INFEASIBLE, bestCourier, chosen);
+        if (bestCourier == NO_NODE) return false;
+        setRoute(bestCourier, chosen, routeCosts[bestCourier] + delta);
+        return true;
+    }
+    
+    bool timeUp() const { return chrono::steady_clock::now() >= deadline; }
+    
+    // Oldest waiting jobs first, until one still does not fit
+    void assignWaiting() {
+        while (!waiting.empty()) {
+            uint32_t job = waiting.front();
+            if (jobCourier[job] == WAITING) {
+                if (!insertJob(job)) return;
+                waitingJobs--;
+            }
+            waiting.pop_front();
+        }
+    }
+    
+    static void withoutJob(const vector<Stop>& route, uint32_t job, vector<Stop>& out) {
+        out.clear();
+        for (const Stop& s : route) {
+            if (s.job != job) out.push_back(s);
+        }
+    }
+    
+    // First-improvement search over one route; true if anything changed
+    bool improveRoute(uint32_t c) {
+        const double epsilon = 1e-6;
+        vector<Stop>& route = routes[c];
+        size_t n = route.size();
+        
+        // 2-opt: reverse a segment
+        for (size_t i = 0; i + 1 < n; i++) {
+            if (timeUp()) return false;
+            for (size_t j = i + 1; j < n; j++) {
+                candidate = route;
+                reverse(candidate.begin() + i, candidate.begin() + j + 1);
+                double cost = evaluate(c, candidate);
+                if (cost < routeCosts[c] - epsilon) {
+                    setRoute(c, candidate, cost);
+                    return true;
+                }
+            }
+        }
+        
+        // Or-opt: move a run of one to three stops elsewhere in the route
+        for (size_t len = 1; len <= 3 && len < n; len++) {
+            for (size_t i = 0; i + len <= n; i++) {
+                if (timeUp()) return false;
+                for (size_t p = 0; p + len <= n; p++) {
+                    if (p == i) continue;
+                    candidate.assign(route.begin(), route.begin() + i);
+                    candidate.insert(candidate.end(), route.begin() + i + len, route.end());
+                    candidate.insert(candidate.begin() + p, route.begin() + i, route.begin() + i + len);
+                    double cost = evaluate(c, candidate);
+                    if (cost < routeCosts[c] - epsilon) {
+                        setRoute(c, candidate, cost);
+                        return true;
+                    }
+                }
+            }
+        }
+        
+        // Relocate: take a job out and put it back wherever it is cheapest,
+        // in this route or another courier's
+        vector<Stop> reduced, moved;
+        for (size_t i = 0; i < n; i++) {
+            // Jobs already on board have no pickup stop and stay with this courier
+            if (!route[i].pickup) continue;
+            if (timeUp()) return false;
+            uint32_t job = route[i].job;
+            withoutJob(route, job, reduced);
+            double reducedCost = evaluate(c, reduced);
+            double delta = bestInsertion(c, job, reduced);
+            if (reducedCost + delta < routeCosts[c] - epsilon) {
+                moved = bestRoute;
+                setRoute(c, moved, reducedCost + delta);
+                return true;
+            }
+            
+            uint32_t other;
+            delta = cheapestCourier(job, c, routeCosts[c] - reducedCost - epsilon, other, moved);
+            if (other != NO_NODE) {
+                setRoute(other, moved, routeCosts[other] + delta);
+                setRoute(c, reduced, reducedCost);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+public:
+    void setFleet(const vector<Courier>& fleet) {
+        couriers = fleet;
+        routes.assign(couriers.size(), {});
+        routeCosts.assign(couriers.size(), 0);
+        isDirty.assign(couriers.size(), false);
+        dirty.clear();
+        waiting.clear();
+        waitingJobs = 0;
+        for (uint32_t job = 0; job < jobs.size(); job++) {
+            if (jobCourier[job] == NO_NODE) continue;
+            if (!insertJob(job)) {
+                jobCourier[job] = WAITING;
+                waiting.push_back(job);
+                waitingJobs++;
+            }
+        }
+    }
+    
+    // Adds an order and re-optimises the routes it touched within `budget`.
+    // Returns false without couriers or for a known order; a job no route
+    // has room for is accepted and waits.
+    bool addJob(const DeliveryJob& delivery, chrono::microseconds budget) {
+        if (couriers.empty() || jobIndex.search(delivery.orderId)) return false;
+        auto start = chrono::steady_clock::now();
+        uint32_t job;
+        if (!freeJobs.empty()) {
+            job = freeJobs.back();
+            freeJobs.pop_back();
+            jobs[job] = delivery;
+            pickedUp[job] = false;
+        } else {
+            job = static_cast<uint32_t>(jobs.size());
+            jobs.push_back(delivery);
+            jobCourier.push_back(NO_NODE);
+            pickedUp.push_back(false);
+            seenStamp.push_back(0);
+        }
+        // Jobs already waiting go first
+        if (waitingJobs > 0 || !insertJob(job)) {
+            jobCourier[job] = WAITING;
+            waiting.push_back(job);
+            waitingJobs++;
+        }
+        jobIndex.insert(delivery.orderId, job);
+        metrics.jobsAdded++;
+        metrics.insertSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        improve(budget);
+        return true;
+    }
+    
+    // Local search over dirty routes until they are locally optimal or the budget is spent
+    void improve(chrono::microseconds budget) {
+        auto start = chrono::steady_clock::now();
+        deadline = start + budget;
+        assignWaiting();
+        while (!dirty.empty() && !timeUp()) {
+            uint32_t c = dirty.front();
+            dirty.pop_front();
+            isDirty[c] = false;
+            if (improveRoute(c)) {
+                metrics.improvingMoves++;
+            } else if (timeUp()) {
+                // Interrupted before the route was fully searched
+                markDirty(c);
+            }
+        }
+        metrics.improveSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    
+    // Puts every route back on the work list, e.g. for a longer offline pass
+    void reoptimize(chrono::microseconds budget) {
+        for (uint32_t c = 0; c < couriers.size(); c++) markDirty(c);
+        improve(budget);
+    }
+    
+    // The courier has collected the order; it stays with that courier. An
+    // order collected while still waiting was handled outside the plan and
+    // simply leaves it.
+    bool markPickedUp(EntityId orderId) {
+        const uint32_t* job = jobIndex.search(orderId);
+        if (!job || pickedUp[*job]) return false;
+        if (jobCourier[*job] == WAITING) return removeJob(orderId);
+        uint32_t c = jobCourier[*job];
+        vector<Stop>& route = routes[c];
+        route.erase(remove_if(route.begin(), route.end(),
+                              [&](const Stop& s) { return s.job == *job && s.pickup; }), route.end());
+        pickedUp[*job] = true;
+        routeCosts[c] = evaluate(c, route);
+        markDirty(c);
+        return true;
+    }
+    
+    // Delivered or cancelled orders leave the plan
+    bool removeJob(EntityId orderId) {
+        const uint32_t* found = jobIndex.search(orderId);
+        if (!found) return false;
+        uint32_t job = *found;
+        uint32_t c = jobCourier[job];
+        if (c == WAITING) {
+            waitingJobs--;
+        } else {
+            vector<Stop> reduced;
+            withoutJob(routes[c], job, reduced);
+            routes[c] = reduced;
+            routeCosts[c] = evaluate(c, reduced);
+            markDirty(c);
+        }
+        jobCourier[job] = NO_NODE;
+        freeJobs.push_back(job);
+        jobIndex.remove(orderId);
+        return true;
+    }
+    
+    // Simulation hook: courier c drives to and serves its next stop
+    bool completeNextStop(uint32_t c) {
+        if (routes[c].empty()) return false;
+        Stop next = routes[c].front();
+        couriers[c].position = where(next);
+        if (next.pickup) {
+            markPickedUp(jobs[next.job].orderId);
+        } else {
+            removeJob(jobs[next.job].orderId);
+        }
+        return true;
+    }
+    
+    size_t courierCount() const { return couriers.size(); }
+    size_t jobCount() const { return jobIndex.size(); }
+    size_t waitingCount() const { return waitingJobs; }
+    const Courier& courier(uint32_t c) const { return couriers[c]; }
+    const vector<Stop>& route(uint32_t c) const { return routes[c]; }
+    const DeliveryJob& job(uint32_t j) const { return jobs[j]; }
+    double routeCost(uint32_t c) const { return routeCosts[c]; }
+    const Metrics& stats() const { return metrics; }
+    
+    double totalCost() const {
+        double total = 0;
+        for (double cost : routeCosts) total += cost;
+        return total;
+    }
+};
+
+// ======================= ALGORITHMS =======================
+
+class SortingAlgorithms {
+private:
+    static constexpr size_t PARALLEL_MIN = 1 << 16;
+    
+    // A run length in [8, 16] that makes n / minRun a power of two or just
+    // below one, so the merges stay balanced. Timsort uses [32, 64] because
+    // its comparisons are expensive; here element moves dominate.
+    static size_t minRunLength(size_t n) {
+        size_t odd = 0;
+        while (n >= 16) {
+            odd |= n & 1;
+            n >>= 1;
+        }
+        return n + odd;
+    }
+    
+    // [first, sortedEnd) is sorted; grows it to [first, last)
+    template<typename It, typename Less>
+    static void binaryInsertionSort(It first, It sortedEnd, It last, Less lessThan) {
+        for (It it = sortedEnd; it != last; ++it) {
+            It position = upper_bound(first, it, *it, lessThan);
+            if (position == it) continue;
+            auto value = move(*it);
+            move_backward(position, it, it + 1);
+            *position = move(value);
+        }
+    }
+    
+    // Stable merge of the sorted ranges [first, middle) and [middle, last).
+    // Elements already in their final place at either end are trimmed off
+    // first, and only what is left of the left run is moved into `buffer`.
+    template<typename It, typename Less, typename T>
+    static void mergeRuns(It first, It middle, It last, Less lessThan, vector<T>& buffer) {
+        if (first == middle || middle == last || !lessThan(*middle, *(middle - 1))) return;
+        first = upper_bound(first, middle, *middle, lessThan);
+        last = lower_bound(middle, last, *(middle - 1), lessThan);
+        
+        buffer.assign(make_move_iterator(first), make_move_iterator(middle));
+        auto left = buffer.begin();
+        It right = middle, out = first;
+        while (left != buffer.end() && right != last) {
+            *out++ = lessThan(*right, *left) ? move(*right++) : move(*left++);
+        }
+        move(left, buffer.end(), out);
+        buffer.clear();
+    }
+    
+    // Natural runs (strictly descending ones reversed in place) are extended
+    // to the minimum run length by insertion sort, then merged bottom-up
+    template<typename It, typename Less, typename T>
+    static void sortRange(It first, It last, Less lessThan, vector<T>& buffer) {
+        size_t n = last - first;
+        if (n < 2) return;
+        size_t minRun = minRunLength(n);
+        
+        vector<size_t> runStarts;
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            if (j < n && lessThan(first[j], first[j - 1])) {
+                while (j < n && lessThan(first[j], first[j - 1])) j++;
+                reverse(first + i, first + j);
+            } else {
+                while (j < n && !lessThan(first[j], first[j - 1])) j++;
+            }
+            size_t end = min(n, max(j, i + minRun));
+            binaryInsertionSort(first + i, first + j, first + end, lessThan);
+            runStarts.push_back(i);
+            i = end;
+        }
+        
+        while (runStarts.size() > 1) {
+            vector<size_t> merged;
+            for (size_t r = 0; r < runStarts.size(); r += 2) {
+                merged.push_back(runStarts[r]);
+                if (r + 1 == runStarts.size()) break;
+                size_t end = r + 2 < runStarts.size() ? runStarts[r + 2] : n;
+                mergeRuns(first + runStarts[r], first + runStarts[r + 1], first + end, lessThan, buffer);
+            }
+            runStarts.swap(merged);
+        }
+    }
+    
+public:
+    // Production sort: stable, O(n log n), and all merging goes through
+    // one buffer that is reused for every step. Inputs that are already
+    // partly ordered take fewer merges. With a pool and at least
+    // PARALLEL_MIN elements, one chunk per worker is sorted concurrently
+    // and the chunks are merged pairwise, each pass in parallel.
+    template<typename T, typename Less = less<>>
+    static void hybridSort(vector<T>& arr, Less lessThan = Less(), ThreadPool* pool = nullptr) {
+        size_t n = arr.size();
+        if (!pool || pool->size() < 2 || n < PARALLEL_MIN) {
+            vector<T> buffer;
+            sortRange(arr.begin(), arr.end(), lessThan, buffer);
+            return;
+        }
+        
+        size_t chunk = (n + pool->size() - 1) / pool->size();
+        pool->parallelFor(pool->size(), [&](size_t i) {
+            vector<T> buffer;
+            size_t begin = min(n, i * chunk);
+            sortRange(arr.begin() + begin, arr.begin() + min(n, begin + chunk), lessThan, buffer);
+        });
+        for (size_t width = chunk; width < n; width *= 2) {
+            pool->parallelFor((n + 2 * width - 1) / (2 * width), [&](size_t i) {
+                vector<T> buffer;
+                size_t begin = i * 2 * width;
+                size_t middle = min(n, begin + width);
+                mergeRuns(arr.begin() + begin, arr.begin() + middle, arr.begin() + min(n, begin + 2 * width),
+                          lessThan, buffer);
+            });
+        }
+    }
+    
+    // Sorts small (key, index) pairs instead of whole objects and returns
+    // the indices in key order; equal keys keep their input order
+    template<typename T, typename KeyFn>
+    static vector<uint32_t> sortedOrder(const vector<T>& items, KeyFn keyOf, ThreadPool* pool = nullptr) {
+        using Key = decltype(keyOf(items[0]));
+        vector<pair<Key, uint32_t>> keyed;
+        keyed.reserve(items.size());
+        for (uint32_t i = 0; i < items.size(); i++) keyed.emplace_back(keyOf(items[i]), i);
+        hybridSort(keyed, [](const pair<Key, uint32_t>& a, const pair<Key, uint32_t>& b) {
+            return a.first < b.first;
+        }, pool);
+        
+        vector<uint32_t> order;
+        order.reserve(keyed.size());
+        for (const auto& k : keyed) order.push_back(k.second);
+        return order;
+    }
+    
+    // Textbook top-down merge sort, kept as the baseline for the analysis
+    // and benchmarks; it allocates and copies on every merge
+    template<typename T>
+    static void mergeSort(vector<T>& arr, int left, int right) {
+        if (left < right) {
+            int mid = left + (right - left) / 2;
+            mergeSort(arr, left, mid);
+            mergeSort(arr, mid + 1, right);
+            merge(arr, left, mid, right);
+        }
+    }
+    
+    template<typename T>
+    static void merge(vector<T>& arr, int left, int mid, int right) {
+        int n1 = mid - left + 1;
+        int n2 = right - mid;
+        
+        vector<T> leftArr(n1), rightArr(n2);
+        
+        for (int i = 0; i < n1; i++)
+            leftArr[i] = arr[left + i];
+        for (int j = 0; j < n2; j++)
+            rightArr[j] = arr[mid + 1 + j];
+        
+        int i = 0, j = 0, k = left;
+        
+        while (i < n1 && j < n2) {
+            if (leftArr[i] < rightArr[j]) {
+                arr[k] = leftArr[i];
+                i++;
+            } else {
+                arr[k] = rightArr[j];
+                j++;
+            }
+            k++;
+        }
+        
+        while (i < n1) {
+            arr[k] = leftArr[i];
+            i++;
+            k++;
+        }
+        
+        while (j < n2) {
+            arr[k] = rightArr[j];
+            j++;
+            k++;
+        }
+    }
+    
+    template<typename T>
+    static void bubbleSort(vector<T>& arr) {
+        int n = arr.size();
+        for (int i = 0; i < n - 1; i++) {
+            for (int j = 0; j < n - i - 1; j++) {
+                if (arr[j] > arr[j + 1]) {
+                    swap(arr[j], arr[j + 1]);
+                }
+            }
+        }
+    }
+    
+    // Median of several runs per algorithm on the same 1000 keys; the
+    // full suite is `--bench`
+    static void performanceAnalysis() {
+        cout << "\n=== SORTING ALGORITHM PERFORMANCE ANALYSIS ===\n";
+        
+        const int size = 1000, runs = 7;
+        vector<int> testData(size);
+        for (int i = 0; i < size; i++) {
+            testData[i] = rand() % 1000;
+        }
+        
+        auto medianMicros = [&](auto sortFn) {
+            vector<double> times;
+            for (int r = 0; r < runs; r++) {
+                vector<int> data = testData;
+                auto start = chrono::steady_clock::now();
+                sortFn(data);
+                times.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+            }
+            sort(times.begin(), times.end());
+            return times[runs / 2];
+        };
+        double hybrid = medianMicros([](vector<int>& v) { hybridSort(v); });
+        double merge = medianMicros([](vector<int>& v) { mergeSort(v, 0, v.size() - 1); });
+        double bubble = medianMicros([](vector<int>& v) { bubbleSort(v); });
+        
+        cout << "Median of " << runs << " runs on " << size << " elements:\n";
+        cout << "Hybrid Sort: " << hybrid << " microseconds\n";
+        cout << "Merge Sort: " << merge << " microseconds\n";
+        cout << "Bubble Sort: " << bubble << " microseconds\n";
+        // Timer resolution can make a fast sort read as zero
+        if (hybrid > 0 && merge > 0) {
+            cout << "Hybrid Sort is " << bubble / hybrid << "x and Merge Sort " << bubble / merge
+                 << "x faster than Bubble Sort\n";
+        }
+        cout << "Run with --bench for the full benchmark suite\n";
+    }
+};
+
+class SearchAlgorithms {
+public:
+    template<typename T>
+    static int linearSearch(const vector<T>& arr, const T& target) {
+        for (int i = 0; i < arr.size(); i++) {
+            if (arr[i] == target) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    
+    // Routes across roads.txt, or a generated grid city when it is missing
+    static void demonstrateRouting() {
+        cout << "\n=== DELIVERY ROUTING ===\n";
+        
+        RoadGraph graph;
+        if (!graph.load("roads.txt")) {
+            cout << "roads.txt not found, using a generated 40x40 grid city\n";
+            graph = RoadGraph::grid(40, 7);
+        }
+        if (graph.nodeCount() < 2) {
+            cout << "Road network is empty\n";
+            return;
+        }
+        cout << "Road network: " << graph.nodeCount() << " junctions, " << graph.edgeCount() << " road segments\n";
+        
+        auto start = chrono::steady_clock::now();
+        ContractionHierarchy hierarchy;
+        hierarchy.build(graph);
+        auto micros = [](chrono::steady_clock::time_point since) {
+            return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - since).count();
+        };
+        cout << "Contraction hierarchy: " << hierarchy.shortcutCount() << " shortcuts in " << micros(start)
+             << " microseconds\n";
+        
+        RouteWorkspace ws;
+        vector<uint32_t> path;
+        uint32_t restaurant = 0, customer = graph.nodeCount() - 1;
+        cout << "Restaurant at junction " << graph.externalId(restaurant) << ", customer at junction "
+             << graph.externalId(customer) << "\n";
+        
+        start = chrono::steady_clock::now();
+        uint32_t meters = ShortestPaths::dijkstra(graph, restaurant, customer, ws);
+        cout << "Dijkstra: " << meters << " m in " << micros(start) << " microseconds\n";
+        start = chrono::steady_clock::now();
+        meters = ShortestPaths::aStar(graph, restaurant, customer, ws);
+        cout << "A*: " << meters << " m in " << micros(start) << " microseconds\n";
+        start = chrono::steady_clock::now();
+        meters = hierarchy.query(restaurant, customer, ws, &path);
+        cout << "Contraction hierarchy: " << meters << " m in " << micros(start) << " microseconds\n";
+        
+        if (meters == UNREACHABLE) {
+            cout << "Customer is unreachable from the restaurant\n";
+            return;
+        }
+        cout << "Route (" << path.size() << " junctions): ";
+        for (size_t i = 0; i < path.size(); i++) {
+            if (i == 8 && path.size() > 10) {
+                cout << "... -> ";
+                i = path.size() - 1;
+            }
+            cout << graph.externalId(path[i]) << (i + 1 < path.size() ? " -> " : "\n");
+        }
+    }
+};
+
+// ======================= MAIN SYSTEM =======================
+
+// The programmatic API (addRestaurant, addCustomer, placeOrder,
+// setOrderStatus, findOrder, orderedItem) may be called from any number of
+// threads at once:
+//   - customers live in the store's lock-striped table;
+//   - restaurants and the indexes built from them (menu, search, spatial)
+//     sit behind catalogLock, shared by every order and exclusive only
+//     while a restaurant is added;
+//   - orders are spread over shards by id, each an OrderLifecycle behind
+//     its own mutex. A change to an order is applied, logged, added to
+//     analytics and queued for dispatch under its shard lock, so the log
+//     and every view see an order's changes in the order they took effect
+//     (per-order linearizability). The wait for the group commit happens
+//     after the locks are released;
+//   - courier routing stays off the request path: a dispatcher thread
+//     applies the queued changes under dispatchLock and spends the
+//     dispatch budget improving routes.
+// Lock order: catalogLock or a customer stripe, then a shard, then
+// historyLock; dispatchLock, then a customer stripe or dispatchQueueLock.
+//
+// Everything else (the interactive menu, snapshots, batches, the accessors
+// returning pointers or references) is for a single driving thread while
+// no other thread makes changes.
+class FoodDeliverySystem {
+private:
+    struct alignas(64) OrderShard {
+        mutex lock;
+        OrderLifecycle orders;
+        
+        OrderShard(WriteAheadLog& wal, AsyncStatusLog* tracking) : orders(wal, tracking) {}
+    };
+    
+    static constexpr unsigned ORDER_SHARD_BITS = 6;
+    
+    EntityStore store;
+    mutable shared_mutex catalogLock;
+    MenuIndex menuIndex;
+    MenuSearch menuSearch;
+    SpatialIndex restaurantLocations;
+    
+    WriteAheadLog wal;
+    vector<unique_ptr<OrderShard>> shards;
+    
+    mutex historyLock;
+    Stack<EntityId> orderHistory;
+    OrderAnalytics analytics;
+    
+    static constexpr const char* SNAPSHOT_PATH = "system.snap";
+    static constexpr const char* WAL_PATH = "system.wal";
+    static constexpr const char* RESTAURANTS_PATH = "restaurants.dat";
+    static constexpr const char* CUSTOMERS_PATH = "customers.txt";
+    
+    SnowflakeIdGenerator ids;
+    
+    // A placed order (a new job from pickup to dropoff, already in
+    // `status`) or a later status change, waiting for the dispatcher thread
+    struct DispatchChange {
+        EntityId orderId;
+        OrderStatus status;
+        bool placed;
+        GeoPoint pickup;
+        GeoPoint dropoff;
+    };
+    
+    mutex dispatchLock;
+    Dispatcher dispatcher;
+    vector<DispatchChange> dispatchBatch;    // being applied, under dispatchLock
+    
+    mutex dispatchQueueLock;
+    condition_variable dispatchWake;
+    vector<DispatchChange> dispatchQueue;
+    bool stopDispatching = false;
+    thread dispatchThread;
+    
+    static constexpr size_t MIN_FLEET = 4;
+    static constexpr size_t RESTAURANTS_PER_COURIER = 10;
+    static constexpr chrono::microseconds DISPATCH_BUDGET{2000};
+    atomic<chrono::microseconds> dispatchBudget{DISPATCH_BUDGET};
+    
+    // Bumped whenever a restaurant is added or replaced, so callers can cache views
+    atomic<uint64_t> restaurantChanges{0};
+    
+    // Top hash bits, so each shard's own index still sees well-spread low bits
+    OrderShard& shardFor(EntityId orderId) {
+        return *shards[mixHash(orderId) >> (64 - ORDER_SHARD_BITS)];
+    }
+    
+    // Every order of one status, shard by shard, each under its lock
+    template<typename F>
+    void forEachOrder(OrderStatus status, F fn) {
+        for (auto& shard : shards) {
+            lock_guard<mutex> lock(shard->lock);
+            shard->orders.forEach(status, fn);
+        }
+    }
+    
+    template<typename F>
+    void forEachActive(F fn) {
+        for (size_t s = 0; s < ORDER_STATUS_COUNT; s++) {
+            if (!isTerminal(static_cast<OrderStatus>(s))) forEachOrder(static_cast<OrderStatus>(s), fn);
+        }
+    }
+    
+    template<typename F>
+    void forEachCompleted(F fn) {
+        forEachOrder(OrderStatus::Delivered, fn);
+        forEachOrder(OrderStatus::Cancelled, fn);
+    }
+    
+    static bool readId(EntityId& id) {
+        string text;
+        cin >> text;
+        if (parseId(text, id)) return true;
+        cout << "Invalid ID!\n";
+        return false;
+    }
+    
+    // Latitude and longitude on one line; a blank line leaves the location unknown
+    static GeoPoint readLocation() {
+        string line;
+        cout << "Enter location as latitude,longitude (blank if unknown): ";
+        getline(cin, line);
+        string_view rest = line;
+        GeoPoint location;
+        if (!line.empty() && (!parseLocation(rest, location) || !rest.empty())) {
+            cout << "Invalid location, leaving it unknown\n";
+            location = GeoPoint();
+        }
+        return location;
+    }
+    
+public:
+    explicit FoodDeliverySystem(const WalOptions& walOptions = WalOptions()) {
+        for (size_t i = 0; i < (size_t(1) << ORDER_SHARD_BITS); i++) {
+            shards.push_back(make_unique<OrderShard>(wal, &AsyncStatusLog::orderTracking()));
+        }
+        loadSystemData();
+        size_t validBytes = replayLog();
+        if (!wal.open(WAL_PATH, walOptions, validBytes)) {
+            cerr << WAL_PATH << ": cannot open log, changes will not be persisted\n";
+        }
+        startDispatch();
+        dispatchThread = thread([this] { dispatchLoop(); });
+    }
+    
+    // Routes whatever is still queued before the system goes away
+    ~FoodDeliverySystem() {
+        {
+            lock_guard<mutex> lock(dispatchQueueLock);
+            stopDispatching = true;
+        }
+        dispatchWake.notify_one();
+        dispatchThread.join();
+    }
+    
+    // One courier per RESTAURANTS_PER_COURIER restaurants with coordinates
+    // (at least MIN_FLEET), starting at those restaurants; with none known
+    // there is nothing to dispatch from
+    void startDispatch() {
+        shared_lock<shared_mutex> catalog(catalogLock);
+        vector<GeoPoint> bases;
+        for (const auto& restaurant : store.allRestaurants()) {
+            if (restaurant.location.isKnown()) bases.push_back(restaurant.location);
+        }
+        vector<Courier> fleet;
+        size_t fleetSize = bases.empty() ? 0 : max(MIN_FLEET, bases.size() / RESTAURANTS_PER_COURIER);
+        for (size_t i = 0; i < fleetSize; i++) {
+            const GeoPoint& base = bases[i * bases.size() / fleetSize % bases.size()];
+            fleet.push_back({static_cast<uint32_t>(i + 1), base, 3, 6.0});
+        }
+        
+        // Copied out first: customer stripes come before shards in the lock order
+        vector<Order> active;
+        forEachActive([&active](const Order& order) { active.push_back(order); });
+        lock_guard<mutex> lock(dispatchLock);
+        dispatcher.setFleet(fleet);
+        for (const Order& order : active) {
+            const Restaurant* restaurant = store.findRestaurant(order.restaurantId);
+            GeoPoint dropoff;
+            if (restaurant && customerLocation(order.customerId, dropoff)) {
+                applyDispatch({order.orderId, order.status, true, restaurant->location, dropoff});
+            }
+        }
+        dispatcher.reoptimize(DISPATCH_BUDGET * 10);
+    }
+    
+    // Orders are routed only when both ends have coordinates; the caller
+    // holds dispatchLock
+    void applyDispatch(const DispatchChange& change) {
+        if (change.placed) {
+            if (!change.pickup.isKnown() || !change.dropoff.isKnown() || isTerminal(change.status)) return;
+            if (!dispatcher.addJob({change.orderId, change.pickup, change.dropoff},
+                                   dispatchBudget.load(memory_order_relaxed))) {
+                return;
+            }
+            if (change.status == OrderStatus::PickedUp) dispatcher.markPickedUp(change.orderId);
+        } else if (change.status == OrderStatus::PickedUp) {
+            dispatcher.markPickedUp(change.orderId);
+        } else if (isTerminal(change.status)) {
+            dispatcher.removeJob(change.orderId);
+        }
+    }
+    
+    // Callers hold the order's shard lock, so one order's changes are
+    // queued in the order they took effect
+    void queueDispatch(const DispatchChange& change) {
+        bool wasEmpty;
+        {
+            lock_guard<mutex> lock(dispatchQueueLock);
+            wasEmpty = dispatchQueue.empty();
+            dispatchQueue.push_back(change);
+        }
+        if (wasEmpty) dispatchWake.notify_one();
+    }
+    
+    // Applies everything queued so far, in order; the caller holds dispatchLock
+    void applyQueuedDispatch() {
+        {
+            lock_guard<mutex> lock(dispatchQueueLock);
+            dispatchBatch.swap(dispatchQueue);
+        }
+        for (const DispatchChange& change : dispatchBatch) applyDispatch(change);
+        dispatchBatch.clear();
+    }
+    
+    // The dispatcher thread: routes queued changes as they arrive and then
+    // spends the dispatch budget on the routes; drains the queue on shutdown
+    void dispatchLoop() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(dispatchQueueLock);
+                dispatchWake.wait(lock, [this] { return stopDispatching || !dispatchQueue.empty(); });
+                if (dispatchQueue.empty()) return;
+            }
+            lock_guard<mutex> lock(dispatchLock);
+            applyQueuedDispatch();
+            dispatcher.improve(dispatchBudget.load(memory_order_relaxed));
+        }
+    }
+    
+    // Feeds a placed order to analytics, history and dispatch; the caller
+    // holds the order's shard lock
+    void recordPlaced(const Order& order, const GeoPoint& pickup, const GeoPoint& dropoff) {
+        {
+            lock_guard<mutex> lock(historyLock);
+            analytics.add(order);
+            orderHistory.push(order.orderId);
+        }
+        if (pickup.isKnown() && dropoff.isKnown()) {
+            queueDispatch({order.orderId, order.status, true, pickup, dropoff});
+        }
+    }
+    
+    // Maps (restaurant id, item name) to a menu position for older records
+    auto menuPosition() {
+        return [this](EntityId restaurantId, string_view name) {
+            const Restaurant* restaurant = store.findRestaurant(restaurantId);
+            return restaurant ? restaurant->findItem(name) : UNLISTED_ITEM;
+        };
+    }
+    
+    // Re-applies every mutation logged since the last snapshot
+    size_t replayLog() {
+        size_t records = 0;
+        size_t validBytes = WriteAheadLog::replay(WAL_PATH, [this](WalRecordType type, WalDecoder& in) {
+            switch (type) {
+                case WalRecordType::CustomerAdded: {
+                    Customer customer = Customer::decode(in);
+                    if (in.ok()) store.addCustomer(move(customer));
+                    break;
+                }
+                case WalRecordType::RestaurantAddedV1:
+                case WalRecordType::RestaurantAdded: {
+                    Restaurant restaurant = Restaurant::decode(in, type == WalRecordType::RestaurantAddedV1);
+                    if (!in.ok()) break;
+                    indexRestaurant(restaurant);
+                    store.addRestaurant(move(restaurant));
+                    break;
+                }
+                case WalRecordType::OrderPlacedV1:
+                case WalRecordType::OrderPlacedV2:
+                case WalRecordType::OrderPlaced: {
+                    Order order = type == WalRecordType::OrderPlacedV1
+                        ? Order::decodeV1(in, menuPosition())
+                        : Order::decode(in, type == WalRecordType::OrderPlacedV2);
+                    if (in.ok()) restoreOrder(move(order));
+                    break;
+                }
+                case WalRecordType::OrderStatusChangedV1:
+                case WalRecordType::OrderStatusChanged: {
+                    EntityId orderId;
+                    OrderStatus status;
+                    time_t at;
+                    if (Order::decodeStatusChange(type, in, orderId, status, at)) {
+                        shardFor(orderId).orders.restoreStatus(orderId, status, at);
+                        analytics.setStatus(orderId, status);
+                    }
+                    break;
+                }
+                default:
+                    // Includes the pre-integer-id record types 1-4
+                    cerr << WAL_PATH << ": skipping unknown record type " << static_cast<int>(type) << "\n";
+            }
+        }, records);
+        if (records > 0) {
+            cerr << "Replayed " << records << " log records\n";
+        }
+        return validBytes;
+    }
+    
+    // Keeps the price, search and spatial indexes in step with a new or
+    // replaced restaurant; call before the record goes into the store
+    void indexRestaurant(const Restaurant& restaurant) {
+        if (store.findRestaurant(restaurant.id)) {
+            menuIndex.eraseRestaurant(restaurant.id);
+            menuSearch.removeRestaurant(restaurant.id);
+            restaurantLocations.erase(restaurant.id);
+        }
+        menuIndex.addMenu(restaurant);
+        menuSearch.addRestaurant(restaurant);
+        restaurantLocations.insert(restaurant.id, restaurant.location);
+        restaurantChanges++;
+    }
+    
+    // Load path, before any other thread runs
+    void restoreOrder(Order&& order) {
+        order.restaurant = store.restaurantHandle(order.restaurantId);
+        EntityId orderId = order.orderId;
+        ids.observe(orderId);
+        OrderLifecycle& orders = shardFor(orderId).orders;
+        if (orders.add(move(order))) {
+            analytics.add(*orders.find(orderId));
+            orderHistory.push(orderId);
+        }
+    }
+    
+    // Progress goes to stderr: in batch mode stdout carries only answers
+    void loadSystemData() {
+        cerr << "Loading system data from files...\n";
+        
+        auto start = chrono::steady_clock::now();
+        // Once a snapshot exists the log only holds what came after it, so
+        // the snapshot is the whole base state. The text files only seed a
+        // fresh system; applying them over a snapshot would roll back every
+        // change made since, so that takes an explicit importTextFiles()
+        error_code ec;
+        bool fromSnapshot = filesystem::exists(SNAPSHOT_PATH, ec);
+        if (fromSnapshot) {
+            loadFromSnapshot();
+            if (!isNewerThan(SNAPSHOT_PATH, {RESTAURANTS_PATH, CUSTOMERS_PATH})) {
+                cerr << "Text files changed since " << SNAPSHOT_PATH
+                     << " are not loaded over it; use the IMPORT batch command to apply them\n";
+            }
+        } else {
+            ThreadPool pool;
+            ParallelLoader::loadRestaurants(RESTAURANTS_PATH, store, &pool);
+            ParallelLoader::loadCustomers(CUSTOMERS_PATH, store, &pool);
+        }
+        
+        vector<MenuEntry> menuEntries;
+        vector<SpatialIndex::Entry> locations;
+        for (const auto& restaurant : store.allRestaurants()) {
+            for (const auto& item : restaurant.menu) {
+                if (!item.retired) menuEntries.emplace_back(item.price, restaurant.id, item.name, item.category);
+            }
+            menuSearch.addRestaurant(restaurant);
+            locations.push_back({restaurant.location, restaurant.id});
+        }
+        menuIndex.build(move(menuEntries));
+        restaurantLocations.build(move(locations));
+        
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cerr << "System loaded: " << store.restaurantCount() << " restaurants, " 
+             << store.customerCount() << " customers in " << seconds << " s"
+             << (fromSnapshot ? " (snapshot)" : "") << "\n\n";
+    }
+    
+    // Falling back to the text files would silently drop everything the
+    // snapshot took over from the log, so an unreadable snapshot stops
+    // startup before the log is opened
+    void loadFromSnapshot() {
+        SnapshotView snap(SNAPSHOT_PATH);
+        if (!snap.isValid()) {
+            throw runtime_error(string(SNAPSHOT_PATH) + ": " + snap.errorMessage() +
+                                "; refusing to start without it (move it aside to load the text files)");
+        }
+        
+        store.reserve(snap.restaurantCount(), snap.customerCount());
+        for (size_t i = 0; i < snap.restaurantCount(); i++) {
+            const SnapshotRestaurant& rec = snap.restaurant(i);
+            Restaurant restaurant(rec.id, string(snap.str(rec.name)), rec.rating,
+                                  string(snap.str(rec.address)));
+            restaurant.location = GeoPoint(rec.latitude, rec.longitude);
+            uint64_t items = snap.menuItemCount(rec);
+            restaurant.menu.reserve(items);
+            for (uint64_t j = 0; j < items; j++) {
+                if (const SnapshotMenuItem* item = snap.menuItem(rec.firstMenuItem + j)) {
+                    restaurant.menu.push_back(snap.toMenuItem(*item));
+                }
+            }
+            store.addRestaurant(move(restaurant));
+        }
+        
+        for (size_t i = 0; i < snap.customerCount(); i++) {
+            const SnapshotCustomer& rec = snap.customer(i);
+            Customer customer(rec.id, string(snap.str(rec.name)), string(snap.str(rec.phone)),
+                              string(snap.str(rec.address)));
+            customer.location = GeoPoint(rec.latitude, rec.longitude);
+            store.addCustomer(move(customer));
+        }
+        
+        analytics.reserve(snap.orderCount());
+        for (size_t i = 0; i < snap.orderCount(); i++) {
+            restoreOrder(snap.toOrder(i, menuPosition()));
+        }
+    }
+    
+    // ---- Programmatic API: no prompts and no console output ----
+    // Outside a batch each change waits for its log commit and throws
+    // LogWriteError when that fails.
+    
+    bool writeSnapshot() {
+        SnapshotWriter writer;
+        for (const auto& restaurant : store.allRestaurants()) {
+            writer.addRestaurant(restaurant);
+        }
+        store.forEachCustomer([&writer](const Customer& customer) { writer.addCustomer(customer); });
+        auto addOrder = [&writer](const Order& order) { writer.addOrder(order); };
+        forEachActive(addOrder);
+        forEachCompleted(addOrder);
+        
+        if (!writer.write(SNAPSHOT_PATH)) return false;
+        // Everything logged so far is now durably in the snapshot
+        wal.reset();
+        return true;
+    }
+    
+    // Adds or replaces a restaurant, drawing a fresh id when it has none; a
+    // replacement keeps the old menu positions (Restaurant::keepMenuPositions)
+    EntityId addRestaurant(Restaurant&& restaurant) {
+        if (!restaurant.id) restaurant.id = ids.next();
+        ids.observe(restaurant.id);
+        EntityId id = restaurant.id;
+        uint64_t lsn;
+        {
+            unique_lock<shared_mutex> lock(catalogLock);
+            if (const Restaurant* previous = store.findRestaurant(id)) restaurant.keepMenuPositions(previous->menu);
+            lsn = restaurant.appendToLog(wal);
+            indexRestaurant(restaurant);
+            store.addRestaurant(move(restaurant));
+        }
+        wal.awaitCommit(lsn);
+        return id;
+    }
+    
+    EntityId addCustomer(Customer&& customer) {
+        if (!customer.id) customer.id = ids.next();
+        ids.observe(customer.id);
+        EntityId id = customer.id;
+        uint64_t lsn = store.addCustomer(move(customer), [this](const Customer& added) {
+            return added.appendToLog(wal);
+        });
+        wal.awaitCommit(lsn);
+        return id;
+    }
+    
+    // Places an order for the given menu item indexes, logging and
+    // dispatching it; returns 0 if either party is unknown or no index is valid
+    EntityId placeOrder(EntityId customerId, EntityId restaurantId, const vector<uint32_t>& items) {
+        GeoPoint dropoff;
+        if (!customerLocation(customerId, dropoff)) return 0;
+        
+        Order order(0, customerId, restaurantId);
+        GeoPoint pickup;
+        {
+            shared_lock<shared_mutex> lock(catalogLock);
+            Handle handle = store.restaurantHandle(restaurantId);
+            const Restaurant* restaurant = store.restaurant(handle);
+            if (!restaurant) return 0;
+            order.restaurant = handle;
+            pickup = restaurant->location;
+            for (uint32_t item : items) order.addItem(*restaurant, item);
+        }
+        if (order.lines.empty()) return 0;
+        
+        EntityId orderId = ids.next();
+        order.orderId = orderId;
+        uint64_t lsn;
+        {
+            OrderShard& shard = shardFor(orderId);
+            lock_guard<mutex> lock(shard.lock);
+            lsn = order.appendToLog(wal);
+            recordPlaced(order, pickup, dropoff);
+            shard.orders.add(move(order));
+        }
+        wal.awaitCommit(lsn);
+        return orderId;
+    }
+    
+    // Moves an order along its lifecycle and keeps courier routes in step
+    OrderLifecycle::Result setOrderStatus(EntityId orderId, OrderStatus next) {
+        uint64_t lsn = 0;
+        {
+            OrderShard& shard = shardFor(orderId);
+            lock_guard<mutex> lock(shard.lock);
+            OrderLifecycle::Result result = shard.orders.advanceLogged(orderId, next, lsn);
+            if (result != OrderLifecycle::Result::Ok) return result;
+            {
+                lock_guard<mutex> history(historyLock);
+                analytics.setStatus(orderId, next);
+            }
+            if (next == OrderStatus::PickedUp || isTerminal(next)) {
+                queueDispatch({orderId, next, false, GeoPoint(), GeoPoint()});
+            }
+        }
+        wal.awaitCommit(lsn);
+        return OrderLifecycle::Result::Ok;
+    }
+    
+    // Applies restaurants.dat and customers.txt over the current state
+    // through addRestaurant/addCustomer, so every record is logged like any
+    // other change; returns the number of records applied
+    size_t importTextFiles() {
+        EntityStore parsed;
+        ThreadPool pool;
+        size_t applied = ParallelLoader::loadRestaurants(RESTAURANTS_PATH, parsed, &pool);
+        applied += ParallelLoader::loadCustomers(CUSTOMERS_PATH, parsed, &pool);
+        for (const auto& restaurant : parsed.allRestaurants()) {
+            addRestaurant(Restaurant(restaurant));
+        }
+        parsed.forEachCustomer([this](const Customer& customer) { addCustomer(Customer(customer)); });
+        return applied;
+    }
+    
+    // One page of text search results; see MenuSearch::search
+    MenuSearch::Page searchMenu(string_view query, const MenuSearch::Filter& filter, size_t offset, size_t limit) {
+        auto ratingOf = [this](EntityId id) {
+            const Restaurant* restaurant = store.findRestaurant(id);
+            return restaurant ? restaurant->rating : 0.0;
+        };
+        shared_lock<shared_mutex> lock(catalogLock);
+        return menuSearch.search(query, filter, offset, limit, ratingOf);
+    }
+    
+    EntityId newId() { return ids.next(); }
+    
+    const SlotMap<Restaurant>& allRestaurants() const { return store.allRestaurants(); }
+    uint64_t restaurantRevision() const { return restaurantChanges.load(); }
+    
+    const Restaurant* findRestaurant(EntityId id) { return store.findRestaurant(id); }
+    const OrderAnalytics& salesData() const { return analytics; }
+    
+    // Copies the order out under its shard lock; false if it is unknown
+    bool findOrder(EntityId orderId, Order& out) {
+        OrderShard& shard = shardFor(orderId);
+        lock_guard<mutex> lock(shard.lock);
+        const Order* order = shard.orders.find(orderId);
+        if (!order) return false;
+        out = *order;
+        return true;
+    }
+    
+    // False for an unknown customer; the location may still be unknown
+    bool customerLocation(EntityId customerId, GeoPoint& out) const {
+        return store.readCustomer(customerId, [&out](const Customer* customer) {
+            if (customer) out = customer->location;
+            return customer != nullptr;
+        });
+    }
+    
+    // The menu item an order line points at, or null once it is off the menu
+    const MenuItem* orderedItem(const Order& order, const OrderLine& line) {
+        shared_lock<shared_mutex> lock(catalogLock);
+        const Restaurant* restaurant = store.restaurant(order.restaurant);
+        return restaurant ? restaurant->item(line.item) : nullptr;
+    }
+    
+    // See WriteAheadLog::beginBatch; acknowledgements wait for endBatch(),
+    // which throws LogWriteError if the batch did not become durable
+    void beginBatch() { wal.beginBatch(); }
+    void endBatch() { wal.endBatch(); }
+    
+    // Wall-clock budget the dispatcher thread spends re-optimising courier
+    // routes after each round of changes; zero keeps plain cheapest
+    // insertion, e.g. during bulk ingest
+    void setDispatchBudget(chrono::microseconds budget) { dispatchBudget = budget; }
+    
+    // Routes anything still queued, then spends up to `budget` improving
+    // routes, e.g. while a server is idle
+    void improveDispatch(chrono::microseconds budget) {
+        lock_guard<mutex> lock(dispatchLock);
+        applyQueuedDispatch();
+        dispatcher.improve(budget);
+    }
+    
+    // ---- Interactive menu: prompts on cin, results on cout ----
+    
+    void saveSnapshot() {
+        cout << "\n=== SAVE SNAPSHOT ===\n";
+        if (writeSnapshot()) {
+            cout << "Snapshot saved to " << SNAPSHOT_PATH << "\n";
+        } else {
+            cout << "Failed to write snapshot!\n";
+        }
+    }
+    
+    void addRestaurant() {
         string name, address;
         double rating;
         
-        cout << "\n=== ADD NEW RESTAURANT ===\n";
-        cout << "Enter restaurant name: ";
-        cin.ignore();
-        getline(cin, name);
-        cout << "Enter address: ";
-        getline(cin, address);
-        cout << "Enter rating (0.0-5.0): ";
-        cin >> rating;
+        cout << "\n=== ADD NEW RESTAURANT ===\n";
+        cout << "Enter restaurant name: ";
+        cin.ignore();
+        getline(cin, name);
+        cout << "Enter address: ";
+        getline(cin, address);
+        GeoPoint location = readLocation();
+        cout << "Enter rating (0.0-5.0): ";
+        cin >> rating;
+        
+        Restaurant restaurant(0, name, rating, address);
+        restaurant.location = location;
+        
+        restaurant.addMenuItem(MenuItem("Burger", Money::cents(1299), "Fast Food"));
+        restaurant.addMenuItem(MenuItem("Pizza", Money::cents(1850), "Italian"));
+        restaurant.addMenuItem(MenuItem("Salad", Money::cents(875), "Healthy"));
+        
+        EntityId id = addRestaurant(move(restaurant));
+        cout << "Restaurant added successfully with ID: " << id << "\n";
+    }
+    
+    void addCustomer() {
+        string name, phone, address;
+        
+        cout << "\n=== ADD NEW CUSTOMER ===\n";
+        cout << "Enter customer name: ";
+        cin.ignore();
+        getline(cin, name);
+        cout << "Enter phone number: ";
+        getline(cin, phone);
+        cout << "Enter address: ";
+        getline(cin, address);
+        GeoPoint location = readLocation();
+        
+        Customer customer(0, name, phone, address);
+        customer.location = location;
+        
+        EntityId id = addCustomer(move(customer));
+        cout << "Customer added successfully with ID: " << id << "\n";
+    }
+    
+    void placeOrder() {
+        EntityId customerId, restaurantId;
+        
+        cout << "\n=== PLACE NEW ORDER ===\n";
+        cout << "Enter customer ID: ";
+        if (!readId(customerId)) return;
+        
+        GeoPoint location;
+        if (!customerLocation(customerId, location)) {
+            cout << "Customer not found!\n";
+            return;
+        }
+        
+        displayRestaurants(location);
+        cout << "Enter restaurant ID: ";
+        if (!readId(restaurantId)) return;
+        
+        Restaurant* restaurant = store.findRestaurant(restaurantId);
+        if (!restaurant) {
+            cout << "Restaurant not found!\n";
+            return;
+        }
+        
+        cout << "\n=== MENU ===\n";
+        for (size_t i = 0; i < restaurant->menu.size(); i++) {
+            if (restaurant->menu[i].retired) continue;
+            cout << i + 1 << ". " << restaurant->menu[i].name 
+                 << " - $" << restaurant->menu[i].price << "\n";
+        }
+        
+        vector<uint32_t> items;
+        int choice;
+        do {
+            cout << "Select item (1-" << restaurant->menu.size() << ", 0 to finish): ";
+            cin >> choice;
+            
+            const MenuItem* item = choice > 0 ? restaurant->listedItem(choice - 1) : nullptr;
+            if (item) {
+                items.push_back(choice - 1);
+                cout << "Added " << item->name << " to order\n";
+            }
+        } while (choice != 0);
+        
+        EntityId orderId = placeOrder(customerId, restaurantId, items);
+        Order order;
+        if (orderId && findOrder(orderId, order)) {
+            cout << "Order placed successfully! Order ID: " << orderId << "\n";
+            cout << "Total amount: $" << order.totalAmount << "\n";
+        } else {
+            cout << "No items added to order.\n";
+        }
+    }
+    
+    void updateOrderStatus() {
+        EntityId orderId;
+        int choice;
+        
+        cout << "\n=== UPDATE ORDER STATUS ===\n";
+        cout << "Enter order ID: ";
+        if (!readId(orderId)) return;
+        
+        Order order;
+        if (!findOrder(orderId, order)) {
+            cout << "Order not found!\n";
+            return;
+        }
+        cout << "Current status: " << statusName(order.status) << "\n";
+        for (size_t i = 1; i < ORDER_STATUS_COUNT; i++) {
+            cout << i << ". " << statusName(static_cast<OrderStatus>(i)) << "\n";
+        }
+        cout << "Select new status: ";
+        cin >> choice;
+        if (choice < 1 || choice >= static_cast<int>(ORDER_STATUS_COUNT)) {
+            cout << "Invalid status!\n";
+            return;
+        }
+        
+        OrderStatus next = static_cast<OrderStatus>(choice);
+        switch (setOrderStatus(orderId, next)) {
+            case OrderLifecycle::Result::Ok:
+                cout << "Order " << orderId << " is now " << statusName(next) << "\n";
+                break;
+            case OrderLifecycle::Result::InvalidTransition:
+                cout << "Cannot move order from " << statusName(order.status) << " to "
+                     << statusName(next) << "\n";
+                break;
+            case OrderLifecycle::Result::NotFound:
+                cout << "Order not found!\n";
+                break;
+        }
+    }
+    
+    // Nearest first from `origin` when it is known, ordering restaurants in
+    // the same 100 m band by rating; restaurants without a location follow
+    // in rating order
+    void displayRestaurants(const GeoPoint& origin = GeoPoint()) {
+        cout << "\n=== AVAILABLE RESTAURANTS ===\n";
+        
+        // Sort keys next to a pointer instead of the restaurants themselves
+        struct RankedRestaurant {
+            int64_t band;
+            double rating;
+            double meters;
+            const Restaurant* restaurant;
+            bool operator<(const RankedRestaurant& other) const {
+                if (band != other.band) return band < other.band;
+                return rating > other.rating;
+            }
+        };
+        
+        if (origin.isKnown()) {
+            vector<RankedRestaurant> nearby;
+            for (const auto& n : restaurantLocations.nearest(origin, restaurantLocations.size())) {
+                const Restaurant* restaurant = store.findRestaurant(n.id);
+                nearby.push_back({static_cast<int64_t>(n.meters / 100), restaurant->rating, n.meters, restaurant});
+            }
+            SortingAlgorithms::hybridSort(nearby);
+            for (const auto& entry : nearby) {
+                const Restaurant& restaurant = *entry.restaurant;
+                cout << "ID: " << restaurant.id << " | " << restaurant.name 
+                     << " | Rating: " << restaurant.rating << " | " << entry.meters / 1000 << " km\n";
+            }
+        }
+        
+        vector<RankedRestaurant> restaurantList;
+        restaurantList.reserve(store.restaurantCount());
+        for (const auto& restaurant : store.allRestaurants()) {
+            restaurantList.push_back({0, restaurant.rating, 0, &restaurant});
+        }
+        SortingAlgorithms::hybridSort(restaurantList);
+        
+        for (const auto& entry : restaurantList) {
+            const Restaurant& restaurant = *entry.restaurant;
+            if (origin.isKnown() && restaurant.location.isKnown()) continue;
+            cout << "ID: " << restaurant.id << " | " << restaurant.name 
+                 << " | Rating: " << restaurant.rating << "\n";
+        }
+        cout << "\n";
+    }
+    
+    // Sorts by distance when given a customer with a location
+    void listRestaurants() {
+        string text;
+        EntityId customerId;
+        cout << "Customer ID to sort by distance (0 for rating order): ";
+        cin >> text;
+        GeoPoint location;
+        bool found = parseId(text, customerId) && customerLocation(customerId, location);
+        if (text != "0" && !found) cout << "Customer not found, sorting by rating\n";
+        displayRestaurants(location);
+    }
+    
+    void findNearbyRestaurants() {
+        EntityId customerId;
+        double km;
+        
+        cout << "\n=== NEARBY RESTAURANTS ===\n";
+        cout << "Enter customer ID: ";
+        if (!readId(customerId)) return;
+        GeoPoint location;
+        if (!customerLocation(customerId, location)) {
+            cout << "Customer not found!\n";
+            return;
+        }
+        if (!location.isKnown()) {
+            cout << "Customer has no location on record\n";
+            return;
+        }
+        cout << "Enter delivery radius in km: ";
+        cin >> km;
+        
+        vector<SpatialIndex::Neighbor> within;
+        restaurantLocations.forEachWithin(location, km * 1000,
+                                          [&within](const SpatialIndex::Entry& e, double meters) {
+                                              within.push_back({e.id, meters});
+                                          });
+        sort(within.begin(), within.end(), [](const auto& a, const auto& b) { return a.meters < b.meters; });
+        if (within.empty()) {
+            cout << "No restaurants within " << km << " km; the closest are:\n";
+            within = restaurantLocations.nearest(location, 5);
+        } else {
+            cout << within.size() << " restaurants within " << km << " km:\n";
+        }
+        for (const auto& n : within) {
+            const Restaurant* restaurant = store.findRestaurant(n.id);
+            cout << "ID: " << n.id << " | " << restaurant->name << " | Rating: " << restaurant->rating
+                 << " | " << n.meters / 1000 << " km\n";
+        }
+    }
+    
+    void displayOrders() {
+        cout << "\n=== ORDER STATUS ===\n";
+        
+        auto printOrder = [](const Order& order) {
+            cout << "Order ID: " << order.orderId << " | Status: " << statusName(order.status) 
+                 << " | Amount: $" << order.totalAmount << "\n";
+        };
+        
+        cout << "PENDING ORDERS:\n";
+        forEachActive(printOrder);
+        
+        cout << "\nCOMPLETED ORDERS:\n";
+        forEachCompleted(printOrder);
+        cout << "\n";
+    }
+    
+    void searchMenuItems() {
+        cout << "\n=== MENU SEARCH ===\n";
+        cout << "1. All items by price\n";
+        cout << "2. Items in a price range\n";
+        cout << "3. Cheapest items\n";
+        cout << "4. Search by name or category\n";
+        cout << "5. Suggest search terms\n";
+        cout << "Enter your choice: ";
+        int choice;
+        cin >> choice;
+        
+        auto printEntry = [this](const MenuEntry& entry) {
+            const Restaurant* restaurant = store.findRestaurant(entry.restaurantId);
+            cout << entry.name << " - $" << entry.price << " (" << entry.category << ")"
+                 << " @ " << (restaurant ? restaurant->name : "unknown restaurant") << "\n";
+        };
+        
+        if (choice == 1) {
+            cout << "Menu items sorted by price:\n";
+            menuIndex.forEach(printEntry);
+        } else if (choice == 2) {
+            Money minPrice, maxPrice;
+            cout << "Enter minimum and maximum price: ";
+            cin >> minPrice >> maxPrice;
+            cout << "Items between $" << minPrice << " and $" << maxPrice << ":\n";
+            menuIndex.forEachInRange(minPrice, maxPrice, printEntry);
+        } else if (choice == 3) {
+            size_t count;
+            cout << "How many items: ";
+            cin >> count;
+            cout << "Cheapest " << count << " items:\n";
+            menuIndex.forEachCheapest(count, printEntry);
+        } else if (choice == 4) {
+            searchByText();
+        } else if (choice == 5) {
+            string prefix;
+            cout << "Enter the start of a word: ";
+            cin >> prefix;
+            for (const auto& term : menuSearch.suggest(prefix, 10)) {
+                cout << "  " << term << "\n";
+            }
+        } else {
+            cout << "Invalid choice!\n";
+        }
+    }
+    
+    void searchByText() {
+        const size_t pageSize = 10;
+        string query;
+        MenuSearch::Filter filter;
+        
+        cout << "Enter search text: ";
+        cin.ignore();
+        getline(cin, query);
+        cout << "Enter price range (min max, 0 0 for any): ";
+        Money minPrice, maxPrice;
+        cin >> minPrice >> maxPrice;
+        if (maxPrice > Money()) {
+            filter.minPrice = minPrice;
+            filter.maxPrice = maxPrice;
+        }
+        cout << "Enter minimum restaurant rating (0 for any): ";
+        cin >> filter.minRating;
+        
+        for (size_t offset = 0; ; offset += pageSize) {
+            MenuSearch::Page page = searchMenu(query, filter, offset, pageSize);
+            if (offset == 0 && page.hits.empty()) {
+                cout << "No matching items.\n";
+                return;
+            }
+            for (size_t i = 0; i < page.hits.size(); i++) {
+                const Restaurant* restaurant = store.findRestaurant(page.hits[i].restaurantId);
+                const MenuItem& item = restaurant->menu[page.hits[i].item];
+                cout << (offset + i + 1) << ". " << item.name << " - $" << item.price << " ("
+                     << item.category << ") @ " << restaurant->name << " [" << restaurant->rating << "]\n";
+            }
+            if (!page.hasMore) return;
+            
+            char more;
+            cout << "Show more results? (y/n): ";
+            cin >> more;
+            if (more != 'y' && more != 'Y') return;
+        }
+    }
+    
+    void showOrderHistory() {
+        cout << "\n=== ORDER HISTORY (Stack) ===\n";
+        
+        Stack<EntityId> tempStack;
+        cout << "Recent orders (most recent first):\n";
+        
+        int count = 0;
+        while (!orderHistory.isEmpty() && count < 5) {
+            EntityId orderId = orderHistory.pop();
+            cout << (count + 1) << ". Order ID: " << orderId << "\n";
+            tempStack.push(orderId);
+            count++;
+        }
+        
+        while (!tempStack.isEmpty()) {
+            orderHistory.push(tempStack.pop());
+        }
+    }
+    
+    void showCourierRoutes() {
+        cout << "\n=== COURIER ROUTES ===\n";
+        lock_guard<mutex> lock(dispatchLock);
+        applyQueuedDispatch();
+        if (dispatcher.courierCount() == 0) {
+            cout << "No couriers: restaurants need a location before orders can be dispatched\n";
+            return;
+        }
+        
+        for (uint32_t c = 0; c < dispatcher.courierCount(); c++) {
+            const Courier& courier = dispatcher.courier(c);
+            const auto& route = dispatcher.route(c);
+            cout << "Courier " << courier.id << " (capacity " << courier.capacity << "): ";
+            if (route.empty()) {
+                cout << "idle\n";
+                continue;
+            }
+            for (size_t i = 0; i < route.size(); i++) {
+                const DeliveryJob& job = dispatcher.job(route[i].job);
+                cout << (route[i].pickup ? "pick up " : "deliver ") << job.orderId
+                     << (i + 1 < route.size() ? " -> " : "\n");
+            }
+            cout << "  Combined customer wait: " << static_cast<long>(dispatcher.routeCost(c) / 60)
+                 << " min\n";
+        }
+        cout << dispatcher.jobCount() << " orders in dispatch, " << dispatcher.waitingCount()
+             << " waiting for a courier; orders without restaurant and customer locations are not routed\n";
+    }
+    
+    void salesReport() {
+        cout << "\n=== SALES REPORT ===\n";
+        if (analytics.size() == 0) {
+            cout << "No orders yet.\n";
+            return;
+        }
+        auto byStatus = analytics.countByStatus();
+        cout << analytics.size() << " orders:";
+        for (size_t s = 0; s < ORDER_STATUS_COUNT; s++) {
+            cout << (s ? ", " : " ") << byStatus[s] << " " << statusName(static_cast<OrderStatus>(s));
+        }
+        cout << "\n";
+        
+        auto restaurantName = [this](EntityId id) {
+            const Restaurant* restaurant = store.findRestaurant(id);
+            return restaurant ? restaurant->name : formatId(id);
+        };
+        
+        // Cancelled orders bring in nothing
+        OrderAnalytics::Query query;
+        query.statusMask = ~OrderAnalytics::statusBit(OrderStatus::Cancelled);
+        query.byRestaurant = false;
+        vector<OrderAnalytics::Group> groups;
+        analytics.aggregate(query, groups);
+        if (groups.empty()) {
+            cout << "No revenue yet.\n";
+            return;
+        }
+        const OrderAnalytics::Group& total = groups[0];
+        cout << "Revenue: $" << total.revenue << " from " << total.orders << " orders (median $" << total.p50
+             << ", p90 $" << total.p90 << ", p99 $" << total.p99 << ")\n";
+        
+        query.byRestaurant = true;
+        analytics.aggregate(query, groups);
+        size_t top = min<size_t>(groups.size(), 10);
+        partial_sort(groups.begin(), groups.begin() + top, groups.end(),
+                     [](const auto& a, const auto& b) { return a.revenue > b.revenue; });
+        cout << "\nTop restaurants by revenue:\n";
+        for (size_t i = 0; i < top; i++) {
+            cout << (i + 1) << ". " << restaurantName(groups[i].restaurantId) << ": $" << groups[i].revenue
+                 << " from " << groups[i].orders << " orders (median $" << groups[i].p50 << ")\n";
+        }
+        
+        // Revenue per restaurant per hour over the last day, rolled up
+        // per hour with that hour's best-selling restaurant
+        const int64_t hour = 3600;
+        time_t now = time(nullptr);
+        query.to = now - now % hour + hour;
+        query.from = query.to - 24 * hour;
+        query.bucketSeconds = hour;
+        if (!analytics.aggregate(query, groups)) {
+            cout << "\nToo many restaurants for an hourly breakdown\n";
+            return;
+        }
+        struct Hour {
+            uint64_t orders = 0;
+            Money revenue;
+            const OrderAnalytics::Group* best = nullptr;
+        };
+        vector<Hour> hours(24);
+        for (const auto& group : groups) {
+            Hour& h = hours[(group.bucketStart - query.from) / hour];
+            h.orders += group.orders;
+            h.revenue += group.revenue;
+            if (!h.best || group.revenue > h.best->revenue) h.best = &group;
+        }
+        cout << "\nLast 24 hours:\n";
+        bool any = false;
+        for (size_t i = 0; i < hours.size(); i++) {
+            if (!hours[i].orders) continue;
+            any = true;
+            cout << formatTimestamp(query.from + static_cast<time_t>(i) * hour) << ": " << hours[i].orders
+                 << " orders, $" << hours[i].revenue << " (top: " << restaurantName(hours[i].best->restaurantId)
+                 << " $" << hours[i].best->revenue << ")\n";
+        }
+        if (!any) cout << "No orders in the last 24 hours.\n";
+    }
+    
+    void performanceAnalysis() {
+        cout << "\n=== SYSTEM PERFORMANCE ANALYSIS ===\n";
+        SortingAlgorithms::performanceAnalysis();
+        SearchAlgorithms::demonstrateRouting();
+    }
+    
+    void exportData() {
+        cout << "\n=== DATA EXPORT ===\n";
+        
+        ofstream csvFile("restaurants_export.csv");
+        csvFile << "ID,Name,Rating,Address\n";
+        
+        for (const auto& restaurant : store.allRestaurants()) {
+            csvFile << restaurant.id << "," << restaurant.name << "," 
+                   << restaurant.rating << "," << restaurant.address << "\n";
+        }
+        csvFile.close();
+        
+        cout << "Data exported to restaurants_export.csv\n";
+    }
+    
+    void displayMenu() {
+        cout << "\n=== FOOD DELIVERY SYSTEM ===\n";
+        cout << "1. Add Restaurant\n";
+        cout << "2. Add Customer\n";
+        cout << "3. Place Order\n";
+        cout << "4. Display Restaurants\n";
+        cout << "5. Display Orders\n";
+        cout << "6. Search Menu Items\n";
+        cout << "7. Show Order History\n";
+        cout << "8. Performance Analysis\n";
+        cout << "9. Export Data\n";
+        cout << "10. Save Snapshot\n";
+        cout << "11. Update Order Status\n";
+        cout << "12. Show Courier Routes\n";
+        cout << "13. Find Nearby Restaurants\n";
+        cout << "14. Sales Report\n";
+        cout << "0. Exit\n";
+        cout << "Enter your choice: ";
+    }
+    
+    void run() {
+        int choice;
+        
+        cout << "=== FOOD DELIVERY SYSTEM ===\n";
+        cout << "Air University - Data Structures & Algorithms Project\n\n";
+        
+        do {
+            displayMenu();
+            cin >> choice;
+            
+            switch (choice) {
+                case 1: addRestaurant(); break;
+                case 2: addCustomer(); break;
+                case 3: placeOrder(); break;
+                case 4: listRestaurants(); break;
+                case 5: displayOrders(); break;
+                case 6: searchMenuItems(); break;
+                case 7: showOrderHistory(); break;
+                case 8: performanceAnalysis(); break;
+                case 9: exportData(); break;
+                case 10: saveSnapshot(); break;
+                case 11: updateOrderStatus(); break;
+                case 12: showCourierRoutes(); break;
+                case 13: findNearbyRestaurants(); break;
+                case 14: salesReport(); break;
+                case 0: cout << "Exiting...\n"; break;
+                default: cout << "Invalid choice!\n";
+            }
+            
+            if (choice != 0) {
+                cout << "\nPress Enter to continue...";
+                cin.ignore();
+                cin.get();
+            }
+            
+        } while (choice != 0);
+        
+        cout << "Thank you for using Food Delivery System!\n";
+    }
+};
+
+// Runs a stream of commands against the FoodDeliverySystem API, one per
+// line. Fields are separated by spaces or tabs, a field with spaces goes in
+// double quotes, and lines starting with '#' are comments.
+//
+//   ADD_RESTAURANT <id|-> <name> <rating> <address> [<lat> <lon>]
+//   MENU_ITEM <name> <price> <category>     appends to the restaurant above
+//   ADD_CUSTOMER <id|-> <name> <phone> <address> [<lat> <lon>]
+//   PLACE_ORDER <customer id> <restaurant id> <item number>...
+//   SET_STATUS <order id> <status>
+//   SNAPSHOT
+//   IMPORT                                  applies restaurants.dat and customers.txt
+//
+// Each command gets one answer line in order: "OK [id...]" or
+// "ERR <line>: <reason>". Answers are buffered and written in chunks, and
+// each chunk waits for the single WAL group commit covering its commands;
+// if that commit fails, every answer in the chunk becomes an ERR. Nothing
+// else is written to the answer stream; load messages and the closing
+// summary go to stderr.
+class CommandBatch {
+private:
+    static constexpr size_t CHUNK_COMMANDS = 4096;
+    static constexpr size_t CHUNK_BYTES = 1 << 16;
+    static constexpr size_t READ_BYTES = 1 << 20;
+    
+    FoodDeliverySystem& system;
+    FILE* out;
+    string output;
+    vector<size_t> answered;    // line number of each answer in `output`
+    size_t succeeded = 0;       // OK answers in `output`
+    vector<string_view> fields;
+    vector<uint32_t> items;
+    
+    // A restaurant is committed once the MENU_ITEM lines after it end
+    Restaurant pending;
+    bool hasPending = false;
+    
+    size_t lineNumber = 0;
+    size_t sinceFlush = 0;
+    size_t commands = 0;
+    size_t failures = 0;
+    
+    // False on an unterminated quote
+    static bool split(string_view line, vector<string_view>& fields) {
+        fields.clear();
+        size_t i = 0;
+        while (true) {
+            while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) i++;
+            if (i == line.size()) return true;
+            if (line[i] == '"') {
+                size_t close = line.find('"', i + 1);
+                if (close == string_view::npos) return false;
+                fields.push_back(line.substr(i + 1, close - i - 1));
+                i = close + 1;
+            } else {
+                size_t end = i;
+                while (end < line.size() && line[end] != ' ' && line[end] != '\t') end++;
+                fields.push_back(line.substr(i, end - i));
+                i = end;
+            }
+        }
+    }
+    
+    void fail(const char* reason) {
+        output += "ERR ";
+        output += to_string(lineNumber);
+        output += ": ";
+        output += reason;
+        output += '\n';
+        answered.push_back(lineNumber);
+        failures++;
+    }
+    
+    void ok(EntityId id = 0) {
+        char text[24];
+        answered.push_back(lineNumber);
+        succeeded++;
+        output += "OK";
+        if (id) {
+            output += ' ';
+            output.append(text, to_chars(text, text + sizeof(text), id).ptr - text);
+        }
+        output += '\n';
+    }
+    
+    // "-" asks for a fresh id
+    bool idField(string_view text, EntityId& id) {
+        if (text == "-") {
+            id = system.newId();
+            return true;
+        }
+        return parseId(text, id);
+    }
+    
+    // Optional trailing latitude and longitude starting at fields[first]
+    bool locationFields(size_t first, GeoPoint& location) const {
+        location = GeoPoint();
+        if (fields.size() == first) return true;
+        double latitude, longitude;
+        if (fields.size() != first + 2 || !parseNumber(fields[first], latitude) ||
+            !parseNumber(fields[first + 1], longitude) || fabs(latitude) > 90 || fabs(longitude) > 180) {
+            return false;
+        }
+        location = GeoPoint(latitude, longitude);
+        return true;
+    }
+    
+    void commitPending() {
+        if (!hasPending) return;
+        system.addRestaurant(move(pending));
+        hasPending = false;
+    }
+    
+    // Ends the current batch and writes its answers; `more` opens the next
+    void flush(bool more = true) {
+        try {
+            system.endBatch();
+        } catch (const LogWriteError& e) {
+            cerr << e.what() << "\n";
+            output.clear();
+            for (size_t line : answered) {
+                output += "ERR ";
+                output += to_string(line);
+                output += ": not durable, log write failed\n";
+            }
+            failures += succeeded;
+        }
+        fwrite(output.data(), 1, output.size(), out);
+        output.clear();
+        answered.clear();
+        succeeded = 0;
+        sinceFlush = 0;
+        if (more) system.beginBatch();
+    }
+    
+    void execute(string_view line) {
+        lineNumber++;
+        if (!split(line, fields)) {
+            commitPending();
+            fail("unterminated quote");
+            return;
+        }
+        if (fields.empty() || fields[0][0] == '#') return;
+        commands++;
+        sinceFlush++;
+        string_view command = fields[0];
+        
+        if (command == "MENU_ITEM") {
+            Money price;
+            if (!hasPending) {
+                fail("MENU_ITEM must follow ADD_RESTAURANT");
+            } else if (fields.size() != 4 || !Money::parse(fields[2], price) || price < Money()) {
+                fail("expected MENU_ITEM <name> <price> <category>");
+            } else {
+                pending.addMenuItem(MenuItem(fields[1], price, fields[3]));
+                ok();
+            }
+            return;
+        }
+        commitPending();
+        
+        if (command == "ADD_RESTAURANT") {
+            EntityId id;
+            double rating;
+            GeoPoint location;
+            if (fields.size() < 5 || !idField(fields[1], id) || !parseNumber(fields[3], rating) ||
+                !locationFields(5, location)) {
+                fail("expected ADD_RESTAURANT <id|-> <name> <rating> <address> [<lat> <lon>]");
+                return;
+            }
+            pending = Restaurant(id, string(fields[2]), rating, string(fields[4]));
+            pending.location = location;
+            hasPending = true;
+            ok(id);
+        } else if (command == "ADD_CUSTOMER") {
+            EntityId id;
+            GeoPoint location;
+            if (fields.size() < 5 || !idField(fields[1], id) || !locationFields(5, location)) {
+                fail("expected ADD_CUSTOMER <id|-> <name> <phone> <address> [<lat> <lon>]");
+                return;
+            }
+            Customer customer(id, string(fields[2]), string(fields[3]), string(fields[4]));
+            customer.location = location;
+            ok(system.addCustomer(move(customer)));
+        } else if (command == "PLACE_ORDER") {
+            EntityId customerId, restaurantId;
+            if (fields.size() < 4 || !parseId(fields[1], customerId) || !parseId(fields[2], restaurantId)) {
+                fail("expected PLACE_ORDER <customer id> <restaurant id> <item number>...");
+                return;
+            }
+            items.clear();
+            for (size_t i = 3; i < fields.size(); i++) {
+                uint64_t number;
+                if (!parseUnsigned(fields[i], number) || number == 0 || number > UINT32_MAX) {
+                    fail("item numbers start at 1");
+                    return;
+                }
+                items.push_back(static_cast<uint32_t>(number - 1));
+            }
+            EntityId orderId = system.placeOrder(customerId, restaurantId, items);
+            if (orderId) {
+                ok(orderId);
+            } else {
+                fail("unknown customer or restaurant, or no valid items");
+            }
+        } else if (command == "SET_STATUS") {
+            EntityId orderId;
+            OrderStatus status;
+            if (fields.size() != 3 || !parseId(fields[1], orderId) || !parseStatus(fields[2], status)) {
+                fail("expected SET_STATUS <order id> <status>");
+                return;
+            }
+            switch (system.setOrderStatus(orderId, status)) {
+                case OrderLifecycle::Result::Ok: ok(); break;
+                case OrderLifecycle::Result::NotFound: fail("order not found"); break;
+                case OrderLifecycle::Result::InvalidTransition: fail("invalid status transition"); break;
+            }
+        } else if (command == "SNAPSHOT") {
+            if (system.writeSnapshot()) {
+                ok();
+            } else {
+                fail("snapshot failed");
+            }
+        } else if (command == "IMPORT") {
+            cerr << "Imported " << system.importTextFiles() << " records from the text files\n";
+            ok();
+        } else {
+            fail("unknown command");
+        }
+        
+        // A restaurant's OK is only durable once its MENU_ITEM lines end
+        if (!hasPending && (sinceFlush >= CHUNK_COMMANDS || output.size() >= CHUNK_BYTES)) flush();
+    }
+    
+public:
+    CommandBatch(FoodDeliverySystem& target, FILE* answers) : system(target), out(answers) {}
+    
+    // Executes everything `in` holds and returns the number of commands
+    size_t run(FILE* in) {
+        auto start = chrono::steady_clock::now();
+        system.beginBatch();
+        vector<char> chunk(READ_BYTES);
+        string carry;
+        size_t got;
+        while ((got = fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+            string_view data(chunk.data(), got);
+            // Complete the line split across the previous read
+            if (!carry.empty()) {
+                size_t newline = data.find('\n');
+                if (newline == string_view::npos) {
+                    carry.append(data);
+                    continue;
+                }
+                carry.append(data.substr(0, newline));
+                data.remove_prefix(newline + 1);
+                string_view line = carry;
+                execute(nextLine(line));
+                carry.clear();
+            }
+            size_t lastNewline = data.rfind('\n');
+            string_view complete = lastNewline == string_view::npos ? string_view() : data.substr(0, lastNewline + 1);
+            carry.assign(data.substr(complete.size()));
+            while (!complete.empty()) execute(nextLine(complete));
+        }
+        if (!carry.empty()) {
+            string_view line = carry;
+            execute(nextLine(line));
+        }
+        commitPending();
+        flush(false);
+        fflush(out);
+        
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cerr << commands << " commands (" << failures << " failed) in " << seconds << " s, "
+             << static_cast<uint64_t>(commands / max(seconds, 1e-9)) << " commands/s\n";
+        return commands;
+    }
+};
+
+// ======================= ORDER SERVER =======================
+
+#ifdef FDS_HAVE_EPOLL
+
+// HTTP/1.1 front end for the FoodDeliverySystem API, one epoll thread on
+// localhost.
+//
+//   GET  /restaurants                  every restaurant with its menu, best rated first
+//   GET  /menu/search?q=<text>[&category=&min_price=&max_price=&min_rating=&offset=&limit=]
+//   GET  /orders/<id>
+//   POST /customers                    name, phone, address[, lat, lon]
+//   POST /orders                       customer, restaurant, items (item numbers from 1, comma-separated)
+//   POST /orders/<id>/status           status
+//
+// Parameters are form-encoded in the body or the query string; responses
+// are JSON, with ids as strings since they exceed 2^53. Connections stay
+// open unless the client asks otherwise, and pipelined requests are
+// answered in order.
+//
+// Each loop iteration handles every ready connection inside one WAL batch,
+// so their writes share a single group commit, and only then sends the
+// answers: nothing is acknowledged before it is durable. Responses are
+// built in place in the connection's output buffer (the Content-Length is
+// filled in afterwards), and the restaurant listing is rendered once per
+// change and sent from that shared copy with writev.
+class OrderServer {
+private:
+    static constexpr size_t MAX_HEADER_BYTES = 16 * 1024;
+    static constexpr size_t MAX_BODY_BYTES = 1 << 20;
+    static constexpr size_t READ_BYTES = 64 * 1024;
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr int IDLE_MS = 10;
+    static constexpr chrono::microseconds IDLE_DISPATCH_BUDGET{2000};
+    static constexpr size_t LENGTH_DIGITS = 10;
+    static constexpr size_t DEFAULT_PAGE = 20;
+    static constexpr size_t MAX_PAGE = 100;
+    
+    struct Request {
+        string_view method;
+        string_view path;
+        string_view query;
+        string_view body;
+        bool keepAlive = false;
+    };
+    
+    enum class Parse {
+        Complete,
+        Incomplete,
+        Invalid,
+        TooLarge
+    };
+    
+    // A range of the connection's own output buffer, or of a shared body
+    struct Segment {
+        shared_ptr<const string> shared;
+        size_t offset;
+        size_t length;
+    };
+    
+    struct Connection {
+        int fd = -1;
+        string in;
+        string out;
+        size_t sealed = 0;          // out[0, sealed) is already queued in `pending`
+        deque<Segment> pending;
+        uint32_t watched = 0;       // epoll events currently registered
+        bool closeAfterWrite = false;
+        bool peerClosed = false;
+        bool failed = false;
+        size_t batchStart = 0;      // out.size() and pending.size() before this
+        size_t batchPending = 0;    // loop iteration's requests were handled
+    };
+    
+    FoodDeliverySystem& system;
+    int listenFd = -1;
+    int epollFd = -1;
+    uint16_t boundPort = 0;
+    atomic<bool> stopping{false};
+    inline static atomic<bool> interrupted{false};
+    
+    vector<unique_ptr<Connection>> connections;    // indexed by fd
+    vector<int> touched;
+    vector<char> readBuffer;
+    string value;                                   // scratch for decoded parameters
+    
+    shared_ptr<const string> listing;
+    uint64_t listingRevision = 0;
+    
+    // ---- Parsing ----
+    
+    static bool equalsIgnoreCase(string_view a, string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+        }
+        return true;
+    }
+    
+    static string_view trim(string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+        return text;
+    }
+    
+    // Parses the request at the front of `data`; on Complete, `length` is its size
+    static Parse parseRequest(string_view data, Request& request, size_t& length) {
+        size_t headerEnd = data.find("\r\n\r\n");
+        if (headerEnd == string_view::npos) {
+            return data.size() > MAX_HEADER_BYTES ? Parse::TooLarge : Parse::Incomplete;
+        }
+        string_view head = data.substr(0, headerEnd);
+        string_view requestLine = nextLine(head);
+        size_t firstSpace = requestLine.find(' ');
+        size_t lastSpace = requestLine.rfind(' ');
+        if (firstSpace == string_view::npos || firstSpace == lastSpace) return Parse::Invalid;
+        
+        string_view version = requestLine.substr(lastSpace + 1);
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") return Parse::Invalid;
+        string_view target = requestLine.substr(firstSpace + 1, lastSpace - firstSpace - 1);
+        size_t question = target.find('?');
+        request.method = requestLine.substr(0, firstSpace);
+        request.path = target.substr(0, question);
+        request.query = question == string_view::npos ? string_view() : target.substr(question + 1);
+        request.keepAlive = version == "HTTP/1.1";
+        
+        uint64_t contentLength = 0;
+        while (!head.empty()) {
+            string_view line = nextLine(head);
+            size_t colon = line.find(':');
+            if (colon == string_view::npos) return Parse::Invalid;
+            string_view name = line.substr(0, colon);
+            string_view field = trim(line.substr(colon + 1));
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                if (!parseUnsigned(field, contentLength)) return Parse::Invalid;
+                if (contentLength > MAX_BODY_BYTES) return Parse::TooLarge;
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                if (equalsIgnoreCase(field, "close")) request.keepAlive = false;
+                if (equalsIgnoreCase(field, "keep-alive")) request.keepAlive = true;
+            } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                // Chunked request bodies are not supported
+                return Parse::Invalid;
+            }
+        }
+        
+        size_t total = headerEnd + 4 + contentLength;
+        if (data.size() < total) return Parse::Incomplete;
+        request.body = data.substr(headerEnd + 4, contentLength);
+        length = total;
+        return Parse::Complete;
+    }
+    
+    // Percent-decoded value of `name` in a form-encoded string ("a=1&b=x+y")
+    static bool formValue(string_view form, string_view name, string& out) {
+        while (!form.empty()) {
+            size_t amp = form.find('&');
+            string_view pair = form.substr(0, amp);
+            form = amp == string_view::npos ? string_view() : form.substr(amp + 1);
+            size_t equals = pair.find('=');
+            if (pair.substr(0, equals) != name) continue;
+            
+            string_view raw = equals == string_view::npos ? string_view() : pair.substr(equals + 1);
+            out.clear();
+            for (size_t i = 0; i < raw.size(); i++) {
+                unsigned byte = 0;
+                if (raw[i] == '+') {
+                    out += ' ';
+                } else if (raw[i] == '%' && i + 2 < raw.size() &&
+                           from_chars(raw.data() + i + 1, raw.data() + i + 3, byte, 16).ptr == raw.data() + i + 3) {
+                    out += static_cast<char>(byte);
+                    i += 2;
+                } else {
+                    out += raw[i];
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+    
+    // Looks in the body first, then the query string; the result lands in `value`
+    bool param(const Request& request, string_view name) {
+        return formValue(request.body, name, value) || formValue(request.query, name, value);
+    }
+    
+    // ---- Response building ----
+    
+    static void appendJsonString(string& out, string_view text) {
+        out += '"';
+        for (char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+    
+    template<typename T>
+    static void appendNumber(string& out, T number) {
+        char text[32];
+        out.append(text, to_chars(text, text + sizeof(text), number).ptr - text);
+    }
+    
+    static void appendNumber(string& out, Money amount) {
+        char text[24];
+        out.append(text, amount.format(text, text + sizeof(text)) - text);
+    }
+    
+    static void appendId(string& out, EntityId id) {
+        out += '"';
+        appendNumber(out, id);
+        out += '"';
+    }
+    
+    static void appendMenuItem(string& out, const MenuItem& item) {
+        out += "\"name\":";
+        appendJsonString(out, item.name.text());
+        out += ",\"price\":";
+        appendNumber(out, item.price);
+        out += ",\"category\":";
+        appendJsonString(out, item.category.text());
+    }
+    
+    static void appendRestaurant(string& out, const Restaurant& restaurant) {
+        out += "{\"id\":";
+        appendId(out, restaurant.id);
+        out += ",\"name\":";
+        appendJsonString(out, restaurant.name);
+        out += ",\"rating\":";
+        appendNumber(out, restaurant.rating);
+        out += ",\"address\":";
+        appendJsonString(out, restaurant.address);
+        out += ",\"location\":";
+        if (restaurant.location.isKnown()) {
+            out += '[';
+            appendNumber(out, restaurant.location.latitude);
+            out += ',';
+            appendNumber(out, restaurant.location.longitude);
+            out += ']';
+        } else {
+            out += "null";
+        }
+        out += ",\"menu\":[";
+        bool first = true;
+        for (size_t i = 0; i < restaurant.menu.size(); i++) {
+            if (restaurant.menu[i].retired) continue;
+            out += first ? "{\"item\":" : ",{\"item\":";
+            first = false;
+            appendNumber(out, i + 1);
+            out += ',';
+            appendMenuItem(out, restaurant.menu[i]);
+            out += '}';
+        }
+        out += "]}";
+    }
+    
+    static const char* reasonPhrase(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 201: return "Created";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 409: return "Conflict";
+            case 413: return "Payload Too Large";
+            case 422: return "Unprocessable Entity";
+            case 503: return "Service Unavailable";
+            default: return "Internal Server Error";
+        }
+    }
+    
+    // Writes the status line and headers with a blank Content-Length that
+    // finishResponse() fills in; returns where that field starts
+    static size_t startResponse(string& out, int status, bool keepAlive) {
+        out += "HTTP/1.1 ";
+        appendNumber(out, status);
+        out += ' ';
+        out += reasonPhrase(status);
+        out += keepAlive ? "\r\nConnection: keep-alive" : "\r\nConnection: close";
+        out += "\r\nContent-Type: application/json\r\nContent-Length: ";
+        size_t lengthAt = out.size();
+        // Digits are written left-aligned; the trailing blanks are optional whitespace
+        out.append(LENGTH_DIGITS, ' ');
+        out += "\r\n\r\n";
+        return lengthAt;
+    }
+    
+    static void setContentLength(string& out, size_t lengthAt, size_t bodyLength) {
+        to_chars(&out[lengthAt], &out[lengthAt] + LENGTH_DIGITS, bodyLength);
+    }
+    
+    static void finishResponse(string& out, size_t lengthAt) {
+        setContentLength(out, lengthAt, out.size() - (lengthAt + LENGTH_DIGITS + 4));
+    }
+    
+    static void respondError(Connection& c, const Request& request, int status, const char* message) {
+        size_t lengthAt = startResponse(c.out, status, request.keepAlive);
+        c.out += "{\"error\":";
+        appendJsonString(c.out, message);
+        c.out += '}';
+        finishResponse(c.out, lengthAt);
+    }
+    
+    // Queues the unsent tail of `out` ahead of any segment added next
+    static void sealOutput(Connection& c) {
+        if (c.out.size() > c.sealed) {
+            c.pending.push_back({nullptr, c.sealed, c.out.size() - c.sealed});
+            c.sealed = c.out.size();
+        }
+    }
+    
+    // Replaces the answers of a batch that did not become durable with a
+    // 503 and closes the connection, so none of them is acknowledged
+    static void retractBatch(Connection& c) {
+        if (c.out.size() == c.batchStart && c.pending.size() == c.batchPending) return;
+        c.out.resize(c.batchStart);
+        c.sealed = c.batchStart;
+        c.pending.resize(c.batchPending);
+        size_t lengthAt = startResponse(c.out, 503, false);
+        c.out += "{\"error\":\"log write failed\"}";
+        finishResponse(c.out, lengthAt);
+        c.closeAfterWrite = true;
+    }
+    
+    // ---- Endpoints ----
+    
+    void renderListing() {
+        vector<const Restaurant*> ranked;
+        for (const auto& restaurant : system.allRestaurants()) ranked.push_back(&restaurant);
+        SortingAlgorithms::hybridSort(ranked, [](const Restaurant* a, const Restaurant* b) {
+            return a->rating > b->rating;
+        });
+        auto body = make_shared<string>("[");
+        for (size_t i = 0; i < ranked.size(); i++) {
+            if (i) *body += ',';
+            appendRestaurant(*body, *ranked[i]);
+        }
+        *body += ']';
+        listing = move(body);
+        listingRevision = system.restaurantRevision();
+    }
+    
+    void listRestaurants(Connection& c, const Request& request) {
+        if (!listing || listingRevision != system.restaurantRevision()) renderListing();
+        size_t lengthAt = startResponse(c.out, 200, request.keepAlive);
+        setContentLength(c.out, lengthAt, listing->size());
+        sealOutput(c);
+        c.pending.push_back({listing, 0, listing->size()});
+    }
+    
+    void searchMenu(Connection& c, const Request& request) {
+        if (!param(request, "q")) return respondError(c, request, 400, "missing q");
+        string query = value;
+        
+        MenuSearch::Filter filter;
+        uint64_t offset = 0, limit = DEFAULT_PAGE;
+        if ((param(request, "min_price") && !Money::parse(value, filter.minPrice)) ||
+            (param(request, "max_price") && !Money::parse(value, filter.maxPrice)) ||
+            (param(request, "min_rating") && !parseNumber(value, filter.minRating)) ||
+            (param(request, "offset") && !parseUnsigned(value, offset)) ||
+            (param(request, "limit") && !parseUnsigned(value, limit))) {
+            return respondError(c, request, 400, "malformed filter");
+        }
+        // Categories are looked up, not interned, so arbitrary input cannot grow the pool
+        bool unknownCategory = param(request, "category") && !value.empty() && !Symbol::find(value, filter.category);
+        
+        MenuSearch::Page page;
+        if (!unknownCategory) page = system.searchMenu(query, filter, offset, min<uint64_t>(limit, MAX_PAGE));
+        size_t lengthAt = startResponse(c.out, 200, request.keepAlive);
+        c.out += "{\"hits\":[";
+        for (size_t i = 0; i < page.hits.size(); i++) {
+            const Restaurant* restaurant = system.findRestaurant(page.hits[i].restaurantId);
+            c.out += i ? ",{\"restaurant_id\":" : "{\"restaurant_id\":";
+            appendId(c.out, restaurant->id);
+            c.out += ",\"restaurant\":";
+            appendJsonString(c.out, restaurant->name);
+            c.out += ",\"rating\":";
+            appendNumber(c.out, restaurant->rating);
+            c.out += ",\"item\":";
+            appendNumber(c.out, page.hits[i].item + 1);
+            c.out += ',';
+            appendMenuItem(c.out, restaurant->menu[page.hits[i].item]);
+            c.out += '}';
+        }
+        c.out += page.hasMore ? "],\"has_more\":true}" : "],\"has_more\":false}";
+        finishResponse(c.out, lengthAt);
+    }
+    
+    void showOrder(Connection& c, const Request& request, EntityId orderId) {
+        Order order;
+        if (!system.findOrder(orderId, order)) return respondError(c, request, 404, "order not found");
+        size_t lengthAt = startResponse(c.out, 200, request.keepAlive);
+        c.out += "{\"id\":";
+        appendId(c.out, order.orderId);
+        c.out += ",\"customer_id\":";
+        appendId(c.out, order.customerId);
+        c.out += ",\"restaurant_id\":";
+        appendId(c.out, order.restaurantId);
+        c.out += ",\"status\":";
+        appendJsonString(c.out, statusName(order.status));
+        c.out += ",\"timestamp\":";
+        appendJsonString(c.out, order.timestamp());
+        c.out += ",\"total\":";
+        appendNumber(c.out, order.totalAmount);
+        c.out += ",\"items\":[";
+        for (size_t i = 0; i < order.lines.size(); i++) {
+            // The price is what was charged, even if the menu has changed since
+            const OrderLine& line = order.lines[i];
+            c.out += i ? ",{" : "{";
+            if (const MenuItem* item = system.orderedItem(order, line)) {
+                c.out += "\"name\":";
+                appendJsonString(c.out, item->name.text());
+                c.out += ",\"category\":";
+                appendJsonString(c.out, item->category.text());
+                c.out += ',';
+            }
+            c.out += "\"price\":";
+            appendNumber(c.out, line.price);
+            c.out += '}';
+        }
+        c.out += "]}";
+        finishResponse(c.out, lengthAt);
+    }
+    
+    void addCustomer(Connection& c, const Request& request) {
+        Customer customer;
+        if (!param(request, "name")) return respondError(c, request, 422, "missing name");
+        customer.name = value;
+        if (!param(request, "phone")) return respondError(c, request, 422, "missing phone");
+        customer.phone = value;
+        if (!param(request, "address")) return respondError(c, request, 422, "missing address");
+        customer.address = value;
+        
+        double latitude, longitude;
+        bool hasLatitude = param(request, "lat") && parseNumber(value, latitude);
+        bool hasLongitude = param(request, "lon") && parseNumber(value, longitude);
+        if (hasLatitude && hasLongitude && fabs(latitude) <= 90 && fabs(longitude) <= 180) {
+            customer.location = GeoPoint(latitude, longitude);
+        }
+        
+        EntityId id = system.addCustomer(move(customer));
+        size_t lengthAt = startResponse(c.out, 201, request.keepAlive);
+        c.out += "{\"id\":";
+        appendId(c.out, id);
+        c.out += '}';
+        finishResponse(c.out, lengthAt);
+    }
+    
+    void placeOrder(Connection& c, const Request& request) {
+        EntityId customerId, restaurantId;
+        if (!param(request, "customer") || !parseId(value, customerId) ||
+            !param(request, "restaurant") || !parseId(value, restaurantId) || !param(request, "items")) {
+            return respondError(c, request, 422, "expected customer, restaurant and items");
+        }
+        vector<uint32_t> items;
+        string_view list = value;
+        while (!list.empty()) {
+            size_t comma = list.find(',');
+            uint64_t number;
+            if (!parseUnsigned(list.substr(0, comma), number) || number == 0 || number > UINT32_MAX) {
+                return respondError(c, request, 422, "item numbers start at 1");
+            }
+            items.push_back(static_cast<uint32_t>(number - 1));
+            list = comma == string_view::npos ? string_view() : list.substr(comma + 1);
+        }
+        
+        EntityId orderId = system.placeOrder(customerId, restaurantId, items);
+        Order order;
+        if (!orderId || !system.findOrder(orderId, order)) {
+            return respondError(c, request, 422, "unknown customer or restaurant, or no valid items");
+        }
+        size_t lengthAt = startResponse(c.out, 201, request.keepAlive);
+        c.out += "{\"id\":";
+        appendId(c.out, orderId);
+        c.out += ",\"total\":";
+        appendNumber(c.out, order.totalAmount);
+        c.out += '}';
+        finishResponse(c.out, lengthAt);
+    }
+    
+    void setStatus(Connection& c, const Request& request, EntityId orderId) {
+        OrderStatus status;
+        if (!param(request, "status") || !parseStatus(value, status)) {
+            return respondError(c, request, 422, "unknown status");
+        }
+        switch (system.setOrderStatus(orderId, status)) {
+            case OrderLifecycle::Result::NotFound: return respondError(c, request, 404, "order not found");
+            case OrderLifecycle::Result::InvalidTransition: return respondError(c, request, 409, "invalid status transition");
+            case OrderLifecycle::Result::Ok: break;
+        }
+        size_t lengthAt = startResponse(c.out, 200, request.keepAlive);
+        c.out += "{\"id\":";
+        appendId(c.out, orderId);
+        c.out += ",\"status\":";
+        appendJsonString(c.out, statusName(status));
+        c.out += '}';
+        finishResponse(c.out, lengthAt);
+    }
+    
+    void route(Connection& c, const Request& request) {
+        string_view path = request.path;
+        bool get = request.method == "GET";
+        bool post = request.method == "POST";
+        
+        if (path == "/restaurants") {
+            if (!get) return respondError(c, request, 405, "use GET");
+            listRestaurants(c, request);
+        } else if (path == "/menu/search") {
+            if (!get) return respondError(c, request, 405, "use GET");
+            searchMenu(c, request);
+        } else if (path == "/customers") {
+            if (!post) return respondError(c, request, 405, "use POST");
+            addCustomer(c, request);
+        } else if (path == "/orders") {
+            if (!post) return respondError(c, request, 405, "use POST");
+            placeOrder(c, request);
+        } else if (path.substr(0, 8) == "/orders/") {
+            string_view rest = path.substr(8);
+            size_t slash = rest.find('/');
+            EntityId orderId;
+            if (!parseId(rest.substr(0, slash), orderId)) return respondError(c, request, 404, "no such resource");
+            if (slash == string_view::npos) {
+                if (!get) return respondError(c, request, 405, "use GET");
+                showOrder(c, request, orderId);
+            } else if (rest.substr(slash) == "/status") {
+                if (!post) return respondError(c, request, 405, "use POST");
+                setStatus(c, request, orderId);
+            } else {
+                respondError(c, request, 404, "no such resource");
+            }
+        } else {
+            respondError(c, request, 404, "no such resource");
+        }
+    }
+    
+    // ---- Connections ----
+    
+    // Answers every complete request buffered on the connection, in order
+    void processInput(Connection& c) {
+        size_t consumed = 0;
+        while (consumed < c.in.size() && !c.closeAfterWrite) {
+            Request request;
+            size_t length = 0;
+            Parse result = parseRequest(string_view(c.in).substr(consumed), request, length);
+            if (result == Parse::Incomplete) break;
+            if (result != Parse::Complete) {
+                request.keepAlive = false;
+                respondError(c, request, result == Parse::TooLarge ? 413 : 400, "malformed request");
+                c.closeAfterWrite = true;
+                break;
+            }
+            route(c, request);
+            consumed += length;
+            if (!request.keepAlive) c.closeAfterWrite = true;
+        }
+        c.in.erase(0, consumed);
+    }
+    
+    // False once the connection has failed; sets peerClosed at end of stream
+    bool readInput(Connection& c) {
+        while (true) {
+            ssize_t n = ::read(c.fd, readBuffer.data(), readBuffer.size());
+            if (n > 0) {
+                c.in.append(readBuffer.data(), n);
+                if (static_cast<size_t>(n) < readBuffer.size()) return true;
+            } else if (n == 0) {
+                c.peerClosed = true;
+                return true;
+            } else if (errno != EINTR) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+        }
+    }
+    
+    void watch(Connection& c) {
+        uint32_t wanted = 0;
+        if (!c.peerClosed) wanted |= EPOLLIN | EPOLLRDHUP;
+        if (!c.pending.empty()) wanted |= EPOLLOUT;
+        if (wanted == c.watched) return;
+        epoll_event event{};
+        event.events = wanted;
+        event.data.fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &event);
+        c.watched = wanted;
+    }
+    
+    // Sends as much queued output as the socket takes; false on a write error
+    bool flushOutput(Connection& c) {
+        sealOutput(c);
+        while (!c.pending.empty()) {
+            iovec vectors[64];
+            int count = 0;
+            for (const Segment& segment : c.pending) {
+                if (count == 64) break;
+                const string& source = segment.shared ? *segment.shared : c.out;
+                vectors[count].iov_base = const_cast<char*>(source.data() + segment.offset);
+                vectors[count].iov_len = segment.length;
+                count++;
+            }
+            ssize_t n = ::writev(c.fd, vectors, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                return false;
+            }
+            for (size_t sent = n; sent > 0;) {
+                Segment& front = c.pending.front();
+                size_t step = min(sent, front.length);
+                front.offset += step;
+                front.length -= step;
+                sent -= step;
+                if (front.length == 0) c.pending.pop_front();
+            }
+        }
+        if (c.pending.empty()) {
+            c.out.clear();
+            c.sealed = 0;
+        }
+        watch(c);
+        return true;
+    }
+    
+    void acceptConnections() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connections.size() <= static_cast<size_t>(fd)) connections.resize(fd + 1);
+            connections[fd] = make_unique<Connection>();
+            Connection& c = *connections[fd];
+            c.fd = fd;
+            c.watched = EPOLLIN | EPOLLRDHUP;
+            epoll_event event{};
+            event.events = c.watched;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+    
+    void closeConnection(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections[fd].reset();
+    }
+    
+public:
+    explicit OrderServer(FoodDeliverySystem& target) : system(target), readBuffer(READ_BYTES) {}
+    
+    ~OrderServer() {
+        for (auto& c : connections) {
+            if (c) ::close(c->fd);
+        }
+        if (listenFd >= 0) ::close(listenFd);
+        if (epollFd >= 0) ::close(epollFd);
+    }
+    
+    OrderServer(const OrderServer&) = delete;
+    OrderServer& operator=(const OrderServer&) = delete;
+    
+    // Binds 127.0.0.1:port (0 picks a free port, see port()); false with a
+    // message on failure
+    bool listen(uint16_t port) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (listenFd < 0 || epollFd < 0) {
+            cerr << "Cannot create server socket: " << strerror(errno) << "\n";
+            return false;
+        }
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        socklen_t length = sizeof(address);
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, SOMAXCONN) != 0 ||
+            getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            cerr << "Cannot listen on port " << port << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        boundPort = ntohs(address.sin_port);
+        
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+        return true;
+    }
+    
+    uint16_t port() const { return boundPort; }
+    
+    // Serves until stop() or interrupt(); courier routes are improved
+    // whenever the loop is idle
+    void run() {
+        signal(SIGPIPE, SIG_IGN);
+        epoll_event events[MAX_EVENTS];
+        while (!stopping.load(memory_order_relaxed) && !interrupted.load(memory_order_relaxed)) {
+            int ready = epoll_wait(epollFd, events, MAX_EVENTS, IDLE_MS);
+            if (ready < 0 && errno != EINTR) {
+                cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+                return;
+            }
+            if (ready <= 0) {
+                system.improveDispatch(IDLE_DISPATCH_BUDGET);
+                continue;
+            }
+            
+            system.beginBatch();
+            for (int i = 0; i < ready; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptConnections();
+                    continue;
+                }
+                Connection& c = *connections[fd];
+                c.batchStart = c.out.size();
+                c.batchPending = c.pending.size();
+                if (events[i].events & EPOLLERR) {
+                    c.failed = true;
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+                    if (!c.peerClosed && !readInput(c)) c.failed = true;
+                    processInput(c);
+                }
+                touched.push_back(fd);
+            }
+            // One group commit covers every change above; only now may they be acknowledged
+            bool durable = true;
+            try {
+                system.endBatch();
+            } catch (const LogWriteError& e) {
+                cerr << e.what() << "\n";
+                durable = false;
+            }
+            
+            for (int fd : touched) {
+                Connection& c = *connections[fd];
+                if (!durable) retractBatch(c);
+                if (c.failed || !flushOutput(c) || (c.pending.empty() && (c.closeAfterWrite || c.peerClosed))) {
+                    closeConnection(fd);
+                }
+            }
+            touched.clear();
+        }
+    }
+    
+    void stop() { stopping.store(true, memory_order_relaxed); }
+    
+    // Async-signal-safe; stops every running server, e.g. on SIGINT
+    static void interrupt() { interrupted.store(true, memory_order_relaxed); }
+    
+    // Request parsing and form decoding on fixed inputs (pipelining, partial
+    // bodies, keep-alive rules, malformed and oversized requests); returns
+    // the number of cases that came out wrong
+    static size_t parserMismatches() {
+        struct Case {
+            string input;
+            Parse expected;
+            string_view method, path, query, body;
+            bool keepAlive;
+            size_t length;    // of the first request, when Complete
+        };
+        const string get = "GET /orders/42?page=2 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        const string post = "POST /orders HTTP/1.1\r\ncontent-length:  15 \r\n\r\ncustomer=7&r=30";
+        const Case cases[] = {
+            {get, Parse::Complete, "GET", "/orders/42", "page=2", "", true, get.size()},
+            {post + get, Parse::Complete, "POST", "/orders", "", "customer=7&r=30", true, post.size()},
+            {post.substr(0, post.size() - 1), Parse::Incomplete, "", "", "", "", false, 0},
+            {get.substr(0, get.size() - 2), Parse::Incomplete, "", "", "", "", false, 0},
+            {"GET / HTTP/1.0\r\n\r\n", Parse::Complete, "GET", "/", "", "", false, 18},
+            {"GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", Parse::Complete, "GET", "/", "", "", true, 42},
+            {"GET / HTTP/1.1\r\nConnection: close\r\n\r\n", Parse::Complete, "GET", "/", "", "", false, 37},
+            {"GET /\r\n\r\n", Parse::Invalid, "", "", "", "", false, 0},
+            {"GET / HTTP/2\r\n\r\n", Parse::Invalid, "", "", "", "", false, 0},
+            {"GET / HTTP/1.1\r\nno colon\r\n\r\n", Parse::Invalid, "", "", "", "", false, 0},
+            {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", Parse::Invalid, "", "", "", "", false, 0},
+            {"POST / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n", Parse::Invalid, "", "", "", "", false, 0},
+            {"POST / HTTP/1.1\r\nContent-Length: " + to_string(MAX_BODY_BYTES + 1) + "\r\n\r\n",
+             Parse::TooLarge, "", "", "", "", false, 0},
+            {"GET / HTTP/1.1\r\nX: " + string(MAX_HEADER_BYTES, 'a'), Parse::TooLarge, "", "", "", "", false, 0},
+        };
+        
+        size_t mismatches = 0;
+        for (const auto& c : cases) {
+            Request request;
+            size_t length = 0;
+            Parse result = parseRequest(c.input, request, length);
+            if (result != c.expected) {
+                mismatches++;
+            } else if (result == Parse::Complete) {
+                mismatches += request.method != c.method || request.path != c.path || request.query != c.query ||
+                              request.body != c.body || request.keepAlive != c.keepAlive || length != c.length;
+            }
+        }
+        
+        string decoded;
+        mismatches += !formValue("a=1&name=Pad+Thai%21%2b&b=", "name", decoded) || decoded != "Pad Thai!+";
+        mismatches += !formValue("a=1&b=", "b", decoded) || !decoded.empty();
+        mismatches += formValue("ab=1", "a", decoded);
+        return mismatches;
+    }
+};
+
+#endif
+
+// ======================= BENCHMARKS =======================
+
+// Helpers shared by the benchmarks, the workload driver and the load test
+
+inline double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Nearest-rank p-th percentile of sorted, non-empty values
+inline double percentile(const vector<double>& sorted, double p) {
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[min(index, sorted.size() - 1)];
+}
+
+// Sorts `latencies` (seconds) and prints one line: how many `unit`s, then
+// p50, p90, p99 and max in microseconds
+inline void reportLatencies(const char* label, vector<double>& latencies, const char* unit) {
+    if (latencies.empty()) return;
+    sort(latencies.begin(), latencies.end());
+    cout << "  " << left << setw(16) << label << right << setw(9) << latencies.size() << " " << unit << "  p50 "
+         << percentile(latencies, 0.5) * 1e6 << " us  p90 " << percentile(latencies, 0.9) * 1e6 << " us  p99 "
+         << percentile(latencies, 0.99) * 1e6 << " us  max " << latencies.back() * 1e6 << " us\n";
+}
+
+// Walks the `--flag value` pairs after the mode argument, handing each to
+// apply(flag, value); flags listed in `switches` take no value. False, with
+// a message, when a value is missing or apply rejects one
+template<typename Apply>
+bool parseFlags(int argc, char* argv[], initializer_list<string_view> switches, Apply apply) {
+    for (int i = 2; i < argc; i++) {
+        string flag = argv[i];
+        string value;
+        if (find(switches.begin(), switches.end(), flag) == switches.end()) {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << flag << "\n";
+                return false;
+            }
+            value = argv[++i];
+        }
+        if (!apply(flag, value)) {
+            cerr << "Invalid option " << flag << (value.empty() ? "" : " " + value) << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+class LoaderBenchmark {
+public:
+    // The stringstream loader this replaced, kept as the baseline
+    static vector<Restaurant> legacyLoadRestaurants(const string& path) {
+        vector<Restaurant> restaurants;
+        HashTable<Restaurant> restaurantMap;
+        
+        ifstream file(path);
+        string line;
+        
+        while (getline(file, line) && !line.empty()) {
+            if (line.substr(0, 4) == "MENU") {
+                stringstream ss(line.substr(5));
+                string restId, itemData;
+                getline(ss, restId, ',');
+                getline(ss, itemData);
+                
+                Restaurant* rest = restaurantMap.search(restId);
+                if (rest) {
+                    rest->addMenuItem(MenuItem::fromString(itemData));
+                }
+            } else {
+                stringstream ss(line);
+                string id, name, address, ratingStr;
+                getline(ss, id, ',');
+                getline(ss, name, ',');
+                getline(ss, ratingStr, ',');
+                getline(ss, address, ',');
+                
+                Restaurant rest(stoull(id), name, stod(ratingStr), address);
+                restaurants.push_back(rest);
+                restaurantMap.insert(id, rest);
+            }
+        }
+        return restaurants;
+    }
+    
+    // Stops at targetBytes or maxRestaurants, whichever comes first
+    static void generateFile(const string& path, size_t targetBytes, size_t maxRestaurants = SIZE_MAX) {
+        static const char* dishes[] = {"Burger", "Pizza", "Salad", "Biryani", "Karahi", "Pasta", "Wrap", "Soup"};
+        static const char* categories[] = {"Fast Food", "Italian", "Healthy", "Desi"};
+        
+        ofstream file(path, ios::binary);
+        string chunk;
+        chunk.reserve(1 << 20);
+        size_t written = 0;
+        
+        for (uint64_t id = 1; written < targetBytes && id <= maxRestaurants; id++) {
+            string rid = to_string(1700000000000ULL + id);
+            chunk += rid + ",Restaurant " + to_string(id) + "," + to_string(1 + id % 40 / 10.0).substr(0, 3)
+                   + ",Street " + to_string(id % 977) + "\n";
+            for (int i = 0; i < 8; i++) {
+                chunk += "MENU," + rid + "," + dishes[(id + i) % 8] + "," + to_string(5 + (id * 7 + i) % 20)
+                       + ".99," + categories[(id + i) % 4] + "\n";
+            }
+            if (chunk.size() >= (1 << 20) - 1024) {
+                file.write(chunk.data(), chunk.size());
+                written += chunk.size();
+                chunk.clear();
+            }
+        }
+        file.write(chunk.data(), chunk.size());
+    }
+    
+    static void run(size_t megabytes) {
+        const string path = "loader_bench.dat";
+        cout << "Generating " << megabytes << " MB synthetic restaurants file...\n";
+        generateFile(path, megabytes << 20);
+        
+        auto time = [](auto&& fn) {
+            auto start = chrono::steady_clock::now();
+            size_t result = fn();
+            double seconds = secondsSince(start);
+            return make_pair(result, seconds);
+        };
+        auto report = [megabytes](const char* label, pair<size_t, double> r, const char* unit) {
+            cout << label << ": " << r.first << " " << unit << " in " << r.second << " s ("
+                 << megabytes / r.second << " MB/s)\n";
+        };
+        
+        report("Legacy stringstream loader", time([&] {
+            return legacyLoadRestaurants(path).size();
+        }), "restaurants");
+        
+        report("Mapped parse only", time([&] {
+            struct Counter {
+                size_t records = 0;
+                void onRestaurant(const RestaurantRecordView&) { records++; }
+                void onMenuItem(const MenuRecordView&) { records++; }
+            } counter;
+            MappedFile file(path);
+            vector<ParseError> errors;
+            parseRestaurantData(file.view(), counter, errors);
+            return counter.records;
+        }), "records");
+        
+        report("Mapped full load", time([&] {
+            size_t items = 0;
+            for (const auto& r : Restaurant::loadAllRestaurants(path)) items += r.menu.size();
+            return items;
+        }), "menu items");
+        
+        // Item names and categories are symbols, so the pool holds each text once
+        AllocationCounter::Sample before = AllocationCounter::sample();
+        vector<Restaurant> loaded = Restaurant::loadAllRestaurants(path);
+        int64_t held = AllocationCounter::sample().liveBytes - before.liveBytes;
+        size_t items = 0;
+        for (const auto& r : loaded) items += r.menu.size();
+        const StringInterner& pool = StringInterner::instance();
+        cout << "Loaded heap: ";
+        if (AllocationCounter::enabled) {
+            cout << held / max<int64_t>(1, loaded.size()) << " bytes per restaurant";
+        } else {
+            cout << "not counted (build with -DFDS_COUNT_ALLOCATIONS)";
+        }
+        cout << " (" << sizeof(MenuItem) << "-byte menu items); string pool: " << pool.size() << " strings, "
+             << pool.textBytes() << " bytes\n";
+        
+        remove(path.c_str());
+    }
+};
+
+class QueueBenchmark {
+private:
+    static void report(const char* label, size_t ops, double seconds) {
+        cout << "  " << label << ": " << seconds * 1e3 << " ms (" << (seconds * 1e9 / max<size_t>(ops, 1))
+             << " ns/op)\n";
+    }
+    
+public:
+    // LinkedList::insert walks to the tail, so it is capped to keep the run finite
+    static constexpr size_t LINKED_LIST_CAP = 10000;
+    
+    static void run(size_t n) {
+        cout << "Building " << n << " orders...\n";
+        vector<Order> orders;
+        orders.reserve(n);
+        Order prototype(0, 1749809397841ULL, 1);
+        prototype.addLine(0, Money::cents(1299));
+        for (size_t i = 0; i < n; i++) {
+            orders.push_back(prototype);
+            orders.back().orderId = 1700000000000ULL + i;
+        }
+        
+        cout << "PooledDeque<Order> (" << n << " orders)\n";
+        {
+            PooledDeque<Order> queue;
+            vector<Handle> handles;
+            handles.reserve(n);
+            
+            auto start = chrono::steady_clock::now();
+            for (const auto& order : orders) handles.push_back(queue.pushBack(order));
+            report("append", n, secondsSince(start));
+            
+            start = chrono::steady_clock::now();
+            Money total;
+            queue.forEach([&total](const Order& o) { total += o.totalAmount; });
+            report("iterate", n, secondsSince(start));
+            
+            // Remove every other order by handle, then drain from the front
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i += 2) queue.remove(handles[i]);
+            while (!queue.isEmpty()) queue.popFront();
+            report("remove all", n, secondsSince(start));
+            if (total < Money()) cout << total;
+        }
+        
+        size_t m = min(n, LINKED_LIST_CAP);
+        cout << "LinkedList<Order> (" << m << " orders" << (m < n ? ", capped: O(n) tail walk" : "") << ")\n";
+        {
+            LinkedList<Order> list;
+            
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < m; i++) list.insert(orders[i]);
+            report("append", m, secondsSince(start));
+            
+            start = chrono::steady_clock::now();
+            Money total;
+            for (const auto& o : list.traverse()) total += o.totalAmount;
+            report("iterate (traverse copy)", m, secondsSince(start));
+            
+            start = chrono::steady_clock::now();
+            for (size_t i = m; i-- > 0; ) list.remove(orders[i]);
+            report("remove all (from tail)", m, secondsSince(start));
+            if (total < Money()) cout << total;
+        }
+    }
+};
+
+class LifecycleBenchmark {
+private:
+    static double run(OrderLifecycle& engine, const vector<EntityId>& ids, size_t batchSize) {
+        static const OrderStatus steps[] = {OrderStatus::Accepted, OrderStatus::Preparing,
+                                            OrderStatus::PickedUp, OrderStatus::Delivered};
+        auto start = chrono::steady_clock::now();
+        vector<EntityId> batch;
+        for (OrderStatus step : steps) {
+            if (batchSize <= 1) {
+                for (EntityId id : ids) engine.advance(id, step);
+                continue;
+            }
+            for (size_t i = 0; i < ids.size(); i += batchSize) {
+                batch.assign(ids.begin() + i, ids.begin() + min(ids.size(), i + batchSize));
+                engine.advanceOrders(batch, step);
+            }
+        }
+        return secondsSince(start);
+    }
+    
+    static bool measure(const char* label, size_t n, const WalOptions& options, size_t batchSize) {
+        const string walPath = "lifecycle_bench.wal";
+        remove(walPath.c_str());
+        WriteAheadLog wal;
+        wal.open(walPath, options, 0);
+        OrderLifecycle engine(wal, nullptr);
+        
+        vector<EntityId> ids;
+        ids.reserve(n);
+        Order prototype(0, 1749809397841ULL, 1);
+        for (size_t i = 0; i < n; i++) {
+            ids.push_back(1700000000000ULL + i);
+            prototype.orderId = ids.back();
+            engine.add(Order(prototype));
+        }
+        
+        double seconds = run(engine, ids, batchSize);
+        size_t transitions = n * 4;
+        cout << "  " << label << ": " << transitions << " transitions in " << seconds << " s ("
+             << static_cast<uint64_t>(transitions / seconds) << " transitions/s)\n";
+        bool delivered = engine.count(OrderStatus::Delivered) == n;
+        if (!delivered) {
+            cout << "  warning: only " << engine.count(OrderStatus::Delivered) << " orders delivered\n";
+        }
+        wal.close();
+        remove(walPath.c_str());
+        return delivered;
+    }
+    
+public:
+    static bool run(size_t n) {
+        WalOptions noSync;
+        noSync.sync = WalOptions::Sync::None;
+        WalOptions grouped;
+        
+        cout << "Order lifecycle transitions (" << n << " orders x 4 steps)\n";
+        bool ok = measure("in-memory log, one at a time", n, noSync, 1);
+        ok &= measure("in-memory log, batches of 1024", n, noSync, 1024);
+        // Durable commits pay an fsync per call, so the one-at-a-time run is kept small
+        ok &= measure("group commit, one at a time", min<size_t>(n, 500), grouped, 1);
+        ok &= measure("group commit, batches of 1024", n, grouped, 1024);
+        return ok;
+    }
+};
+
+// Heap traffic of the order path, read from AllocationCounter: allocations
+// and retained bytes per FoodDeliverySystem::placeOrder on a scratch system
+class OrderMemoryBenchmark {
+private:
+    static constexpr size_t RESTAURANTS = 500;
+    static constexpr size_t CUSTOMERS = 5000;
+    static constexpr size_t MENU_SIZE = 12;
+    
+public:
+    static void run(size_t n) {
+        static const char* dishes[] = {"Chicken Tikka Masala", "Margherita Pizza", "Pad Thai with Shrimp",
+                                       "Caesar Salad", "Beef Bulgogi Bowl", "Vegetable Spring Rolls"};
+        static const char* categories[] = {"Indian", "Italian", "Thai", "Healthy", "Korean", "Chinese"};
+        
+        filesystem::create_directories("order_memory_bench");
+        filesystem::current_path("order_memory_bench");
+        remove("system.snap");
+        remove("system.wal");
+        
+        WalOptions walOptions;
+        walOptions.sync = WalOptions::Sync::None;
+        FoodDeliverySystem system(walOptions);
+        system.setDispatchBudget(chrono::microseconds(0));
+        
+        vector<EntityId> restaurants, customers;
+        for (size_t i = 0; i < RESTAURANTS; i++) {
+            Restaurant restaurant(0, "Restaurant " + to_string(i), 3.0 + (i % 20) / 10.0, "Main Street " + to_string(i));
+            restaurant.location = GeoPoint(40.70 + (i % 50) * 0.002, -74.00 + (i / 50) * 0.002);
+            for (size_t j = 0; j < MENU_SIZE; j++) {
+                restaurant.addMenuItem(MenuItem(dishes[j % 6], Money::cents(500 + 100 * j), categories[(i + j) % 6]));
+            }
+            restaurants.push_back(system.addRestaurant(move(restaurant)));
+        }
+        for (size_t i = 0; i < CUSTOMERS; i++) {
+            Customer customer(0, "Customer " + to_string(i), "555-0100", "Side Street " + to_string(i));
+            customer.location = GeoPoint(40.70 + (i % 70) * 0.0015, -74.00 + (i / 70) * 0.0015);
+            customers.push_back(system.addCustomer(move(customer)));
+        }
+        
+        vector<vector<uint32_t>> baskets(64);
+        for (size_t i = 0; i < baskets.size(); i++) {
+            for (size_t j = 0; j <= i % 4; j++) baskets[i].push_back(static_cast<uint32_t>((i * 7 + j * 5) % MENU_SIZE));
+        }
+        
+        AllocationCounter::Sample before = AllocationCounter::sample();
+        auto start = chrono::steady_clock::now();
+        size_t placed = 0;
+        for (size_t i = 0; i < n; i++) {
+            placed += system.placeOrder(customers[mixHash(i) % CUSTOMERS], restaurants[i % RESTAURANTS],
+                                        baskets[i % baskets.size()]) != 0;
+        }
+        double seconds = secondsSince(start);
+        AllocationCounter::Sample after = AllocationCounter::sample();
+        
+        cout << "Order placement heap traffic (" << placed << " orders, " << RESTAURANTS << " restaurants x "
+             << MENU_SIZE << " items)\n";
+        cout << fixed << setprecision(2);
+        if (AllocationCounter::enabled) {
+            cout << "  allocations per placeOrder: " << double(after.allocations - before.allocations) / n << "\n";
+            cout << "  bytes allocated per order:  " << double(after.bytes - before.bytes) / n << "\n";
+            cout << "  bytes retained per order:   " << double(after.liveBytes - before.liveBytes) / n << "\n";
+        } else {
+            cout << "  allocation counting is off; build with -DFDS_COUNT_ALLOCATIONS to measure it\n";
+        }
+        cout << "  sizeof(Order):              " << sizeof(Order) << "\n";
+        cout << "  " << static_cast<uint64_t>(n / seconds) << " orders/s\n";
+        cout.unsetf(ios::fixed);
+        
+        filesystem::current_path("..");
+    }
+};
+
+// Revenue per restaurant per hour over a week of synthetic orders: the
+// column kernels in OrderAnalytics against walking the pooled row store
+// (OrderLifecycle) and sorting (restaurant, hour, amount) tuples. Both
+// must agree on every group's count, revenue and median.
+class AnalyticsBenchmark {
+private:
+    static constexpr size_t RESTAURANTS = 1000;
+    static constexpr size_t CUSTOMERS = 50000;
+    static constexpr int64_t HOUR = 3600;
+    static constexpr int64_t WEEK = 7 * 24 * HOUR;
+    
+    struct Row {
+        EntityId restaurantId;
+        time_t hour;
+        int64_t cents;
+        
+        bool operator<(const Row& other) const {
+            if (restaurantId != other.restaurantId) return restaurantId < other.restaurantId;
+            if (hour != other.hour) return hour < other.hour;
+            return cents < other.cents;
+        }
+    };
+    
+    // (restaurant, hour, orders, revenue, median) for every non-empty group
+    static uint64_t checksum(EntityId restaurantId, time_t hour, uint64_t orders, int64_t revenue, int64_t median) {
+        return mixHash(restaurantId ^ mixHash(static_cast<uint64_t>(hour) ^ mixHash(orders ^
+                       mixHash(static_cast<uint64_t>(revenue) ^ mixHash(static_cast<uint64_t>(median))))));
+    }
+    
+public:
+    static bool run(size_t n) {
+        WriteAheadLog closed;
+        OrderLifecycle rowStore(closed, nullptr);
+        OrderAnalytics columns;
+        time_t weekStart = time(nullptr) / HOUR * HOUR - WEEK;
+        
+        // Ids below 2^22 carry no timestamp, so placement time is updatedAt
+        auto build = chrono::steady_clock::now();
+        for (size_t i = 0; i < n; i++) {
+            uint64_t h = mixHash(i);
+            Order order(i + 1, 1 + h % CUSTOMERS, 1 + (h >> 20) % RESTAURANTS);
+            for (size_t line = 0; line <= (h >> 40) % 4; line++) {
+                order.addLine(static_cast<uint32_t>(line), Money::cents(500 + (h >> (8 * line)) % 2500));
+            }
+            order.updatedAt = weekStart + static_cast<time_t>((h >> 32) % WEEK);
+            order.status = (h >> 50) % 20 == 0 ? OrderStatus::Cancelled : static_cast<OrderStatus>((h >> 52) % 5);
+            rowStore.add(move(order));
+        }
+        double rowBuild = secondsSince(build);
+        build = chrono::steady_clock::now();
+        columns.reserve(n);
+        auto addColumns = [&columns](const Order& order) { columns.add(order); };
+        rowStore.forEachActive(addColumns);
+        rowStore.forEachCompleted(addColumns);
+        double columnBuild = secondsSince(build);
+        
+        OrderAnalytics::Query query;
+        query.from = weekStart;
+        query.to = weekStart + WEEK;
+        query.statusMask = ~OrderAnalytics::statusBit(OrderStatus::Cancelled);
+        query.bucketSeconds = HOUR;
+        
+        auto start = chrono::steady_clock::now();
+        vector<Row> tuples;
+        tuples.reserve(n);
+        auto collect = [&tuples, &query](const Order& order) {
+            if (order.status == OrderStatus::Cancelled) return;
+            tuples.push_back({order.restaurantId, order.updatedAt - (order.updatedAt - query.from) % HOUR,
+                              order.totalAmount.inCents()});
+        };
+        rowStore.forEachActive(collect);
+        rowStore.forEachCompleted(collect);
+        sort(tuples.begin(), tuples.end());
+        uint64_t rowSum = 0;
+        size_t rowGroups = 0;
+        for (size_t i = 0; i < tuples.size();) {
+            size_t j = i;
+            int64_t revenue = 0;
+            while (j < tuples.size() && tuples[j].restaurantId == tuples[i].restaurantId &&
+                   tuples[j].hour == tuples[i].hour) {
+                revenue += tuples[j++].cents;
+            }
+            size_t count = j - i;
+            size_t median = (count + 1) / 2 - 1;
+            rowSum += checksum(tuples[i].restaurantId, tuples[i].hour, count, revenue, tuples[i + median].cents);
+            rowGroups++;
+            i = j;
+        }
+        double rowSeconds = secondsSince(start);
+        
+        start = chrono::steady_clock::now();
+        vector<OrderAnalytics::Group> groups;
+        columns.aggregate(query, groups);
+        double columnSeconds = secondsSince(start);
+        uint64_t columnSum = 0;
+        for (const auto& group : groups) {
+            columnSum += checksum(group.restaurantId, group.bucketStart, group.orders, group.revenue.inCents(),
+                                  group.p50.inCents());
+        }
+        
+        query.byRestaurant = false;
+        query.bucketSeconds = 0;
+        start = chrono::steady_clock::now();
+        vector<OrderAnalytics::Group> total;
+        columns.aggregate(query, total);
+        double totalSeconds = secondsSince(start);
+        
+        cout << "Revenue per restaurant per hour (" << n << " orders, " << RESTAURANTS << " restaurants, one week)\n";
+        cout << fixed << setprecision(1);
+        cout << "  build: row store " << rowBuild * 1000 << " ms, columns " << columnBuild * 1000 << " ms ("
+             << (sizeof(uint32_t) * 2 + sizeof(int64_t) * 2 + 1) << " bytes per order)\n";
+        cout << "  row walk + sort:  " << rowSeconds * 1000 << " ms, " << rowGroups << " groups\n";
+        cout << "  column kernels:   " << columnSeconds * 1000 << " ms, " << groups.size() << " groups ("
+             << setprecision(0) << n / columnSeconds / 1e6 << "M rows/s)\n";
+        cout << setprecision(1);
+        cout << "  whole-week total: " << totalSeconds * 1000 << " ms, $" << (total.empty() ? Money() : total[0].revenue)
+             << " (median $" << (total.empty() ? Money() : total[0].p50) << ")\n";
+        bool match = rowSum == columnSum && rowGroups == groups.size();
+        cout << "  results " << (match ? "match" : "DIFFER") << "\n";
+        cout.unsetf(ios::fixed);
+        return match;
+    }
+};
+
+// Bills the same synthetic orders twice with one set of rules (10% off
+// capped at $5 from $20, a $2.99 fee waived from $35, 8.875% tax): per
+// order in doubles, as the amounts used to be, and as a BillingBatch in
+// integer cents. Reports throughput and how far the doubles drift.
+class BillingBenchmark {
+public:
+    static bool run(size_t n) {
+        vector<Order> orders;
+        orders.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t h = mixHash(i);
+            Order order(i + 1, 1 + h % 50000, 1 + (h >> 20) % 1000);
+            // One to six lines, so some orders spill past the inline lines
+            for (size_t line = 0; line <= (h >> 40) % 6; line++) {
+                order.addLine(static_cast<uint32_t>(line), Money::cents(199 + mixHash(h + line) % 2800));
+            }
+            orders.push_back(move(order));
+        }
+        
+        // Rounds each charge to the cent the way a double-based bill would
+        auto start = chrono::steady_clock::now();
+        double grandTotal = 0;
+        vector<double> doubleTotals(n);
+        for (size_t i = 0; i < n; i++) {
+            double subtotal = 0;
+            for (const auto& line : orders[i].lines) subtotal += line.price.toDouble();
+            double discount = subtotal >= 20.0 ? min(round(subtotal * 10.0) / 100.0, 5.0) : 0.0;
+            double fee = subtotal >= 35.0 ? 0.0 : 2.99;
+            double tax = round((subtotal - discount + fee) * 8.875) / 100.0;
+            doubleTotals[i] = subtotal - discount + fee + tax;
+            grandTotal += doubleTotals[i];
+        }
+        double doubleSeconds = secondsSince(start);
+        
+        BillingPipeline pipeline;
+        pipeline.discount(100000, Money::cents(500), Money::cents(2000))
+                .fee(Money::cents(299), Money::cents(3500))
+                .tax(88750);
+        
+        start = chrono::steady_clock::now();
+        BillingBatch batch;
+        batch.reserve(n);
+        for (const auto& order : orders) batch.add(order);
+        double loadSeconds = secondsSince(start);
+        start = chrono::steady_clock::now();
+        pipeline.run(batch);
+        double batchSeconds = secondsSince(start);
+        
+        size_t subtotalMismatches = 0;
+        size_t differingBills = 0;
+        for (size_t i = 0; i < n; i++) {
+            subtotalMismatches += batch.subtotal[i] != orders[i].totalAmount;
+            differingBills += Money::fromDouble(doubleTotals[i]) != batch.total[i];
+        }
+        Money exact = BillingBatch::sum(batch.total);
+        
+        cout << "Billing " << n << " orders (" << batch.planeCount() << " line planes)\n";
+        cout << fixed << setprecision(1);
+        cout << "  per order, doubles:   " << doubleSeconds * 1000 << " ms ("
+             << n / doubleSeconds / 1e6 << "M orders/s)\n";
+        cout << "  batch, integer cents: " << batchSeconds * 1000 << " ms (" << n / batchSeconds / 1e6
+             << "M orders/s) plus " << loadSeconds * 1000 << " ms to lay out the planes\n";
+        cout << setprecision(2);
+        cout << "  grand total: $" << exact << " exact, $" << grandTotal << " summed in doubles\n";
+        cout << "  " << differingBills << " bills differ by rounding, " << subtotalMismatches
+             << " subtotals differ from the order totals; columns "
+             << (batch.reconciles() ? "reconcile" : "DO NOT reconcile") << "\n";
+        cout.unsetf(ios::fixed);
+        return subtotalMismatches == 0 && batch.reconciles();
+    }
+};
+
+// Runs one mixed client workload (registrations, orders, status updates
+// racing on a shared pool of recent orders) against a scratch
+// FoodDeliverySystem on 1, 2, 4, ... threads, then checks each run's log:
+// every order's logged history must be a legal sequence of transitions, and
+// a system rebuilt from the log must match the live one.
+class ConcurrencyBenchmark {
+private:
+    static constexpr size_t RESTAURANTS = 1000;
+    static constexpr size_t CUSTOMERS = 10000;
+    static constexpr size_t MENU_ITEMS = 10;
+    static constexpr size_t RECENT = 4096;
+    
+    struct Counters {
+        atomic<size_t> registered{0};
+        atomic<size_t> placed{0};
+        atomic<size_t> advanced{0};
+        atomic<size_t> conflicts{0};
+    };
+    
+    struct Seed {
+        vector<EntityId> restaurants;
+        vector<EntityId> customers;
+    };
+    
+    // Final state of one order, taken from the live system
+    struct Outcome {
+        EntityId orderId;
+        OrderStatus status;
+        time_t updatedAt;
+    };
+    
+    // Everyone gets coordinates on a ~5 km square, so orders go through
+    // dispatch like real ones
+    static Seed seed(FoodDeliverySystem& system) {
+        Seed ids;
+        for (size_t r = 0; r < RESTAURANTS; r++) {
+            Restaurant restaurant(0, "Restaurant " + to_string(r), 4.0, "Street " + to_string(r));
+            restaurant.location = GeoPoint(40.70 + (r % 32) * 0.0015, -74.00 + (r / 32) * 0.0015);
+            for (size_t i = 0; i < MENU_ITEMS; i++) {
+                restaurant.addMenuItem(MenuItem("Dish " + to_string(i), Money::cents(250 + 100 * i), "Desi"));
+            }
+            ids.restaurants.push_back(system.addRestaurant(move(restaurant)));
+        }
+        for (size_t c = 0; c < CUSTOMERS; c++) {
+            Customer customer(0, "Customer " + to_string(c), "0300", "House");
+            customer.location = GeoPoint(40.70 + (c % 100) * 0.0005, -74.00 + (c / 100) * 0.0005);
+            ids.customers.push_back(system.addCustomer(move(customer)));
+        }
+        // The fleet is sized from restaurant locations
+        system.startDispatch();
+        return ids;
+    }
+    
+    // 10% registrations, 30% orders, 60% single-step status updates on a
+    // random recent order; racing updates to one order fail as conflicts
+    static void client(FoodDeliverySystem& system, const Seed& ids, vector<atomic<EntityId>>& recent,
+                       size_t ops, uint64_t seedValue, Counters& counters, vector<EntityId>& placed) {
+        uint64_t state = seedValue;
+        auto random = [&state] { return mixHash(++state); };
+        vector<uint32_t> items;
+        Order order;
+        
+        for (size_t op = 0; op < ops; op++) {
+            uint64_t roll = random() % 10;
+            if (roll == 0) {
+                system.addCustomer(Customer(0, "Walk-in", "0300", "Street"));
+                counters.registered.fetch_add(1, memory_order_relaxed);
+            } else if (roll <= 3) {
+                items.assign(1 + random() % 3, 0);
+                for (auto& item : items) item = static_cast<uint32_t>(random() % MENU_ITEMS);
+                EntityId id = system.placeOrder(ids.customers[random() % ids.customers.size()],
+                                                ids.restaurants[random() % ids.restaurants.size()], items);
+                if (!id) continue;
+                recent[random() % RECENT].store(id, memory_order_relaxed);
+                placed.push_back(id);
+                counters.placed.fetch_add(1, memory_order_relaxed);
+            } else {
+                EntityId id = recent[random() % RECENT].load(memory_order_relaxed);
+                if (!id || !system.findOrder(id, order) || isTerminal(order.status)) continue;
+                OrderStatus next = random() % 20 == 0 && order.status != OrderStatus::PickedUp
+                    ? OrderStatus::Cancelled
+                    : static_cast<OrderStatus>(static_cast<int>(order.status) + 1);
+                if (system.setOrderStatus(id, next) == OrderLifecycle::Result::Ok) {
+                    counters.advanced.fetch_add(1, memory_order_relaxed);
+                } else {
+                    counters.conflicts.fetch_add(1, memory_order_relaxed);
+                }
+            }
+        }
+    }
+    
+    // Checks the log in the current directory against the live outcomes,
+    // then rebuilds a system from it; returns the number of problems found
+    static size_t verify(const vector<Outcome>& live, size_t expectedRecords) {
+        HashTable<OrderStatus, EntityId> lastStatus;
+        size_t illegal = 0;
+        size_t records = 0;
+        WriteAheadLog::replay("system.wal", [&](WalRecordType type, WalDecoder& in) {
+            if (type == WalRecordType::OrderStatusChanged) {
+                EntityId id;
+                OrderStatus to;
+                time_t at;
+                bool known = Order::decodeStatusChange(type, in, id, to, at);
+                OrderStatus* from = lastStatus.search(id);
+                if (!known || !from || !canTransition(*from, to)) illegal++;
+                else *from = to;
+            } else if (type == WalRecordType::OrderPlaced) {
+                lastStatus.insert(in.getU64(), OrderStatus::Pending);
+            }
+        }, records);
+        
+        FoodDeliverySystem replica;
+        size_t mismatched = 0;
+        Order copy;
+        for (const Outcome& outcome : live) {
+            if (!replica.findOrder(outcome.orderId, copy) || copy.status != outcome.status ||
+                copy.updatedAt != outcome.updatedAt) {
+                mismatched++;
+            }
+        }
+        if (records != expectedRecords) {
+            cout << "    log holds " << records << " records, expected " << expectedRecords << "\n";
+        }
+        if (illegal) cout << "    " << illegal << " illegal transitions in the log\n";
+        if (mismatched) cout << "    " << mismatched << " orders differ after replay\n";
+        return illegal + mismatched + (records != expectedRecords);
+    }
+    
+    static size_t measure(const char* label, size_t ops, size_t maxThreads, const WalOptions& options) {
+        cout << "  " << label << " (" << ops << " operations per run)\n";
+        double baseline = 0;
+        size_t problems = 0;
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            remove("system.snap");
+            remove("system.wal");
+            Counters counters;
+            vector<Outcome> outcomes;
+            double seconds;
+            {
+                FoodDeliverySystem system(options);
+                // One commit for the whole seed, outside the timed part
+                system.beginBatch();
+                Seed ids = seed(system);
+                system.endBatch();
+                vector<atomic<EntityId>> recent(RECENT);
+                for (auto& slot : recent) slot.store(0, memory_order_relaxed);
+                vector<vector<EntityId>> placed(threads);
+                
+                auto start = chrono::steady_clock::now();
+                vector<thread> clients;
+                for (size_t t = 0; t < threads; t++) {
+                    size_t share = ops / threads + (t < ops % threads ? 1 : 0);
+                    clients.emplace_back(client, ref(system), cref(ids), ref(recent), share,
+                                         (t + 1) * 0x9E3779B97F4A7C15ULL, ref(counters), ref(placed[t]));
+                }
+                for (auto& c : clients) c.join();
+                seconds = secondsSince(start);
+                
+                Order order;
+                for (const auto& ids : placed) {
+                    for (EntityId id : ids) {
+                        if (system.findOrder(id, order)) outcomes.push_back({id, order.status, order.updatedAt});
+                    }
+                }
+            }
+            
+            double rate = ops / seconds;
+            if (threads == 1) baseline = rate;
+            cout << "    " << setw(3) << threads << " threads: " << static_cast<uint64_t>(rate) << " ops/s ("
+                 << fixed << setprecision(2) << rate / baseline << "x), " << defaultfloat
+                 << counters.placed.load() << " orders, " << counters.advanced.load() << " updates, "
+                 << counters.conflicts.load() << " lost races\n";
+            
+            size_t expected = RESTAURANTS + CUSTOMERS + counters.registered.load() +
+                              counters.placed.load() + counters.advanced.load();
+            size_t found = verify(outcomes, expected);
+            if (found == 0) {
+                cout << "    replay: " << outcomes.size() << " orders match, histories legal\n";
+            }
+            problems += found;
+        }
+        return problems;
+    }
+    
+public:
+    static bool run(size_t ops, size_t maxThreads) {
+        WalOptions noSync;
+        noSync.sync = WalOptions::Sync::None;
+        WalOptions grouped;
+        
+        filesystem::create_directories("concurrency_bench");
+        filesystem::current_path("concurrency_bench");
+        cout << "Concurrent system scaling, 1 to " << maxThreads << " threads\n";
+        size_t problems = measure("in-memory log", ops, maxThreads, noSync);
+        // Every call waits for its group commit, so throughput comes from
+        // threads sharing fsyncs; the run is kept small
+        problems += measure("group commit", max<size_t>(1, ops / 100), maxThreads, grouped);
+        remove("system.snap");
+        remove("system.wal");
+        filesystem::current_path("..");
+        return problems == 0;
+    }
+};
+
+class RoutingBenchmark {
+private:
+    static uint64_t pathLength(const RoadGraph& graph, const vector<uint32_t>& path) {
+        uint64_t total = 0;
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            uint64_t best = UINT64_MAX;
+            for (uint32_t e = graph.edgeBegin(path[i]); e < graph.edgeEnd(path[i]); e++) {
+                if (graph.target(e) == path[i + 1]) best = min<uint64_t>(best, graph.weight(e));
+            }
+            if (best == UINT64_MAX) return UINT64_MAX;
+            total += best;
+        }
+        return total;
+    }
+    
+public:
+    // Hierarchy vs Dijkstra on every pair of a small graph with zero-length
+    // roads (e.g. a junction split into two nodes), which the grid never has
+    static size_t zeroLengthMismatches() {
+        vector<uint64_t> ids = {1, 2, 3, 4, 5, 6, 7};
+        vector<RoadEdge> edges = {{0, 1, 0}, {1, 2, 0}, {2, 3, 0}, {3, 2, 0}, {0, 4, 90}, {4, 3, 90},
+                                  {3, 5, 40}, {5, 6, 0}, {6, 5, 0}, {1, 6, 120}, {5, 0, 30}, {4, 1, 0}};
+        RoadGraph graph;
+        graph.build(move(ids), {}, {}, edges);
+        ContractionHierarchy hierarchy;
+        hierarchy.build(graph);
+        RouteWorkspace ws;
+        size_t mismatches = 0;
+        for (uint32_t a = 0; a < graph.nodeCount(); a++) {
+            for (uint32_t b = 0; b < graph.nodeCount(); b++) {
+                mismatches += hierarchy.query(a, b, ws) != ShortestPaths::dijkstra(graph, a, b, ws);
+            }
+        }
+        return mismatches;
+    }
+    
+    // `source` is a roads.txt-format file, or empty to generate a side x side grid
+    static bool run(const string& source, uint32_t side) {
+        RoadGraph graph;
+        auto start = chrono::steady_clock::now();
+        if (source.empty()) {
+            const string path = "routing_bench.roads";
+            cout << "Generating " << side << "x" << side << " grid city...\n";
+            RoadGraph::grid(side, 42).save(path);
+            start = chrono::steady_clock::now();
+            graph.load(path);
+            remove(path.c_str());
+        } else if (!graph.load(source)) {
+            cout << "Cannot open " << source << "\n";
+            return false;
+        }
+        cout << "Loaded " << graph.nodeCount() << " nodes, " << graph.edgeCount() << " edges in "
+             << secondsSince(start) << " s\n";
+        if (graph.nodeCount() < 2) return true;
+        
+        start = chrono::steady_clock::now();
+        ContractionHierarchy hierarchy;
+        hierarchy.build(graph);
+        cout << "Contraction hierarchy: " << hierarchy.shortcutCount() << " shortcuts in "
+             << secondsSince(start) << " s\n";
+        
+        const size_t queries = 1000;
+        uint64_t state = 12345;
+        auto random = [&state, &graph]() { return static_cast<uint32_t>((state = mixHash(state + 1)) % graph.nodeCount()); };
+        vector<pair<uint32_t, uint32_t>> pairs(queries);
+        for (auto& p : pairs) p = {random(), random()};
+        
+        RouteWorkspace ws;
+        vector<uint32_t> path;
+        vector<uint32_t> expected(queries);
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < queries; i++) {
+            expected[i] = ShortestPaths::dijkstra(graph, pairs[i].first, pairs[i].second, ws);
+        }
+        double dijkstraSeconds = secondsSince(start);
+        
+        size_t mismatches = 0;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < queries; i++) {
+            mismatches += ShortestPaths::aStar(graph, pairs[i].first, pairs[i].second, ws) != expected[i];
+        }
+        double aStarSeconds = secondsSince(start);
+        
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < queries; i++) {
+            mismatches += hierarchy.query(pairs[i].first, pairs[i].second, ws) != expected[i];
+        }
+        double hierarchySeconds = secondsSince(start);
+        
+        size_t badPaths = 0;
+        for (size_t i = 0; i < 100; i++) {
+            uint32_t meters = hierarchy.query(pairs[i].first, pairs[i].second, ws, &path);
+            if (meters != UNREACHABLE && (path.front() != pairs[i].first || path.back() != pairs[i].second ||
+                                          pathLength(graph, path) != meters)) {
+                badPaths++;
+            }
+        }
+        
+        cout << "Point-to-point (" << queries << " random queries, microseconds/query)\n";
+        cout << "  Dijkstra: " << dijkstraSeconds * 1e6 / queries << "\n";
+        cout << "  A*: " << aStarSeconds * 1e6 / queries << "\n";
+        cout << "  Contraction hierarchy: " << hierarchySeconds * 1e6 / queries << "\n";
+        size_t zeroLength = zeroLengthMismatches();
+        cout << "  Distance mismatches vs Dijkstra: " << mismatches << ", invalid unpacked paths: " << badPaths
+             << ", zero-length road mismatches: " << zeroLength << "\n";
+        
+        const size_t side100 = min<size_t>(100, graph.nodeCount());
+        vector<uint32_t> sources(side100), targets(side100), matrix;
+        for (size_t i = 0; i < side100; i++) {
+            sources[i] = random();
+            targets[i] = random();
+        }
+        start = chrono::steady_clock::now();
+        hierarchy.distanceMatrix(sources, targets, ws, matrix);
+        double matrixSeconds = secondsSince(start);
+        size_t matrixMismatches = 0;
+        for (size_t i = 0; i < 10; i++) {
+            for (size_t j = 0; j < side100; j++) {
+                matrixMismatches += matrix[i * side100 + j] != hierarchy.query(sources[i], targets[j], ws);
+            }
+        }
+        cout << "Distance matrix " << side100 << "x" << side100 << ": " << matrixSeconds * 1e3 << " ms ("
+             << matrixMismatches << " mismatches in spot check)\n";
+        return mismatches + badPaths + zeroLength + matrixMismatches == 0;
+    }
+};
+
+class DispatchBenchmark {
+private:
+    struct Workload {
+        vector<Courier> fleet;
+        vector<DeliveryJob> jobs;
+    };
+    
+    // Orders around a 10 km square; a few restaurants take most of them
+    static Workload generate(size_t orders, size_t couriers, uint32_t capacity, uint64_t seed) {
+        uint64_t state = seed;
+        auto uniform = [&state]() { return static_cast<double>((state = mixHash(state + 1)) >> 11) / (1ULL << 53); };
+        auto pointNear = [&](double spread) {
+            return GeoPoint(33.65 + (uniform() - 0.5) * spread * 0.09, 73.05 + (uniform() - 0.5) * spread * 0.108);
+        };
+        
+        vector<GeoPoint> restaurants(40);
+        for (auto& r : restaurants) r = pointNear(1.0);
+        
+        Workload w;
+        for (size_t c = 0; c < couriers; c++) {
+            w.fleet.push_back({static_cast<uint32_t>(c + 1), restaurants[c % restaurants.size()], capacity, 6.0});
+        }
+        for (size_t i = 0; i < orders; i++) {
+            double u = uniform();
+            GeoPoint pickup = restaurants[static_cast<size_t>(u * u * restaurants.size())];
+            w.jobs.push_back({1000 + i, pickup, pointNear(1.0)});
+        }
+        return w;
+    }
+    
+    // Every feasible stop order for a single courier; only viable for a handful of jobs
+    static double exactCost(const Courier& courier, const vector<DeliveryJob>& jobs) {
+        double best = numeric_limits<double>::infinity();
+        vector<uint8_t> state(jobs.size(), 0);    // 0 waiting, 1 on board, 2 delivered
+        function<void(GeoPoint, double, double, uint32_t, size_t)> visit =
+            [&](GeoPoint at, double elapsed, double total, uint32_t load, size_t left) {
+                if (total >= best) return;
+                if (left == 0) {
+                    best = total;
+                    return;
+                }
+                for (size_t j = 0; j < jobs.size(); j++) {
+                    if (state[j] == 0 && load < courier.capacity) {
+                        double t = elapsed + at.metersTo(jobs[j].pickup) / courier.metersPerSecond;
+                        state[j] = 1;
+                        visit(jobs[j].pickup, t, total, load + 1, left);
+                        state[j] = 0;
+                    } else if (state[j] == 1) {
+                        double t = elapsed + at.metersTo(jobs[j].dropoff) / courier.metersPerSecond;
+                        state[j] = 2;
+                        visit(jobs[j].dropoff, t, total + t, load - 1, left - 1);
+                        state[j] = 1;
+                    }
+                }
+            };
+        visit(courier.position, 0, 0, 0, jobs.size());
+        return best;
+    }
+    
+    static void measureStream(size_t orders, chrono::microseconds budget) {
+        size_t couriers = max<size_t>(4, orders / 10);
+        Workload w = generate(orders, couriers, 3, 7);
+        Dispatcher dispatcher;
+        dispatcher.setFleet(w.fleet);
+        
+        vector<double> latencies;
+        latencies.reserve(orders);
+        auto start = chrono::steady_clock::now();
+        size_t rejected = 0, nextCourier = 0;
+        for (size_t i = 0; i < w.jobs.size(); i++) {
+            auto addStart = chrono::steady_clock::now();
+            rejected += !dispatcher.addJob(w.jobs[i], budget);
+            latencies.push_back(secondsSince(addStart));
+            // Couriers keep moving while orders arrive: each order means two stops served
+            for (size_t k = 0; k < 2; k++) {
+                dispatcher.completeNextStop(static_cast<uint32_t>(nextCourier++ % couriers));
+            }
+        }
+        double seconds = secondsSince(start);
+        sort(latencies.begin(), latencies.end());
+        
+        double incremental = dispatcher.totalCost();
+        Dispatcher resolved = dispatcher;
+        auto resolveStart = chrono::steady_clock::now();
+        resolved.reoptimize(chrono::seconds(5));
+        double resolveSeconds = secondsSince(resolveStart);
+        double reference = resolved.totalCost();
+        
+        cout << "  " << orders << " orders, " << couriers << " couriers, budget " << budget.count()
+             << " us: " << static_cast<uint64_t>(orders / seconds) << " orders/s, p50 "
+             << percentile(latencies, 0.5) * 1e6 << " us, p99 " << percentile(latencies, 0.99) * 1e6 << " us\n";
+        cout << "    open plan: " << dispatcher.jobCount() << " orders, cost " << incremental / 60
+             << " customer-minutes; long re-optimisation (" << resolveSeconds << " s) reaches "
+             << reference / 60 << " (gap " << (reference > 0 ? (incremental / reference - 1) * 100 : 0)
+             << "%), " << dispatcher.waitingCount() << " waiting" << (rejected ? ", " + to_string(rejected) + " rejected" : "")
+             << "\n";
+    }
+    
+    static void measureExact(size_t instances) {
+        double worstGap = 0, sumGap = 0;
+        size_t optimal = 0;
+        for (size_t i = 0; i < instances; i++) {
+            size_t jobCount = 2 + i % 3;
+            Workload w = generate(jobCount, 1, 2, 100 + i);
+            Dispatcher dispatcher;
+            dispatcher.setFleet(w.fleet);
+            for (const auto& job : w.jobs) dispatcher.addJob(job, chrono::milliseconds(10));
+            
+            double exact = exactCost(w.fleet[0], w.jobs);
+            double gap = exact > 0 ? dispatcher.totalCost() / exact - 1 : 0;
+            optimal += gap < 1e-9;
+            sumGap += gap;
+            worstGap = max(worstGap, gap);
+        }
+        cout << "  vs exhaustive search (" << instances << " instances, 1 courier, 2-4 orders): optimal in "
+             << optimal << ", mean gap " << sumGap / instances * 100 << "%, worst " << worstGap * 100 << "%\n";
+    }
+    
+public:
+    static void run(size_t orders) {
+        cout << "Courier dispatch (objective: summed customer arrival time)\n";
+        measureExact(300);
+        measureStream(orders, chrono::microseconds(0));
+        measureStream(orders, chrono::microseconds(500));
+        measureStream(orders, chrono::microseconds(2000));
+    }
+};
+
+class SpatialBenchmark {
+public:
+    // n restaurants spread over a 600 x 600 km region
+    static bool run(size_t n) {
+        uint64_t state = 99;
+        auto uniform = [&state]() { return static_cast<double>((state = mixHash(state + 1)) >> 11) / (1ULL << 53); };
+        auto randomPoint = [&]() { return GeoPoint(30 + uniform() * 5.4, 70 + uniform() * 6.4); };
+        
+        vector<SpatialIndex::Entry> points(n);
+        for (size_t i = 0; i < n; i++) points[i] = {randomPoint(), i + 1};
+        vector<SpatialIndex::Entry> reference = points;
+        
+        SpatialIndex index;
+        auto start = chrono::steady_clock::now();
+        index.build(move(points));
+        cout << "Packed R-tree over " << n << " restaurants built in " << secondsSince(start) * 1e3 << " ms\n";
+        
+        const size_t queries = 1000, k = 10;
+        const double radius = 5000;
+        vector<GeoPoint> centers(queries);
+        for (auto& c : centers) c = randomPoint();
+        
+        size_t found = 0;
+        start = chrono::steady_clock::now();
+        for (const auto& c : centers) found += index.nearest(c, k).size();
+        double nearestSeconds = secondsSince(start);
+        
+        size_t within = 0;
+        start = chrono::steady_clock::now();
+        for (const auto& c : centers) {
+            index.forEachWithin(c, radius, [&within](const SpatialIndex::Entry&, double) { within++; });
+        }
+        double withinSeconds = secondsSince(start);
+        
+        // Brute force on a sample for correctness and a baseline
+        const size_t checked = min<size_t>(queries, 50);
+        size_t mismatches = 0;
+        vector<double> distances(n);
+        start = chrono::steady_clock::now();
+        for (size_t q = 0; q < checked; q++) {
+            for (size_t i = 0; i < n; i++) distances[i] = centers[q].metersTo(reference[i].point);
+            size_t inRadius = count_if(distances.begin(), distances.end(), [&](double d) { return d <= radius; });
+            size_t kth = min(k, n);
+            nth_element(distances.begin(), distances.begin() + (kth ? kth - 1 : 0), distances.end());
+            auto result = index.nearest(centers[q], k);
+            if (result.size() != kth || (kth && fabs(result.back().meters - distances[kth - 1]) > 1e-6)) {
+                mismatches++;
+            }
+            size_t indexed = 0;
+            index.forEachWithin(centers[q], radius, [&indexed](const SpatialIndex::Entry&, double) { indexed++; });
+            mismatches += indexed != inRadius;
+        }
+        double scanSeconds = secondsSince(start);
+        
+        cout << "Per query (" << queries << " random points, microseconds)\n";
+        cout << "  " << k << " nearest: " << nearestSeconds * 1e6 / queries << " (" << found / queries
+             << " found)\n";
+        cout << "  within " << radius / 1000 << " km: " << withinSeconds * 1e6 / queries << " ("
+             << static_cast<double>(within) / queries << " found on average)\n";
+        cout << "  linear scan baseline: " << scanSeconds * 1e6 / checked << "\n";
+        cout << "  mismatches vs brute force (" << checked << " queries): " << mismatches << "\n";
+        return mismatches == 0;
+    }
+};
+
+class SortBenchmark {
+private:
+    template<typename T, typename Sort>
+    static double timeSort(const vector<T>& input, const vector<T>& expected, Sort sortFn, bool& ok) {
+        vector<T> data = input;
+        auto start = chrono::steady_clock::now();
+        sortFn(data);
+        double seconds = secondsSince(start);
+        ok = ok && data == expected;
+        return seconds;
+    }
+    
+    static bool compareKeys(const char* label, const vector<uint64_t>& input, ThreadPool& pool) {
+        vector<uint64_t> expected = input;
+        stable_sort(expected.begin(), expected.end());
+        bool ok = true;
+        auto ms = [](double seconds) { return seconds * 1e3; };
+        
+        cout << "  " << label << " (ms): merge sort "
+             << ms(timeSort(input, expected, [](auto& v) {
+                    SortingAlgorithms::mergeSort(v, 0, static_cast<int>(v.size()) - 1);
+                }, ok))
+             << ", std::stable_sort "
+             << ms(timeSort(input, expected, [](auto& v) { stable_sort(v.begin(), v.end()); }, ok))
+             << ", hybrid " << ms(timeSort(input, expected, [](auto& v) { SortingAlgorithms::hybridSort(v); }, ok))
+             << ", hybrid parallel "
+             << ms(timeSort(input, expected, [&pool](auto& v) { SortingAlgorithms::hybridSort(v, less<>(), &pool); }, ok))
+             << (ok ? "" : "  MISMATCH") << "\n";
+        return ok;
+    }
+    
+public:
+    static bool run(size_t n) {
+        ThreadPool pool;
+        uint64_t state = 7;
+        auto random = [&state]() { return state = mixHash(state + 1); };
+        
+        cout << "Sorting " << n << " keys, " << pool.size() << " threads for the parallel mode\n";
+        vector<uint64_t> keys(n);
+        for (auto& k : keys) k = random() % (n * 4 + 1);
+        bool keysOk = compareKeys("random", keys, pool);
+        
+        sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < n / 100; i++) swap(keys[random() % n], keys[random() % n]);
+        keysOk &= compareKeys("1% out of place", keys, pool);
+        
+        reverse(keys.begin(), keys.end());
+        keysOk &= compareKeys("mostly descending", keys, pool);
+        
+        // Whole restaurants, where every copy drags strings and a menu along
+        size_t m = max<size_t>(1, n / 20);
+        vector<Restaurant> restaurants;
+        restaurants.reserve(m);
+        for (size_t i = 0; i < m; i++) {
+            Restaurant r(i + 1, "Restaurant " + to_string(i), (random() % 50) / 10.0, "Street " + to_string(i));
+            r.addMenuItem(MenuItem("Burger", Money::cents(1299), "Fast Food"));
+            r.addMenuItem(MenuItem("Pizza", Money::cents(1850), "Italian"));
+            r.addMenuItem(MenuItem("Salad", Money::cents(875), "Healthy"));
+            restaurants.push_back(move(r));
+        }
+        bool ok = true;
+        auto timeObjects = [&](auto sortFn) {
+            vector<Restaurant> data = restaurants;
+            auto start = chrono::steady_clock::now();
+            sortFn(data);
+            double seconds = secondsSince(start);
+            ok = ok && is_sorted(data.begin(), data.end());
+            return seconds * 1e3;
+        };
+        double mergeMs = timeObjects([](auto& v) {
+            SortingAlgorithms::mergeSort(v, 0, static_cast<int>(v.size()) - 1);
+        });
+        double stableMs = timeObjects([](auto& v) { stable_sort(v.begin(), v.end()); });
+        double hybridMs = timeObjects([](auto& v) { SortingAlgorithms::hybridSort(v); });
+        
+        auto start = chrono::steady_clock::now();
+        vector<uint32_t> order = SortingAlgorithms::sortedOrder(restaurants, [](const Restaurant& r) { return -r.rating; });
+        double keyMs = secondsSince(start) * 1e3;
+        for (size_t i = 1; i < order.size(); i++) {
+            ok = ok && !(restaurants[order[i]] < restaurants[order[i - 1]]);
+        }
+        
+        cout << "  " << m << " restaurants by rating (ms): merge sort " << mergeMs << ", std::stable_sort "
+             << stableMs << ", hybrid " << hybridMs << ", (rating, index) keys " << keyMs
+             << (ok ? "" : "  MISMATCH") << "\n";
+        return keysOk && ok;
+    }
+};
+
+// Small, deterministic correctness checks that need no input files, for CI:
+// log replay (including a replaced menu and a torn tail), the snapshot round
+// trip, HTTP request parsing, and the route planners against Dijkstra.
+// Prints one line per check and returns false if any failed.
+class SelfTest {
+private:
+    static constexpr const char* SCRATCH_DIR = "self_test";
+    
+    // An order as read back, with the names its lines resolve to
+    struct Expected {
+        Order order;
+        vector<string> items;
+    };
+    
+    static Expected capture(FoodDeliverySystem& system, EntityId orderId) {
+        Expected e;
+        if (!system.findOrder(orderId, e.order)) return e;
+        for (const auto& line : e.order.lines) {
+            const MenuItem* item = system.orderedItem(e.order, line);
+            e.items.push_back(item ? string(item->name.text()) : string());
+        }
+        return e;
+    }
+    
+    static size_t differences(FoodDeliverySystem& system, const vector<Expected>& expected) {
+        size_t differing = 0;
+        for (const auto& want : expected) {
+            Expected got = capture(system, want.order.orderId);
+            const Order& a = want.order;
+            const Order& b = got.order;
+            bool same = b.orderId == a.orderId && b.customerId == a.customerId && b.restaurantId == a.restaurantId &&
+                        b.status == a.status && b.updatedAt == a.updatedAt && b.totalAmount == a.totalAmount &&
+                        b.lines.size() == a.lines.size() && got.items == want.items;
+            for (size_t i = 0; same && i < a.lines.size(); i++) {
+                same = b.lines[i].item == a.lines[i].item && b.lines[i].price == a.lines[i].price;
+            }
+            differing += !same;
+        }
+        return differing;
+    }
+    
+    static bool report(const char* check, size_t failures) {
+        cout << "  " << check << ": " << (failures ? "FAILED (" + to_string(failures) + ")" : string("ok")) << "\n";
+        return failures == 0;
+    }
+    
+    // Three restaurants, four customers and a dozen orders in assorted
+    // states, then one restaurant replaced and ordered from again
+    static vector<Expected> populate(FoodDeliverySystem& system, size_t& failures) {
+        static const char* dishes[] = {"Chicken Karahi", "Seekh Kebab", "Garlic Naan"};
+        vector<EntityId> restaurants, customers, orders;
+        system.beginBatch();
+        for (size_t r = 0; r < 3; r++) {
+            Restaurant restaurant(0, "Restaurant " + to_string(r), 4.0 + r * 0.2, "Street " + to_string(r));
+            restaurant.location = GeoPoint(33.68 + r * 0.01, 73.04 + r * 0.01);
+            for (size_t d = 0; d < 3; d++) {
+                restaurant.addMenuItem(MenuItem(dishes[d], Money::cents(450 + 125 * (r + d)), "Pakistani"));
+            }
+            restaurants.push_back(system.addRestaurant(move(restaurant)));
+        }
+        for (size_t c = 0; c < 4; c++) {
+            Customer customer(0, "Customer " + to_string(c), "0300-555000" + to_string(c), "House " + to_string(c));
+            customer.location = GeoPoint(33.70 - c * 0.005, 73.06 - c * 0.005);
+            customers.push_back(system.addCustomer(move(customer)));
+        }
+        for (uint32_t i = 0; i < 12; i++) {
+            EntityId id = system.placeOrder(customers[i % 4], restaurants[i % 3], {i % 3, (i + 1) % 3});
+            failures += id == 0;
+            if (!id) continue;
+            orders.push_back(id);
+            if (i % 4 == 3) failures += system.setOrderStatus(id, OrderStatus::Cancelled) != OrderLifecycle::Result::Ok;
+            for (uint32_t step = 0; step < i % 4 && i % 4 != 3; step++) {
+                failures += system.setOrderStatus(id, static_cast<OrderStatus>(step + 1)) != OrderLifecycle::Result::Ok;
+            }
+        }
+        
+        // Positions 0 and 2 are retired, 1 takes the new price, 3 is new
+        Restaurant replacement(restaurants[0], "Restaurant 0", 4.5, "Street 0");
+        replacement.location = GeoPoint(33.68, 73.04);
+        replacement.addMenuItem(MenuItem(dishes[1], Money::cents(999), "Pakistani"));
+        replacement.addMenuItem(MenuItem("Chapli Kebab", Money::cents(650), "Pakistani"));
+        system.addRestaurant(move(replacement));
+        EntityId id = system.placeOrder(customers[0], restaurants[0], {0, 1, 3});
+        if (id) orders.push_back(id);
+        system.endBatch();
+        
+        vector<Expected> expected;
+        for (EntityId orderId : orders) expected.push_back(capture(system, orderId));
+        failures += !id || expected.back().order.lines.size() != 2 || expected.back().items[1] != "Chapli Kebab";
+        failures += expected.front().items[0] != dishes[0];
+        return expected;
+    }
+    
+    static bool checkRouting() {
+        size_t mismatches = RoutingBenchmark::zeroLengthMismatches();
+        RouteWorkspace ws;
+        
+        // Two roads of the longest accepted length: a sum that wrapped
+        // around would come out short instead of unreachable
+        RoadGraph chain;
+        chain.build({1, 2, 3}, {}, {}, {{0, 1, UNREACHABLE - 1}, {1, 2, UNREACHABLE - 1}, {0, 2, 5}, {2, 0, 5}});
+        ContractionHierarchy chainHierarchy;
+        chainHierarchy.build(chain);
+        for (uint32_t a = 0; a < 3; a++) {
+            for (uint32_t b = 0; b < 3; b++) {
+                uint32_t expected = ShortestPaths::dijkstra(chain, a, b, ws);
+                mismatches += chainHierarchy.query(a, b, ws) != expected;
+            }
+        }
+        mismatches += ShortestPaths::dijkstra(chain, 0, 1, ws) != UNREACHABLE - 1;
+        mismatches += ShortestPaths::dijkstra(chain, 2, 1, ws) != UNREACHABLE;
+        
+        RoadGraph graph = RoadGraph::grid(12, 7);
+        ContractionHierarchy hierarchy;
+        hierarchy.build(graph);
+        uint64_t state = 5;
+        for (size_t i = 0; i < 200; i++) {
+            uint32_t a = static_cast<uint32_t>((state = mixHash(state + 1)) % graph.nodeCount());
+            uint32_t b = static_cast<uint32_t>((state = mixHash(state + 1)) % graph.nodeCount());
+            uint32_t expected = ShortestPaths::dijkstra(graph, a, b, ws);
+            mismatches += ShortestPaths::aStar(graph, a, b, ws) != expected;
+            mismatches += hierarchy.query(a, b, ws) != expected;
+        }
+        return report("routes vs Dijkstra", mismatches);
+    }
+    
+public:
+    static bool run() {
+        filesystem::create_directories(SCRATCH_DIR);
+        filesystem::current_path(SCRATCH_DIR);
+        remove("system.snap");
+        remove("system.wal");
+        cout << "Self-test\n";
+        
+        bool ok = true;
+        vector<Expected> expected;
+        size_t failures = 0;
+        {
+            FoodDeliverySystem system;
+            expected = populate(system, failures);
+        }
+        ok &= report("changes through the programmatic API", failures);
+        {
+            FoodDeliverySystem replayed;
+            ok &= report("log replay", differences(replayed, expected));
+            ok &= report("snapshot written", !replayed.writeSnapshot());
+        }
+        {
+            FoodDeliverySystem restored;
+            ok &= report("snapshot round trip", differences(restored, expected));
+            
+            // Later changes land in the emptied log on top of the snapshot
+            Order& last = expected.back().order;
+            failures = restored.setOrderStatus(last.orderId, OrderStatus::Accepted) != OrderLifecycle::Result::Ok;
+            expected.back() = capture(restored, last.orderId);
+            failures += expected.back().order.status != OrderStatus::Accepted;
+            ok &= report("change after the snapshot", failures);
+        }
+        {
+            // Half a frame at the end of the log, as a crash mid-write leaves it
+            ofstream tail("system.wal", ios::binary | ios::app);
+            tail.write("\x20\0\0\0\x7f", 5);
+        }
+        {
+            FoodDeliverySystem recovered;
+            ok &= report("snapshot plus log with a torn tail", differences(recovered, expected));
+        }
+        remove("system.snap");
+        remove("system.wal");
+        filesystem::current_path("..");
+
+#ifdef FDS_HAVE_EPOLL
+        ok &= report("HTTP request parsing", OrderServer::parserMismatches());
+#endif
+        ok &= checkRouting();
+        cout << (ok ? "All checks passed\n" : "Some checks FAILED\n");
+        return ok;
+    }
+};
+
+// Benchmark suite over the operations the system actually performs. Each
+// case is prepared once per dataset size outside the clock, then timed in
+// batches: every batch is one sample in nanoseconds per operation, and
+// percentiles are taken over the samples of all measured repetitions.
+// Warmup repetitions run the same code and are discarded.
+//
+//   --bench [--sizes 1000,10000,...] [--repetitions N] [--warmup N]
+//           [--only name,...] [--json file|-]
+class BenchmarkSuite {
+public:
+    struct Options {
+        vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+        size_t repetitions = 5;
+        size_t warmup = 1;
+        vector<string> only;
+        string jsonPath;    // "-" writes JSON to stdout instead of the table
+    };
+    
+    // Collects ns/op samples; time() runs fn once and records it as `ops` operations
+    class Samples {
+    private:
+        vector<double> nsPerOp;
+        bool recording = true;
+        
+    public:
+        template<typename F>
+        void time(size_t ops, F fn) {
+            auto start = chrono::steady_clock::now();
+            fn();
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            if (recording && ops > 0) nsPerOp.push_back(ns / ops);
+        }
+        
+        void setRecording(bool on) { recording = on; }
+        vector<double>& values() { return nsPerOp; }
+    };
+    
+private:
+    // A prepared case: state lives in the closure, each call is one repetition
+    using Runner = function<void(Samples&)>;
+    
+    struct Case {
+        string name;
+        size_t maxSize;     // larger sizes are skipped (setup would dominate the run)
+        function<Runner(size_t)> prepare;
+    };
+    
+    struct Result {
+        string name;
+        size_t size;
+        size_t samples;
+        double min, mean, p50, p90, p99, max;
+    };
+    
+    // Keeps results alive so the optimizer cannot drop the work
+    static void consume(uint64_t value) {
+        static volatile uint64_t sink;
+        sink = sink + value;
+    }
+    
+    static uint64_t randomAt(uint64_t i) { return mixHash(i * 0x9E3779B97F4A7C15ULL + 1); }
+    
+    static vector<Case> cases() {
+        const size_t BATCH = 1024;
+        vector<Case> all;
+        
+        all.push_back({"hash_lookup", SIZE_MAX, [](size_t n) -> Runner {
+            auto table = make_shared<HashTable<uint64_t, EntityId>>(n);
+            for (size_t i = 0; i < n; i++) table->insert(randomAt(i), i);
+            return [table, n](Samples& samples) {
+                for (size_t b = 0; b < max<size_t>(1, 1000000 / BATCH); b++) {
+                    uint64_t found = 0;
+                    samples.time(BATCH, [&] {
+                        for (size_t i = 0; i < BATCH; i++) {
+                            const uint64_t* v = table->search(randomAt((b * BATCH + i) % n));
+                            found += v ? *v : 0;
+                        }
+                    });
+                    consume(found);
+                }
+            };
+        }});
+        
+        all.push_back({"order_placement", 1000000, [](size_t n) -> Runner {
+            return [n](Samples& samples) {
+                const string walPath = "bench_suite.wal";
+                remove(walPath.c_str());
+                WalOptions options;
+                options.sync = WalOptions::Sync::None;
+                WriteAheadLog wal;
+                wal.open(walPath, options, 0);
+                OrderLifecycle orders(wal, nullptr);
+                
+                for (size_t begin = 0; begin < n; begin += BATCH) {
+                    size_t end = min(n, begin + BATCH);
+                    samples.time(end - begin, [&] {
+                        for (size_t i = begin; i < end; i++) {
+                            Order order(1700000000000ULL + i, 1749809397841ULL, 1 + i % 100);
+                            order.addLine(0, Money::cents(1299));
+                            order.addLine(1, Money::cents(875));
+                            order.saveToLog(wal);
+                            orders.add(move(order));
+                        }
+                    });
+                }
+                consume(orders.count(OrderStatus::Pending));
+                wal.close();
+                remove(walPath.c_str());
+            };
+        }});
+        
+        all.push_back({"order_queue", SIZE_MAX, [](size_t n) -> Runner {
+            Order prototype(0, 1749809397841ULL, 1);
+            prototype.addLine(0, Money::cents(1299));
+            return [n, prototype](Samples& samples) {
+                PooledDeque<Order> queue;
+                vector<Handle> handles(n);
+                for (size_t begin = 0; begin < n; begin += BATCH) {
+                    size_t end = min(n, begin + BATCH);
+                    samples.time(end - begin, [&] {
+                        for (size_t i = begin; i < end; i++) handles[i] = queue.pushBack(prototype);
+                    });
+                }
+                // Cancel every other order by handle, serve the rest from the front
+                for (size_t begin = 0; begin < n; begin += BATCH) {
+                    size_t end = min(n, begin + BATCH);
+                    samples.time(end - begin, [&] {
+                        for (size_t i = begin; i < end; i++) {
+                            if (i % 2 == 0) queue.remove(handles[i]);
+                            else consume(queue.popFront().orderId);
+                        }
+                    });
+                }
+            };
+        }});
+        
+        all.push_back({"restaurant_load", 1000000, [](size_t n) -> Runner {
+            const string path = "bench_suite_restaurants.dat";
+            LoaderBenchmark::generateFile(path, SIZE_MAX, n);
+            auto pool = make_shared<ThreadPool>();
+            return [path, n, pool](Samples& samples) {
+                EntityStore store;
+                samples.time(n, [&] { ParallelLoader::loadRestaurants(path, store, pool.get()); });
+                consume(store.restaurantCount());
+            };
+        }});
         
-        string id = generateId();
-        Restaurant restaurant(id, name, rating, address);
+        all.push_back({"menu_query", 10000000, [](size_t n) -> Runner {
+            // n menu items: eight per restaurant
+            static const char* dishes[] = {"Chicken Burger", "Pizza Margherita", "Garden Salad", "Chicken Biryani",
+                                           "Mutton Karahi", "Pasta Alfredo", "Beef Wrap", "Lentil Soup"};
+            static const char* categories[] = {"Fast Food", "Italian", "Healthy", "Desi"};
+            auto index = make_shared<MenuIndex>();
+            auto search = make_shared<MenuSearch>();
+            vector<MenuEntry> entries;
+            for (size_t r = 0; r * 8 < n; r++) {
+                Restaurant restaurant(r + 1, "Restaurant " + to_string(r), 4.0, "Street");
+                for (size_t i = 0; i < 8; i++) {
+                    restaurant.addMenuItem(MenuItem(dishes[(r + i) % 8], Money::cents(500 + (r * 7 + i) % 2000),
+                                                    categories[(r + i) % 4]));
+                    entries.emplace_back(restaurant.menu.back().price, restaurant.id, restaurant.menu.back().name,
+                                         restaurant.menu.back().category);
+                }
+                search->addRestaurant(restaurant);
+            }
+            index->build(move(entries));
+            
+            return [index, search](Samples& samples) {
+                const size_t queries = 256;
+                for (size_t b = 0; b < 20; b++) {
+                    uint64_t seen = 0;
+                    samples.time(queries, [&] {
+                        for (size_t q = 0; q < queries; q++) {
+                            Money low = Money::cents(500 + randomAt(b * queries + q) % 2000);
+                            size_t taken = 0;
+                            index->forEachInRange(low, low + Money::cents(5), [&](const MenuEntry&) { taken++; });
+                            index->forEachCheapest(10, [&](const MenuEntry&) { taken++; });
+                            auto page = search->search(q % 2 ? "chicken bir" : "pasta", MenuSearch::Filter(), 0, 10,
+                                                       [](EntityId) { return 4.0; });
+                            seen += taken + page.hits.size();
+                        }
+                    });
+                    consume(seen);
+                }
+            };
+        }});
+        
+        all.push_back({"menu_prefix", 1000000, [](size_t n) -> Runner {
+            // Type-ahead: n items named from 4096 distinct words starting
+            // with 'c', so a one-letter prefix matches thousands of terms
+            auto search = make_shared<MenuSearch>();
+            for (size_t r = 0; r * 8 < n; r++) {
+                Restaurant restaurant(r + 1, "Restaurant " + to_string(r), 4.0, "Street");
+                for (size_t i = 0; i < 8; i++) {
+                    size_t word = randomAt(r * 8 + i) % 4096;
+                    string name = "c";
+                    for (size_t k = 0; k < 3; k++, word /= 16) name += static_cast<char>('a' + word % 16);
+                    restaurant.addMenuItem(MenuItem(name, Money::cents(500 + i * 100), "Desi"));
+                }
+                search->addRestaurant(restaurant);
+            }
+            
+            return [search](Samples& samples) {
+                static const char* prefixes[] = {"c", "ca", "cab"};
+                const size_t queries = 16;
+                for (size_t b = 0; b < 10; b++) {
+                    uint64_t seen = 0;
+                    samples.time(queries, [&] {
+                        for (size_t q = 0; q < queries; q++) {
+                            auto page = search->search(prefixes[q % 3], MenuSearch::Filter(), 0, 10,
+                                                       [](EntityId) { return 4.0; });
+                            seen += page.hits.size();
+                        }
+                    });
+                    consume(seen);
+                }
+            };
+        }});
         
-        restaurant.addMenuItem(MenuItem("Burger", 12.99, "Fast Food"));
-        restaurant.addMenuItem(MenuItem("Pizza", 18.50, "Italian"));
-        restaurant.addMenuItem(MenuItem("Salad", 8.75, "Healthy"));
+        all.push_back({"sort_hybrid", 10000000, [](size_t n) -> Runner {
+            auto input = make_shared<vector<uint64_t>>(n);
+            for (size_t i = 0; i < n; i++) (*input)[i] = randomAt(i);
+            return [input, n](Samples& samples) {
+                vector<uint64_t> data = *input;
+                samples.time(n, [&] { SortingAlgorithms::hybridSort(data); });
+                consume(data[n / 2]);
+            };
+        }});
         
-        restaurants.insert(id, restaurant);
-        restaurant.saveToFile();
+        all.push_back({"sort_restaurant_keys", 1000000, [](size_t n) -> Runner {
+            auto restaurants = make_shared<vector<Restaurant>>();
+            restaurants->reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                restaurants->emplace_back(i + 1, "Restaurant " + to_string(i), randomAt(i) % 50 / 10.0, "Street");
+            }
+            return [restaurants, n](Samples& samples) {
+                vector<uint32_t> order;
+                samples.time(n, [&] {
+                    order = SortingAlgorithms::sortedOrder(*restaurants, [](const Restaurant& r) { return -r.rating; });
+                });
+                consume(order[n / 2]);
+            };
+        }});
         
-        for (const auto& item : restaurant.menu) {
-            menuSearchTree.insert(item);
+        all.push_back({"routing_query", 1000000, [](size_t n) -> Runner {
+            // A square grid city with about n junctions
+            uint32_t side = max<uint32_t>(2, static_cast<uint32_t>(sqrt(static_cast<double>(n))));
+            const string path = "bench_suite.roads";
+            RoadGraph::grid(side, 42).save(path);
+            auto graph = make_shared<RoadGraph>();
+            graph->load(path);
+            remove(path.c_str());
+            auto hierarchy = make_shared<ContractionHierarchy>();
+            hierarchy->build(*graph);
+            
+            return [graph, hierarchy](Samples& samples) {
+                RouteWorkspace ws;
+                const size_t queries = 64;
+                uint32_t nodes = graph->nodeCount();
+                for (size_t b = 0; b < 10; b++) {
+                    uint64_t meters = 0;
+                    samples.time(queries, [&] {
+                        for (size_t q = 0; q < queries; q++) {
+                            uint64_t r = randomAt(b * queries + q);
+                            meters += hierarchy->query(r % nodes, (r >> 32) % nodes, ws);
+                        }
+                    });
+                    consume(meters);
+                }
+            };
+        }});
+        return all;
+    }
+    
+    static void writeJson(ostream& out, const Options& options, const vector<Result>& results) {
+        out << "{\n  \"suite\": \"food-delivery-system\",\n  \"timestamp\": " << time(nullptr)
+            << ",\n  \"threads\": " << ThreadPool::defaultThreads()
+            << ",\n  \"repetitions\": " << options.repetitions << ",\n  \"warmup\": " << options.warmup
+            << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"samples\": " << r.samples
+                << ", \"ns_per_op\": {\"min\": " << r.min << ", \"mean\": " << r.mean << ", \"p50\": " << r.p50
+                << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99 << ", \"max\": " << r.max
+                << "}, \"ops_per_second\": " << (r.mean > 0 ? 1e9 / r.mean : 0) << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
         }
-        
-        cout << "Restaurant added successfully with ID: " << id << "\n";
+        out << "  ]\n}\n";
     }
     
-    void addCustomer() {
-        string name, phone, address;
-        
-        cout << "\n=== ADD NEW CUSTOMER ===\n";
-        cout << "Enter customer name: ";
-        cin.ignore();
-        getline(cin, name);
-        cout << "Enter phone number: ";
-        getline(cin, phone);
-        cout << "Enter address: ";
-        getline(cin, address);
-        
-        string id = generateId();
-        Customer customer(id, name, phone, address);
-        
-        customers.insert(id, customer);
-        customer.saveToFile();
-        
-        cout << "Customer added successfully with ID: " << id << "\n";
+public:
+    // Parses the flags after --bench; false (with a message) on bad input
+    static bool parseOptions(int argc, char* argv[], Options& options) {
+        auto list = [](const string& text) {
+            vector<string> items;
+            string_view rest = text;
+            while (!rest.empty()) items.emplace_back(nextField(rest));
+            return items;
+        };
+        return parseFlags(argc, argv, {}, [&](const string& flag, const string& value) {
+            if (flag == "--sizes") {
+                options.sizes.clear();
+                for (const auto& item : list(value)) {
+                    uint64_t size;
+                    if (!parseUnsigned(item, size) || size == 0) return false;
+                    options.sizes.push_back(size);
+                }
+            } else if (flag == "--repetitions" || flag == "--warmup") {
+                uint64_t count;
+                if (!parseUnsigned(value, count) || (flag == "--repetitions" && count == 0)) return false;
+                (flag == "--repetitions" ? options.repetitions : options.warmup) = count;
+            } else if (flag == "--only") {
+                options.only = list(value);
+            } else if (flag == "--json") {
+                options.jsonPath = value;
+            } else {
+                return false;
+            }
+            return true;
+        });
     }
     
-    void placeOrder() {
-        string customerId, restaurantId;
+    static void run(const Options& options) {
+        bool tableToStdout = options.jsonPath != "-";
+        ostream& log = tableToStdout ? cout : cerr;
+        vector<Result> results;
         
-        cout << "\n=== PLACE NEW ORDER ===\n";
-        cout << "Enter customer ID: ";
-        cin >> customerId;
+        for (const Case& c : cases()) {
+            if (!options.only.empty() && find(options.only.begin(), options.only.end(), c.name) == options.only.end()) {
+                continue;
+            }
+            for (size_t size : options.sizes) {
+                if (size > c.maxSize) continue;
+                Runner runner = c.prepare(size);
+                Samples samples;
+                samples.setRecording(false);
+                for (size_t i = 0; i < options.warmup; i++) runner(samples);
+                samples.setRecording(true);
+                for (size_t i = 0; i < options.repetitions; i++) runner(samples);
+                
+                vector<double>& v = samples.values();
+                if (v.empty()) continue;
+                sort(v.begin(), v.end());
+                double sum = 0;
+                for (double x : v) sum += x;
+                Result r{c.name, size, v.size(), v.front(), sum / v.size(),
+                         percentile(v, 0.5), percentile(v, 0.9), percentile(v, 0.99), v.back()};
+                results.push_back(r);
+                log << left << setw(22) << r.name << right << setw(10) << r.size << "  p50 " << setw(10) << r.p50
+                    << " ns  p90 " << setw(10) << r.p90 << " ns  p99 " << setw(10) << r.p99 << " ns  ("
+                    << r.samples << " samples)\n";
+            }
+        }
+        remove("bench_suite_restaurants.dat");
         
-        Customer* customer = customers.search(customerId);
-        if (!customer) {
-            cout << "Customer not found!\n";
+        if (options.jsonPath.empty()) return;
+        if (options.jsonPath == "-") {
+            writeJson(cout, options, results);
             return;
         }
+        ofstream file(options.jsonPath);
+        writeJson(file, options, results);
+        log << "Results written to " << options.jsonPath << "\n";
+    }
+};
+
+// Synthetic workload: restaurants, menus and customers written in the
+// regular restaurants.dat / customers.txt formats, plus a day of orders
+// whose arrivals peak at lunch and dinner and whose restaurant choice
+// follows a Zipf distribution. The replay driver loads the files into a
+// FoodDeliverySystem and drives its API with every placement and status
+// change, either flat out or paced against the simulated clock.
+//
+//   --workload [--dir D] [--restaurants N] [--customers N] [--orders N]
+//              [--zipf S] [--speedup X] [--seed N] [--sync none|group] [--force]
+//
+// The run overwrites the directory's data files and starts from an empty
+// log, so a directory that already holds a snapshot or a log is refused
+// unless --force is given.
+class WorkloadDriver {
+public:
+    struct Options {
+        string dir = "workload";
+        size_t restaurants = 2000;
+        size_t customers = 50000;
+        size_t orders = 100000;
+        double zipf = 1.1;      // popularity exponent; 0 is uniform
+        double speedup = 0;     // simulated seconds per real second; 0 replays flat out
+        uint64_t seed = 1;
+        WalOptions::Sync sync = WalOptions::Sync::None;
+        bool force = false;     // replace an existing snapshot and log
+    };
+    
+private:
+    struct Event {
+        double at;              // simulated seconds since midnight
+        uint32_t order;         // index into the generated order stream
+        OrderStatus status;     // Pending means "place the order"
+    };
+    
+    struct PlannedOrder {
+        EntityId customerId;
+        EntityId restaurantId;
+        vector<uint32_t> items;
+    };
+    
+    class Random {
+    private:
+        uint64_t state;
         
-        displayRestaurants();
-        cout << "Enter restaurant ID: ";
-        cin >> restaurantId;
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+        uint64_t next() { return state = mixHash(state + 0x9E3779B97F4A7C15ULL); }
+        double uniform() { return static_cast<double>(next() >> 11) / (1ULL << 53); }
+        size_t below(size_t n) { return next() % n; }
+    };
+    
+    // Samples index i with probability proportional to weights[i]
+    class Distribution {
+    private:
+        vector<double> cumulative;
         
-        Restaurant* restaurant = restaurants.search(restaurantId);
-        if (!restaurant) {
-            cout << "Restaurant not found!\n";
-            return;
+    public:
+        explicit Distribution(const vector<double>& weights) : cumulative(weights.size()) {
+            partial_sum(weights.begin(), weights.end(), cumulative.begin());
         }
         
-        string orderId = generateId();
-        Order order(orderId, customerId, restaurantId);
-        
-        cout << "\n=== MENU ===\n";
-        for (int i = 0; i < restaurant->menu.size(); i++) {
-            cout << i + 1 << ". " << restaurant->menu[i].name 
-                 << " - $" << restaurant->menu[i].price << "\n";
+        size_t sample(Random& random) const {
+            double u = random.uniform() * cumulative.back();
+            return min(cumulative.size() - 1,
+                       static_cast<size_t>(upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin()));
         }
+    };
+    
+    static string coordinates(Random& random) {
+        char text[48];
+        snprintf(text, sizeof(text), "%.5f,%.5f", 33.62 + random.uniform() * 0.14, 72.97 + random.uniform() * 0.17);
+        return text;
+    }
+    
+    // Returns each restaurant's menu size so orders pick valid items
+    static vector<uint32_t> writeRestaurants(const string& path, size_t count, Random& random) {
+        static const char* dishes[] = {"Chicken Burger", "Beef Burger", "Pizza Margherita", "Pepperoni Pizza",
+                                       "Garden Salad", "Chicken Biryani", "Mutton Karahi", "Daal Chawal",
+                                       "Pasta Alfredo", "Beef Wrap", "Lentil Soup", "Chicken Tikka",
+                                       "Seekh Kebab", "Fries", "Chocolate Shake", "Green Tea"};
+        static const char* categories[] = {"Fast Food", "Fast Food", "Italian", "Italian", "Healthy", "Desi",
+                                           "Desi", "Desi", "Italian", "Fast Food", "Healthy", "BBQ",
+                                           "BBQ", "Sides", "Drinks", "Drinks"};
+        const size_t dishCount = sizeof(dishes) / sizeof(dishes[0]);
         
-        int choice;
-        do {
-            cout << "Select item (1-" << restaurant->menu.size() << ", 0 to finish): ";
-            cin >> choice;
-            
-            if (choice > 0 && choice <= restaurant->menu.size()) {
-                order.addItem(restaurant->menu[choice - 1]);
-                cout << "Added " << restaurant->menu[choice - 1].name << " to order\n";
+        ofstream file(path, ios::binary);
+        vector<uint32_t> menuSizes(count);
+        char line[160];
+        for (size_t r = 0; r < count; r++) {
+            EntityId id = r + 1;
+            file << id << ",Restaurant " << id << "," << (30 + random.below(21)) / 10.0 << ",Street "
+                 << random.below(200) << " Sector " << char('A' + random.below(12)) << "," << coordinates(random)
+                 << "\n";
+            menuSizes[r] = static_cast<uint32_t>(5 + random.below(11));
+            size_t first = random.below(dishCount);
+            for (uint32_t i = 0; i < menuSizes[r]; i++) {
+                size_t dish = (first + i) % dishCount;
+                snprintf(line, sizeof(line), "MENU,%llu,%s,%.2f,%s\n", static_cast<unsigned long long>(id),
+                         dishes[dish], 2.0 + random.below(2500) / 100.0, categories[dish]);
+                file << line;
             }
-        } while (choice != 0);
-        
-        if (!order.items.empty()) {
-            pendingOrders.insert(order);
-            orderHistory.push(orderId);
-            order.saveToFile();
-            
-            cout << "Order placed successfully! Order ID: " << orderId << "\n";
-            cout << "Total amount: $" << order.totalAmount << "\n";
-        } else {
-            cout << "No items added to order.\n";
         }
+        return menuSizes;
     }
     
-    void displayRestaurants() {
-        cout << "\n=== AVAILABLE RESTAURANTS ===\n";
-        
-        vector<Restaurant> restaurantList = Restaurant::loadAllRestaurants();
-        SortingAlgorithms::mergeSort(restaurantList, 0, restaurantList.size() - 1);
-        
-        for (const auto& restaurant : restaurantList) {
-            cout << "ID: " << restaurant.id << " | " << restaurant.name 
-                 << " | Rating: " << restaurant.rating << "\n";
+    static void writeCustomers(const string& path, size_t count, Random& random) {
+        ofstream file(path, ios::binary);
+        for (size_t c = 0; c < count; c++) {
+            file << c + 1 << ",Customer " << c + 1 << ",9230" << 10000000 + random.below(90000000) << ",House "
+                 << random.below(500) << " Sector " << char('A' + random.below(12)) << "," << coordinates(random)
+                 << "\n";
         }
-        cout << "\n";
     }
     
-    void displayOrders() {
-        cout << "\n=== ORDER STATUS ===\n";
-        
-        cout << "PENDING ORDERS:\n";
-        vector<Order> pending = pendingOrders.traverse();
-        for (const auto& order : pending) {
-            cout << "Order ID: " << order.orderId << " | Status: " << order.status 
-                 << " | Amount: $" << order.totalAmount << "\n";
+    // Arrival rate by minute of the day: a low base with lunch and dinner peaks
+    static vector<double> arrivalProfile() {
+        vector<double> minutes(24 * 60);
+        auto peak = [](double minute, double center, double width) {
+            double z = (minute - center) / width;
+            return exp(-0.5 * z * z);
+        };
+        for (size_t m = 0; m < minutes.size(); m++) {
+            minutes[m] = 0.15 + 1.0 * peak(m, 13 * 60, 60) + 1.4 * peak(m, 20 * 60, 75);
         }
+        return minutes;
+    }
+    
+    static void planOrders(const Options& options, const vector<uint32_t>& menuSizes, Random& random,
+                           vector<PlannedOrder>& planned, vector<Event>& events) {
+        // Popularity ranks are shuffled so the favourites are not simply the lowest ids
+        vector<double> weights(options.restaurants);
+        for (size_t i = 0; i < weights.size(); i++) weights[i] = 1.0 / pow(i + 1.0, options.zipf);
+        for (size_t i = weights.size(); i > 1; i--) swap(weights[i - 1], weights[random.below(i)]);
+        Distribution restaurants(weights);
+        Distribution minutes(arrivalProfile());
         
-        cout << "\nCOMPLETED ORDERS:\n";
-        vector<Order> completed = completedOrders.traverse();
-        for (const auto& order : completed) {
-            cout << "Order ID: " << order.orderId << " | Status: " << order.status 
-                 << " | Amount: $" << order.totalAmount << "\n";
+        planned.reserve(options.orders);
+        events.reserve(options.orders * 5);
+        for (uint32_t i = 0; i < options.orders; i++) {
+            size_t r = restaurants.sample(random);
+            PlannedOrder order{random.below(options.customers) + 1, r + 1, {}};
+            size_t itemCount = 1 + random.below(4);
+            for (size_t k = 0; k < itemCount; k++) {
+                order.items.push_back(static_cast<uint32_t>(random.below(menuSizes[r])));
+            }
+            planned.push_back(move(order));
+            
+            double at = minutes.sample(random) * 60.0 + random.uniform() * 60;
+            events.push_back({at, i, OrderStatus::Pending});
+            // About one order in twenty is cancelled before the kitchen starts
+            if (random.below(20) == 0) {
+                events.push_back({at + 30 + random.uniform() * 120, i, OrderStatus::Cancelled});
+                continue;
+            }
+            at += 30 + random.uniform() * 90;
+            events.push_back({at, i, OrderStatus::Accepted});
+            at += 60 + random.uniform() * 240;
+            events.push_back({at, i, OrderStatus::Preparing});
+            at += 600 + random.uniform() * 900;
+            events.push_back({at, i, OrderStatus::PickedUp});
+            at += 300 + random.uniform() * 1200;
+            events.push_back({at, i, OrderStatus::Delivered});
         }
-        cout << "\n";
+        SortingAlgorithms::hybridSort(events, [](const Event& a, const Event& b) { return a.at < b.at; });
     }
     
-    void searchMenuItems() {
-        cout << "\n=== MENU SEARCH (BST) ===\n";
+public:
+    static bool parseOptions(int argc, char* argv[], Options& options) {
+        return parseFlags(argc, argv, {"--force"}, [&options](const string& flag, const string& value) {
+            uint64_t number = 0;
+            double real = 0;
+            bool isNumber = parseUnsigned(value, number);
+            bool isReal = parseNumber(value, real) && real >= 0;
+            if (flag == "--force") {
+                options.force = true;
+            } else if (flag == "--dir") {
+                options.dir = value;
+            } else if (flag == "--restaurants" && isNumber && number > 0) {
+                options.restaurants = number;
+            } else if (flag == "--customers" && isNumber && number > 0) {
+                options.customers = number;
+            } else if (flag == "--orders" && isNumber) {
+                options.orders = number;
+            } else if (flag == "--seed" && isNumber) {
+                options.seed = number;
+            } else if (flag == "--zipf" && isReal) {
+                options.zipf = real;
+            } else if (flag == "--speedup" && isReal) {
+                options.speedup = real;
+            } else if (flag == "--sync" && (value == "none" || value == "group")) {
+                options.sync = value == "none" ? WalOptions::Sync::None : WalOptions::Sync::Group;
+            } else {
+                return false;
+            }
+            return true;
+        });
+    }
+    
+    // False, without touching anything, when the directory holds data and
+    // --force was not given
+    static bool run(const Options& options) {
+        error_code ec;
+        for (const char* file : {"system.snap", "system.wal"}) {
+            if (!options.force && filesystem::exists(filesystem::path(options.dir) / file, ec)) {
+                cerr << options.dir << " already holds " << file
+                     << "; the workload would overwrite it (use --force, or another --dir)\n";
+                return false;
+            }
+        }
+        Random random(options.seed);
+        filesystem::create_directories(options.dir);
+        filesystem::current_path(options.dir);
+        // A fresh run each time: no snapshot or log from a previous replay
+        remove("system.snap");
+        remove("system.wal");
+        
+        auto start = chrono::steady_clock::now();
+        vector<uint32_t> menuSizes = writeRestaurants("restaurants.dat", options.restaurants, random);
+        writeCustomers("customers.txt", options.customers, random);
+        vector<PlannedOrder> planned;
+        vector<Event> events;
+        planOrders(options, menuSizes, random, planned, events);
+        cout << "Generated " << options.restaurants << " restaurants, " << options.customers << " customers and "
+             << options.orders << " orders (" << events.size() << " events) in " << options.dir << " in "
+             << secondsSince(start) << " s\n";
         
-        vector<MenuItem> sortedMenu = menuSearchTree.inorderTraversal();
+        WalOptions walOptions;
+        walOptions.sync = options.sync;
+        FoodDeliverySystem system(walOptions);
         
-        cout << "Menu items sorted by price:\n";
-        for (const auto& item : sortedMenu) {
-            cout << item.name << " - $" << item.price << " (" << item.category << ")\n";
+        vector<EntityId> orderIds(planned.size(), 0);
+        vector<double> placeLatency, statusLatency;
+        placeLatency.reserve(planned.size());
+        statusLatency.reserve(events.size());
+        size_t failures = 0;
+        
+        start = chrono::steady_clock::now();
+        for (const Event& event : events) {
+            // Paced runs measure from the scheduled time, so falling behind shows up as latency
+            auto began = chrono::steady_clock::now();
+            if (options.speedup > 0) {
+                began = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                    chrono::duration<double>(event.at / options.speedup));
+                this_thread::sleep_until(began);
+            }
+            if (event.status == OrderStatus::Pending) {
+                const PlannedOrder& order = planned[event.order];
+                orderIds[event.order] = system.placeOrder(order.customerId, order.restaurantId, order.items);
+                failures += orderIds[event.order] == 0;
+                placeLatency.push_back(secondsSince(began));
+            } else {
+                EntityId id = orderIds[event.order];
+                failures += !id || system.setOrderStatus(id, event.status) != OrderLifecycle::Result::Ok;
+                statusLatency.push_back(secondsSince(began));
+            }
         }
+        double seconds = secondsSince(start);
+        
+        cout << "Replayed " << events.size() << " events in " << seconds << " s: "
+             << static_cast<uint64_t>(events.size() / seconds) << " events/s, "
+             << static_cast<uint64_t>(planned.size() / seconds) << " orders/s"
+             << (failures ? ", " + to_string(failures) + " rejected" : "") << "\n";
+        reportLatencies("place order", placeLatency, "ops");
+        reportLatencies("status change", statusLatency, "ops");
+        return true;
     }
+};
+
+#ifdef FDS_HAVE_EPOLL
+
+// Closed-loop HTTP load generator for OrderServer. Every connection runs on
+// its own thread and keeps up to `pipeline` requests in flight: it writes a
+// burst, then reads the answers, timing each one from the burst's send to
+// its arrival. The mix is 40% menu searches, 25% new orders, 25% status
+// updates on the connection's own orders and 10% order lookups, plus a
+// full restaurant listing every 1000 requests. Without --port a server is
+// started in-process on a copy of restaurants.dat in a scratch directory,
+// so the run's customers and orders never reach the real system.wal.
+class ServerLoadTest {
+public:
+    struct Options {
+        uint16_t port = 0;
+        size_t connections = 16;
+        size_t requests = 100000;
+        size_t pipeline = 1;
+        uint64_t seed = 1;
+    };
     
-    void showOrderHistory() {
-        cout << "\n=== ORDER HISTORY (Stack) ===\n";
+private:
+    static constexpr const char* SCRATCH_DIR = "load_test";
+    
+    enum Kind { SEARCH, PLACE, ADVANCE, LOOKUP, LISTING, KIND_COUNT };
+    
+    struct Target {
+        EntityId id;
+        size_t menuSize;
+    };
+    
+    struct Fixture {
+        vector<Target> restaurants;
+        vector<string> terms;
+        vector<EntityId> customers;     // one per connection
+    };
+    
+    struct OpenOrder {
+        EntityId id;
+        OrderStatus status;
+        bool inFlight;
+    };
+    
+    struct Stats {
+        vector<double> latencies[KIND_COUNT];
+        size_t errors = 0;
+    };
+    
+    // Blocking keep-alive connection
+    class Client {
+    private:
+        int fd = -1;
+        string in;
+    
+    public:
+        ~Client() {
+            if (fd >= 0) ::close(fd);
+        }
         
-        Stack<string> tempStack;
-        cout << "Recent orders (most recent first):\n";
+        bool connect(uint16_t port) {
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        }
         
-        int count = 0;
-        while (!orderHistory.isEmpty() && count < 5) {
-            string orderId = orderHistory.pop();
-            cout << (count + 1) << ". Order ID: " << orderId << "\n";
-            tempStack.push(orderId);
-            count++;
+        bool send(string_view data) {
+            while (!data.empty()) {
+                ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                data.remove_prefix(n);
+            }
+            return true;
         }
         
-        while (!tempStack.isEmpty()) {
-            orderHistory.push(tempStack.pop());
+        // Reads one response; returns its status code, or -1 if the connection failed
+        int receive(string& body) {
+            char buffer[64 * 1024];
+            while (true) {
+                size_t headerEnd = in.find("\r\n\r\n");
+                if (headerEnd != string::npos) {
+                    size_t lengthAt = in.find("Content-Length:");
+                    uint64_t length = 0;
+                    if (lengthAt == string::npos || lengthAt > headerEnd) return -1;
+                    size_t digits = in.find_first_not_of(' ', lengthAt + 15);
+                    size_t digitsEnd = in.find_first_of(" \r", digits);
+                    if (!parseUnsigned(string_view(in).substr(digits, digitsEnd - digits), length)) return -1;
+                    if (in.size() >= headerEnd + 4 + length) {
+                        uint64_t status = 0;
+                        parseUnsigned(string_view(in).substr(9, 3), status);
+                        body.assign(in, headerEnd + 4, length);
+                        in.erase(0, headerEnd + 4 + length);
+                        return static_cast<int>(status);
+                    }
+                }
+                ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return -1;
+                in.append(buffer, n);
+            }
         }
+    };
+    
+    // The first `"key":"<id>"` in a response body
+    static bool findId(string_view body, string_view key, EntityId& id) {
+        size_t at = body.find(key);
+        if (at == string_view::npos) return false;
+        size_t start = at + key.size();
+        size_t end = body.find('"', start);
+        return end != string_view::npos && parseId(body.substr(start, end - start), id);
     }
     
-    void performanceAnalysis() {
-        cout << "\n=== SYSTEM PERFORMANCE ANALYSIS ===\n";
-        SortingAlgorithms::performanceAnalysis();
-        SearchAlgorithms::demonstrateDFS();
+    // Restaurants with a menu, and the first word of every menu item name as
+    // a search term, taken from the /restaurants listing
+    static void readListing(string_view listing, Fixture& fixture) {
+        const string_view restaurantKey = "{\"id\":\"";
+        const string_view itemKey = "{\"item\":";
+        size_t at = listing.find(restaurantKey);
+        while (at != string_view::npos) {
+            size_t next = listing.find(restaurantKey, at + 1);
+            string_view record = listing.substr(at, next == string_view::npos ? string_view::npos : next - at);
+            EntityId id;
+            size_t items = 0;
+            for (size_t item = record.find(itemKey); item != string_view::npos; item = record.find(itemKey, item + 1)) {
+                items++;
+                size_t name = record.find("\"name\":\"", item);
+                if (name == string_view::npos || fixture.terms.size() >= 1000) continue;
+                size_t start = name + 8;
+                size_t end = start;
+                while (end < record.size() && isalnum(static_cast<unsigned char>(record[end]))) end++;
+                if (end > start) fixture.terms.emplace_back(record.substr(start, end - start));
+            }
+            if (items && findId(record, restaurantKey, id)) fixture.restaurants.push_back({id, items});
+            at = next;
+        }
     }
     
-    void exportData() {
-        cout << "\n=== DATA EXPORT ===\n";
-        
-        ofstream csvFile("restaurants_export.csv");
-        csvFile << "ID,Name,Rating,Address\n";
-        
-        vector<Restaurant> restaurantList = Restaurant::loadAllRestaurants();
-        for (const auto& restaurant : restaurantList) {
-            csvFile << restaurant.id << "," << restaurant.name << "," 
-                   << restaurant.rating << "," << restaurant.address << "\n";
+    static void appendPost(string& out, const string& path, const string& body) {
+        out += "POST " + path + " HTTP/1.1\r\nHost: localhost\r\n"
+               "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+               to_string(body.size()) + "\r\n\r\n" + body;
+    }
+    
+    static void appendGet(string& out, const string& target) {
+        out += "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    }
+    
+    static void runConnection(uint16_t port, const Fixture& fixture, size_t index, size_t requests,
+                              const Options& options, Stats& stats) {
+        Client client;
+        if (!client.connect(port)) {
+            stats.errors += requests;
+            return;
         }
-        csvFile.close();
+        uint64_t state = options.seed * 0x9E3779B97F4A7C15ULL + index;
+        auto below = [&state](size_t n) { return static_cast<size_t>(mixHash(++state) % n); };
+        EntityId customerId = fixture.customers[index];
+        vector<OpenOrder> open;
+        vector<EntityId> closed;
+        string burst, body;
+        vector<pair<Kind, size_t>> sent;    // kind and, for ADVANCE, the index into `open`
         
-        cout << "Data exported to restaurants_export.csv\n";
+        for (size_t done = 0; done < requests;) {
+            burst.clear();
+            sent.clear();
+            size_t count = min(options.pipeline, requests - done);
+            for (size_t i = 0; i < count; i++) {
+                size_t roll = below(100);
+                Kind kind = (done + i) % 1000 == 999 ? LISTING
+                          : roll < 40 ? SEARCH : roll < 65 ? PLACE : roll < 90 ? ADVANCE : LOOKUP;
+                size_t slot = SIZE_MAX;
+                if (kind == ADVANCE) {
+                    // A random order not already being advanced in this burst
+                    for (size_t tries = 0; tries < 4 && !open.empty() && slot == SIZE_MAX; tries++) {
+                        size_t pick = below(open.size());
+                        if (!open[pick].inFlight) slot = pick;
+                    }
+                    if (slot == SIZE_MAX) kind = PLACE;
+                }
+                if (kind == LOOKUP && open.empty() && closed.empty()) kind = SEARCH;
+                
+                if (kind == SEARCH) {
+                    appendGet(burst, "/menu/search?limit=10&q=" + fixture.terms[below(fixture.terms.size())]);
+                } else if (kind == PLACE) {
+                    const Target& restaurant = fixture.restaurants[below(fixture.restaurants.size())];
+                    string items = to_string(1 + below(restaurant.menuSize));
+                    if (below(2)) items += "," + to_string(1 + below(restaurant.menuSize));
+                    appendPost(burst, "/orders", "customer=" + formatId(customerId) +
+                               "&restaurant=" + formatId(restaurant.id) + "&items=" + items);
+                } else if (kind == ADVANCE) {
+                    OpenOrder& order = open[slot];
+                    order.inFlight = true;
+                    OrderStatus next = static_cast<OrderStatus>(static_cast<int>(order.status) + 1);
+                    appendPost(burst, "/orders/" + formatId(order.id) + "/status",
+                               string("status=") + statusName(next));
+                } else if (kind == LOOKUP) {
+                    size_t pick = below(open.size() + closed.size());
+                    EntityId id = pick < open.size() ? open[pick].id : closed[pick - open.size()];
+                    appendGet(burst, "/orders/" + formatId(id));
+                } else {
+                    appendGet(burst, "/restaurants");
+                }
+                sent.push_back({kind, slot});
+            }
+            
+            auto start = chrono::steady_clock::now();
+            if (!client.send(burst)) {
+                stats.errors += requests - done;
+                return;
+            }
+            for (const auto& [kind, slot] : sent) {
+                int status = client.receive(body);
+                stats.latencies[kind].push_back(secondsSince(start));
+                if (status < 0) {
+                    stats.errors += requests - done;
+                    return;
+                }
+                done++;
+                if (status != 200 && status != 201) {
+                    stats.errors++;
+                    if (kind == ADVANCE) open[slot].inFlight = false;
+                    continue;
+                }
+                EntityId id;
+                if (kind == PLACE && findId(body, "\"id\":\"", id)) {
+                    open.push_back({id, OrderStatus::Pending, false});
+                } else if (kind == ADVANCE) {
+                    OpenOrder& order = open[slot];
+                    order.status = static_cast<OrderStatus>(static_cast<int>(order.status) + 1);
+                    order.inFlight = false;
+                }
+            }
+            // Delivered orders leave the open set only between bursts, so slots stay valid
+            for (size_t i = 0; i < open.size();) {
+                if (open[i].status == OrderStatus::Delivered) {
+                    closed.push_back(open[i].id);
+                    open[i] = open.back();
+                    open.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        }
     }
     
-    void displayMenu() {
-        cout << "\n=== FOOD DELIVERY SYSTEM ===\n";
-        cout << "1. Add Restaurant\n";
-        cout << "2. Add Customer\n";
-        cout << "3. Place Order\n";
-        cout << "4. Display Restaurants\n";
-        cout << "5. Display Orders\n";
-        cout << "6. Search Menu Items\n";
-        cout << "7. Show Order History\n";
-        cout << "8. Performance Analysis\n";
-        cout << "9. Export Data\n";
-        cout << "0. Exit\n";
-        cout << "Enter your choice: ";
+public:
+    static bool parseOptions(int argc, char* argv[], Options& options) {
+        return parseFlags(argc, argv, {}, [&options](const string& flag, const string& value) {
+            uint64_t number = 0;
+            bool isNumber = parseUnsigned(value, number);
+            if (flag == "--port" && isNumber && number > 0 && number <= UINT16_MAX) {
+                options.port = static_cast<uint16_t>(number);
+            } else if (flag == "--connections" && isNumber && number > 0) {
+                options.connections = number;
+            } else if (flag == "--requests" && isNumber && number > 0) {
+                options.requests = number;
+            } else if (flag == "--pipeline" && isNumber && number > 0) {
+                options.pipeline = number;
+            } else if (flag == "--seed" && isNumber) {
+                options.seed = number;
+            } else {
+                return false;
+            }
+            return true;
+        });
     }
     
-    void run() {
-        int choice;
+    // False if no server could be reached or it has nothing to order from
+    static bool run(const Options& options) {
+        unique_ptr<FoodDeliverySystem> system;
+        unique_ptr<OrderServer> server;
+        thread serving;
+        uint16_t port = options.port;
+        if (!port) {
+            filesystem::create_directories(SCRATCH_DIR);
+            error_code ec;
+            filesystem::copy_file("restaurants.dat", string(SCRATCH_DIR) + "/restaurants.dat",
+                                  filesystem::copy_options::overwrite_existing, ec);
+            filesystem::current_path(SCRATCH_DIR);
+            remove("system.snap");
+            remove("system.wal");
+            remove("customers.txt");
+            system = make_unique<FoodDeliverySystem>();
+            system->setDispatchBudget(chrono::microseconds(0));
+            server = make_unique<OrderServer>(*system);
+            if (!server->listen(0)) {
+                filesystem::current_path("..");
+                return false;
+            }
+            port = server->port();
+            serving = thread([&server] { server->run(); });
+        }
+        auto stopServer = [&] {
+            if (!server) return;
+            server->stop();
+            serving.join();
+            filesystem::current_path("..");
+        };
         
-        cout << "=== FOOD DELIVERY SYSTEM ===\n";
-        cout << "Air University - Data Structures & Algorithms Project\n\n";
+        // Setup: the restaurant listing and one registered customer per connection
+        Fixture fixture;
+        Client setup;
+        string body;
+        if (!setup.connect(port)) {
+            cerr << "Cannot connect to 127.0.0.1:" << port << "\n";
+            stopServer();
+            return false;
+        }
+        string request;
+        appendGet(request, "/restaurants");
+        if (setup.send(request) && setup.receive(body) == 200) readListing(body, fixture);
+        for (size_t i = 0; i < options.connections; i++) {
+            request.clear();
+            appendPost(request, "/customers", "name=Load+Tester+" + to_string(i + 1) + "&phone=0300&address=Localhost");
+            EntityId id;
+            if (!setup.send(request) || setup.receive(body) != 201 || !findId(body, "\"id\":\"", id)) break;
+            fixture.customers.push_back(id);
+        }
+        if (fixture.restaurants.empty() || fixture.terms.empty() || fixture.customers.size() < options.connections) {
+            cerr << "The server has no restaurants with menus to order from\n";
+            stopServer();
+            return false;
+        }
         
-        do {
-            displayMenu();
-            cin >> choice;
-            
-            switch (choice) {
-                case 1: addRestaurant(); break;
-                case 2: addCustomer(); break;
-                case 3: placeOrder(); break;
-                case 4: displayRestaurants(); break;
-                case 5: displayOrders(); break;
-                case 6: searchMenuItems(); break;
-                case 7: showOrderHistory(); break;
-                case 8: performanceAnalysis(); break;
-                case 9: exportData(); break;
-                case 0: cout << "Exiting...\n"; break;
-                default: cout << "Invalid choice!\n";
-            }
-            
-            if (choice != 0) {
-                cout << "\nPress Enter to continue...";
-                cin.ignore();
-                cin.get();
+        cout << "Load test: " << options.connections << " connections, " << options.requests
+             << " requests, pipeline depth " << options.pipeline << ", port " << port << "\n";
+        vector<Stats> stats(options.connections);
+        vector<thread> clients;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < options.connections; i++) {
+            size_t share = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+            clients.emplace_back(runConnection, port, cref(fixture), i, share, cref(options), ref(stats[i]));
+        }
+        for (auto& c : clients) c.join();
+        double seconds = secondsSince(start);
+        stopServer();
+        
+        Stats total;
+        for (auto& s : stats) {
+            total.errors += s.errors;
+            for (size_t k = 0; k < KIND_COUNT; k++) {
+                total.latencies[k].insert(total.latencies[k].end(), s.latencies[k].begin(), s.latencies[k].end());
             }
-            
-        } while (choice != 0);
+        }
+        vector<double> all;
+        for (const auto& latencies : total.latencies) all.insert(all.end(), latencies.begin(), latencies.end());
         
-        cout << "Thank you for using Food Delivery System!\n";
+        cout << all.size() << " requests in " << seconds << " s: " << static_cast<uint64_t>(all.size() / seconds)
+             << " requests/s" << (total.errors ? ", " + to_string(total.errors) + " errors" : "") << "\n";
+        reportLatencies("all", all, "reqs");
+        reportLatencies("menu search", total.latencies[SEARCH], "reqs");
+        reportLatencies("place order", total.latencies[PLACE], "reqs");
+        reportLatencies("status change", total.latencies[ADVANCE], "reqs");
+        reportLatencies("order lookup", total.latencies[LOOKUP], "reqs");
+        reportLatencies("listing", total.latencies[LISTING], "reqs");
+        return true;
     }
 };
 
+#endif
+
 // ======================= MAIN FUNCTION =======================
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
         srand(time(nullptr));
         
+        if (argc > 1 && string(argv[1]) == "--bench") {
+            BenchmarkSuite::Options options;
+            if (!BenchmarkSuite::parseOptions(argc, argv, options)) return 1;
+            BenchmarkSuite::run(options);
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--batch") {
+            // Commands from a file, or stdin when none is given (or "-")
+            string path = argc > 2 ? argv[2] : "-";
+            FILE* in = path == "-" ? stdin : fopen(path.c_str(), "rb");
+            if (!in) {
+                cerr << "Cannot open " << path << "\n";
+                return 1;
+            }
+            WalOptions walOptions;
+            FoodDeliverySystem system(walOptions);
+            system.setDispatchBudget(chrono::microseconds(0));
+            CommandBatch(system, stdout).run(in);
+            if (in != stdin) fclose(in);
+            return 0;
+        }
+#ifdef FDS_HAVE_EPOLL
+        if (argc > 1 && string(argv[1]) == "--serve") {
+            uint64_t port = 8080;
+            if (argc > 2 && (!parseUnsigned(argv[2], port) || port == 0 || port > UINT16_MAX)) {
+                cerr << "Invalid port " << argv[2] << "\n";
+                return 1;
+            }
+            FoodDeliverySystem system;
+            // Routes are improved while the loop is idle instead of per request
+            system.setDispatchBudget(chrono::microseconds(0));
+            OrderServer server(system);
+            if (!server.listen(static_cast<uint16_t>(port))) return 1;
+            signal(SIGINT, [](int) { OrderServer::interrupt(); });
+            signal(SIGTERM, [](int) { OrderServer::interrupt(); });
+            cout << "Serving on http://127.0.0.1:" << server.port() << " (Ctrl-C to stop)" << endl;
+            server.run();
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--load-test") {
+            ServerLoadTest::Options options;
+            if (!ServerLoadTest::parseOptions(argc, argv, options)) return 1;
+            return ServerLoadTest::run(options) ? 0 : 1;
+        }
+#endif
+        if (argc > 1 && string(argv[1]) == "--workload") {
+            WorkloadDriver::Options options;
+            if (!WorkloadDriver::parseOptions(argc, argv, options)) return 1;
+            return WorkloadDriver::run(options) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-loader") {
+            LoaderBenchmark::run(argc > 2 ? stoul(argv[2]) : 256);
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-lifecycle") {
+            return LifecycleBenchmark::run(argc > 2 ? stoul(argv[2]) : 1000000) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-memory") {
+            OrderMemoryBenchmark::run(argc > 2 ? stoul(argv[2]) : 200000);
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-analytics") {
+            return AnalyticsBenchmark::run(argc > 2 ? stoul(argv[2]) : 2000000) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-billing") {
+            return BillingBenchmark::run(argc > 2 ? stoul(argv[2]) : 2000000) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-concurrent") {
+            bool ok = ConcurrencyBenchmark::run(argc > 2 ? stoul(argv[2]) : 200000,
+                                                argc > 3 ? stoul(argv[3]) : ThreadPool::defaultThreads());
+            return ok ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-queues") {
+            QueueBenchmark::run(argc > 2 ? stoul(argv[2]) : 1000000);
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-routing") {
+            // Either a grid size or a road network file
+            string arg = argc > 2 ? argv[2] : "300";
+            bool isSize = all_of(arg.begin(), arg.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); });
+            return RoutingBenchmark::run(isSize ? "" : arg, isSize ? stoul(arg) : 0) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-dispatch") {
+            DispatchBenchmark::run(argc > 2 ? stoul(argv[2]) : 2000);
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-sort") {
+            return SortBenchmark::run(argc > 2 ? stoul(argv[2]) : 1000000) ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--self-test") {
+            return SelfTest::run() ? 0 : 1;
+        }
+        if (argc > 1 && string(argv[1]) == "--bench-spatial") {
+            return SpatialBenchmark::run(argc > 2 ? stoul(argv[2]) : 1000000) ? 0 : 1;
+        }
+        
         FoodDeliverySystem system;
         system.run();
         